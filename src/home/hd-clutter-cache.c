@@ -26,6 +26,7 @@
  */
 
 #include "tidy/tidy-sub-texture.h"
+#include "tidy/tidy-texture-accounting.h"
 
 #include "hd-clutter-cache.h"
 #include "hd-render-manager.h"
@@ -166,6 +167,7 @@ hd_clutter_cache_get_real_texture(const char *filename, gboolean from_theme)
 
   clutter_actor_set_name(texture, filename_real);
   clutter_container_add_actor(CLUTTER_CONTAINER(cache), texture);
+  tidy_texture_accounting_watch(texture, "clutter-cache");
 
   if (filename_alloc)
     g_free(filename_alloc);
@@ -53,6 +53,8 @@ struct _HdHomeViewContainerPrivate
 {
   ClutterActor *views[MAX_HOME_VIEWS];
   gboolean active_views [MAX_HOME_VIEWS];
+  /* Views whose wallpaper textures we keep loaded. */
+  gboolean resident_views [MAX_HOME_VIEWS];
 
   guint current_view;
   guint previous_view;
@@ -75,6 +77,9 @@ struct _HdHomeViewContainerPrivate
   gboolean animation_overshoot;
 
   gboolean in_move;
+  /* Whether the wallpapers beyond the neighbours have been requested
+   * for the current pan. */
+  gboolean prefetched;
 
   /* GConf */
   GConfClient *gconf_client;
@@ -99,6 +104,58 @@ G_DEFINE_TYPE_WITH_CODE (HdHomeViewContainer,
                          CLUTTER_TYPE_GROUP,
                          G_ADD_PRIVATE (HdHomeViewContainer));
 
+/* Returns the active view before (@dir < 0) or after @view. */
+static guint
+step_active_view (HdHomeViewContainerPrivate *priv, guint view, gint dir)
+{
+  guint from = view;
+
+  do
+    view = (view + MAX_HOME_VIEWS + dir) % MAX_HOME_VIEWS;
+  while (view != from && !priv->active_views[view]);
+
+  return view;
+}
+
+/*
+ * Keeps the wallpapers of the views at most @radius active views away from
+ * the current one loaded and unloads everyone else's.  The current view
+ * is loaded first, so it gets the higher idle priority.
+ */
+static void
+hd_home_view_container_update_residency (HdHomeViewContainer *self,
+                                         guint                radius)
+{
+  HdHomeViewContainerPrivate *priv = self->priv;
+  guint i, n, prev, next;
+
+  memset (priv->resident_views, 0, sizeof (priv->resident_views));
+  priv->resident_views[priv->current_view] = TRUE;
+  prev = next = priv->current_view;
+  for (n = 0; n < radius; n++)
+    {
+      prev = step_active_view (priv, prev, -1);
+      next = step_active_view (priv, next,  1);
+      priv->resident_views[prev] = priv->resident_views[next] = TRUE;
+    }
+
+  hd_home_view_ensure_background (HD_HOME_VIEW (priv->views[priv->current_view]));
+  for (i = 0; i < MAX_HOME_VIEWS; i++)
+    if (i == priv->current_view)
+      continue;
+    else if (priv->resident_views[i])
+      hd_home_view_ensure_background (HD_HOME_VIEW (priv->views[i]));
+    else
+      hd_home_view_unload_background (HD_HOME_VIEW (priv->views[i]));
+}
+
+/* How many views on either side of the current one keep their wallpaper. */
+static guint
+residency_radius (void)
+{
+  return MAX (1, hd_transition_get_int ("home", "wallpaper_residency", 1));
+}
+
 static void
 hd_home_view_container_update_previous_and_next_view (HdHomeViewContainer *self)
 {
@@ -117,6 +174,8 @@ hd_home_view_container_update_previous_and_next_view (HdHomeViewContainer *self)
 
   priv->previous_view = previous_view;
   priv->next_view = next_view;
+
+  hd_home_view_container_update_residency (self, residency_radius ());
 }
 
 static void
@@ -152,7 +211,12 @@ backgrounds_dir_changed (GFileMonitor        *monitor,
             {
               g_debug ("%s. Reload background %s for view %u.", __FUNCTION__,
                        info_uri, id + 1);
-              hd_home_view_load_background (HD_HOME_VIEW (priv->views[id]));
+              hd_home_view_invalidate_background_cache (
+                                          HD_HOME_VIEW (priv->views[id]));
+              if (priv->resident_views[id])
+                hd_home_view_load_background (HD_HOME_VIEW (priv->views[id]));
+              else
+                hd_home_view_unload_background (HD_HOME_VIEW (priv->views[id]));
             }
         }
       else if (g_str_has_prefix (basename, "background_portrait-") &&
@@ -167,7 +231,12 @@ backgrounds_dir_changed (GFileMonitor        *monitor,
             {
               g_debug ("%s. Reload background %s for view %u.", __FUNCTION__,
                        info_uri, id + 1);
-              hd_home_view_load_background (HD_HOME_VIEW (priv->views[id]));
+              hd_home_view_invalidate_background_cache (
+                                          HD_HOME_VIEW (priv->views[id]));
+              if (priv->resident_views[id])
+                hd_home_view_load_background (HD_HOME_VIEW (priv->views[id]));
+              else
+                hd_home_view_unload_background (HD_HOME_VIEW (priv->views[id]));
             }
         }
 
@@ -274,11 +343,8 @@ hd_home_view_container_update_active_views (HdHomeViewContainer *self,
             clutter_actor_hide (priv->views[i]);
         }
 
+      /* This loads the backgrounds around the current view too. */
       hd_home_view_container_set_current_view (self, current_view);
-
-      /* Load backgrounds for active views */
-      for (i = 0; i < MAX_HOME_VIEWS; i++)
-        hd_home_view_load_background (HD_HOME_VIEW (priv->views[i]));
     }
   else
     {
@@ -286,7 +352,6 @@ hd_home_view_container_update_active_views (HdHomeViewContainer *self,
         {
           if (active_views[i] && !priv->active_views[i])
             {
-              hd_home_view_load_background (HD_HOME_VIEW (priv->views[i]));
               priv->active_views[i] = active_views[i];
               clutter_actor_show (priv->views[i]);
               g_object_notify (G_OBJECT (priv->views[i]), "active");
@@ -387,10 +452,11 @@ hd_home_view_container_set_live_bg (HdHomeViewContainer *container,
 
           /* restore normal backgrounds */
           for (i = 0; i < MAX_HOME_VIEWS; ++i)
-            {
-              hhview = HD_HOME_VIEW (priv->views[i]);
-              hd_home_view_load_background (hhview);
-            }
+            if (priv->resident_views[i])
+              {
+                hhview = HD_HOME_VIEW (priv->views[i]);
+                hd_home_view_load_background (hhview);
+              }
         }
       else
         for (i = 0; i < MAX_HOME_VIEWS; ++i)
@@ -402,7 +468,8 @@ hd_home_view_container_set_live_bg (HdHomeViewContainer *container,
               {
                 hd_home_view_set_live_bg (hhview, NULL, FALSE);
                 /* restore normal background */
-                hd_home_view_load_background (hhview);
+                if (priv->resident_views[i])
+                  hd_home_view_load_background (hhview);
               }
           }
     }
@@ -454,10 +521,11 @@ hd_home_view_container_set_live_bg (HdHomeViewContainer *container,
       /* restore normal backgrounds, FIXME: could be smarter by checking
        * if the backgrounds are already there */
       for (i = 0; i < MAX_HOME_VIEWS; ++i)
-        {
-          hhview = HD_HOME_VIEW (priv->views[i]);
-          hd_home_view_load_background (hhview);
-        }
+        if (priv->resident_views[i])
+          {
+            hhview = HD_HOME_VIEW (priv->views[i]);
+            hd_home_view_load_background (hhview);
+          }
     }
 }
 
@@ -926,6 +994,15 @@ hd_home_view_container_set_offset (HdHomeViewContainer *container,
 
   priv->offset = CLUTTER_UNITS_TO_INT(offset);
 
+  /* Panning has started: get the views after the neighbours ready while
+   * the user is still dragging, so they aren't blank once we land. */
+  if (priv->offset && !priv->prefetched)
+    {
+      priv->prefetched = TRUE;
+      hd_home_view_container_update_residency (container,
+                                               residency_radius () + 1);
+    }
+
   clutter_actor_queue_relayout (CLUTTER_ACTOR (container));
 }
 
@@ -970,6 +1047,14 @@ scroll_back_completed_cb (ClutterTimeline     *timeline,
     }
 
   priv->in_move = FALSE;
+
+  /* Drop what we prefetched in the direction we didn't go. */
+  if (priv->prefetched)
+    {
+      priv->prefetched = FALSE;
+      hd_home_view_container_update_residency (container,
+                                               residency_radius ());
+    }
 }
 
 /* Velocity is the speed in pixels/second, and we attempt to set the scroll
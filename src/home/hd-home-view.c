@@ -35,9 +35,11 @@
 #include "hd-render-manager.h"
 #include "hd-clutter-cache.h"
 #include "hd-transition.h"
+#include "hd-dither.h"
 
 #include "hildon-desktop.h"
 #include "../tidy/tidy-sub-texture.h"
+#include "../tidy/tidy-texture-accounting.h"
 
 #include <clutter/clutter.h>
 #include <clutter/x11/clutter-x11.h>
@@ -48,12 +50,34 @@
 #include <gconf/gconf-client.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #define BACKGROUND_COLOR {0, 0, 0, 0xff}
 #define CACHED_BACKGROUND_IMAGE_FILE_PNG "%s/.backgrounds/background-%u.png"
 #define CACHED_BACKGROUND_IMAGE_FILE_PVR "%s/.backgrounds/background-%u.pvr"
 #define CACHED_BACKGROUND_IMAGE_FILE_PNG_PORTRAIT "%s/.backgrounds/background_portrait-%u.png"
 #define CACHED_BACKGROUND_IMAGE_FILE_PVR_PORTRAIT "%s/.backgrounds/background_portrait-%u.pvr"
 
+/* The PNG wallpapers dithered to RGB565 are cached in files with this
+ * suffix instead of .png, see load_png_background(). */
+#define DITHERED_BACKGROUND_SUFFIX ".565"
+#define DITHERED_BACKGROUND_MAGIC "HD565\0\0\1"
+
+/* Header of the dithered wallpaper caches, followed by @width*@height
+ * pixels in native byte order.  @mtime and @size identify the PNG
+ * the cache was made of. */
+typedef struct
+{
+  gchar   magic[8];
+  guint32 width, height;
+  guint64 mtime, size;
+} HdDitheredBackgroundHeader;
+
 #define GCONF_KEY_POSITION "/apps/osso/hildon-desktop/applets/%s/position"
 #define GCONF_KEY_MODIFIED "/apps/osso/hildon-desktop/applets/%s/modified"
 #define GCONF_KEY_VIEW     "/apps/osso/hildon-desktop/applets/%s/view"
@@ -111,6 +135,7 @@ struct _HdHomeViewPrivate
   guint                     id;
 
   guint load_background_source;
+  gboolean background_loaded : 1;
 
   GConfClient *gconf_client;
 
@@ -506,6 +531,8 @@ set_background_common (HdHomeView *hview, ClutterActor *new_bg)
     }
 
   clutter_actor_set_name (new_bg, "HdHomeView::background");
+  if (CLUTTER_IS_TEXTURE (new_bg))
+    tidy_texture_accounting_watch (new_bg, "wallpaper");
 
   if(hd_home_is_portrait_wallpaper_enabled (priv->home))
     {
@@ -555,6 +582,168 @@ set_background_common (HdHomeView *hview, ClutterActor *new_bg)
     
 }
 
+/* Returns the name of the dithered cache of @png_fname. */
+static gchar *
+dithered_background_fname (const gchar *png_fname)
+{
+  gchar *base, *fname;
+
+  base = g_str_has_suffix (png_fname, ".png")
+    ? g_strndup (png_fname, strlen (png_fname) - 4)
+    : g_strdup (png_fname);
+  fname = g_strconcat (base, DITHERED_BACKGROUND_SUFFIX, NULL);
+  g_free (base);
+  return fname;
+}
+
+/* Uploads the dithered cache @fname if it was made of a file
+ * looking like @source.  Returns %NULL if it's missing or stale. */
+static ClutterActor *
+load_dithered_background (const gchar *fname, const struct stat *source)
+{
+  int fd;
+  struct stat sbuf;
+  const HdDitheredBackgroundHeader *header;
+  ClutterActor *texture;
+  gpointer map;
+
+  if ((fd = open (fname, O_RDONLY)) < 0)
+    return NULL;
+
+  texture = NULL;
+  map = MAP_FAILED;
+  if (fstat (fd, &sbuf) < 0 || sbuf.st_size < sizeof (*header))
+    goto out;
+  if ((map = mmap (NULL, sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0))
+      == MAP_FAILED)
+    goto out;
+
+  header = map;
+  if (memcmp (header->magic, DITHERED_BACKGROUND_MAGIC,
+              sizeof (header->magic))
+      || header->mtime != source->st_mtime
+      || header->size  != source->st_size
+      || sbuf.st_size != sizeof (*header)
+                         + (gsize)header->width * header->height * 2)
+    {
+      g_debug ("%s: %s is stale", __FUNCTION__, fname);
+      goto out;
+    }
+
+  texture = clutter_texture_new ();
+  if (!clutter_texture_set_from_rgb_data (CLUTTER_TEXTURE (texture),
+                                          (const guchar *)(header + 1), FALSE,
+                                          header->width, header->height,
+                                          header->width * 2, 2,
+                                          CLUTTER_TEXTURE_FLAG_16_BIT, NULL))
+    {
+      clutter_actor_destroy (texture);
+      texture = NULL;
+    }
+
+out:
+  if (map != MAP_FAILED)
+    munmap (map, sbuf.st_size);
+  close (fd);
+  return texture;
+}
+
+/* Loads @fname, a PNG wallpaper, dithering it to 16 bits on the fly
+ * because clutter doesn't do this for us.  The dithered image is
+ * saved next to @fname, and it's used instead of decoding @fname
+ * again as long as @fname doesn't change. */
+static ClutterActor *
+load_png_background (const gchar *fname, GError **error)
+{
+  GdkPixbuf *pixbuf;
+  struct stat sbuf;
+  gchar *cache_fname;
+  ClutterActor *new_bg;
+  gint width, height, rowstride, n_channels;
+  HdDitheredBackgroundHeader *header;
+
+  new_bg = NULL;
+  if (g_stat (fname, &sbuf) < 0)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   "%s", g_strerror (errno));
+      return NULL;
+    }
+
+  cache_fname = dithered_background_fname (fname);
+  if ((new_bg = load_dithered_background (cache_fname, &sbuf)) != NULL)
+    goto out;
+
+  if (!(pixbuf = gdk_pixbuf_new_from_file (fname, error)))
+    goto out;
+
+  width           = gdk_pixbuf_get_width (pixbuf);
+  height          = gdk_pixbuf_get_height (pixbuf);
+  rowstride       = gdk_pixbuf_get_rowstride (pixbuf);
+  n_channels      = gdk_pixbuf_get_n_channels (pixbuf);
+
+  if (gdk_pixbuf_get_bits_per_sample (pixbuf)==8 &&
+      (n_channels==3 || n_channels==4))
+    {
+      gsize size;
+
+      /* Dither right after the header so we can save it in one go. */
+      size = sizeof (*header) + width*height*2;
+      header = g_malloc (size);
+      memcpy (header->magic, DITHERED_BACKGROUND_MAGIC,
+              sizeof (header->magic));
+      header->width  = width;
+      header->height = height;
+      header->mtime  = sbuf.st_mtime;
+      header->size   = sbuf.st_size;
+      hd_dither_565 (gdk_pixbuf_get_pixels (pixbuf),
+                     width, height, rowstride, n_channels,
+                     (guint16 *)(header + 1));
+
+      new_bg = clutter_texture_new();
+      clutter_texture_set_from_rgb_data(CLUTTER_TEXTURE(new_bg),
+            (guchar*)(header + 1), FALSE,
+            width, height, width*2, 2, CLUTTER_TEXTURE_FLAG_16_BIT, error);
+
+      /* g_file_set_contents() writes to a temporary file and renames it,
+       * so nobody sees a half-written cache. */
+      if (!g_file_set_contents (cache_fname, (const gchar *)header, size,
+                                NULL))
+        g_debug ("%s: couldn't save %s", __FUNCTION__, cache_fname);
+      g_free (header);
+    }
+  g_object_unref (pixbuf);
+
+out:
+  g_free (cache_fname);
+  return new_bg;
+}
+
+/* Deletes the dithered caches of the wallpapers of @view,
+ * to be called when the wallpapers change. */
+void
+hd_home_view_invalidate_background_cache (HdHomeView *view)
+{
+  static const gchar *templates[] = {
+    CACHED_BACKGROUND_IMAGE_FILE_PNG,
+    CACHED_BACKGROUND_IMAGE_FILE_PNG_PORTRAIT,
+  };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (templates); i++)
+    {
+      gchar *png_fname, *cache_fname;
+
+      png_fname = g_strdup_printf (templates[i], g_get_home_dir (),
+                                   view->priv->id + 1);
+      cache_fname = dithered_background_fname (png_fname);
+      if (g_unlink (cache_fname) < 0 && errno != ENOENT)
+        g_warning ("%s: %s", cache_fname, g_strerror (errno));
+      g_free (cache_fname);
+      g_free (png_fname);
+    }
+}
+
 static gboolean
 load_background_idle (gpointer data)
 {
@@ -615,85 +804,8 @@ load_background_idle (gpointer data)
           }
       }
     else
-      {
-        GdkPixbuf        *pixbuf;
-
-        /* Load image directly. We actually want to dither it on the fly to
-         * 16 bit, and clutter doesn't do this for us so we implement a very
-         * quick dither here. */
-        if(!i) 
-          pixbuf = gdk_pixbuf_new_from_file (cached_background_image_file, &error);
-        else
-          pixbuf = gdk_pixbuf_new_from_file (cached_background_image_file, &error_portrait);
-          
-        if (pixbuf != NULL)
-          {
-            gint              width;
-            gint              height;
-            gint              rowstride;
-            gint              n_channels;
-            guchar           *pixels;
-            gushort          *out_pixels, *out;
-            guint             lfsr = 1;
-            gint x,y;
-
-            /* Get pixbuf properties */
-            width           = gdk_pixbuf_get_width (pixbuf);
-            height          = gdk_pixbuf_get_height (pixbuf);
-            rowstride       = gdk_pixbuf_get_rowstride (pixbuf);
-            n_channels      = gdk_pixbuf_get_n_channels (pixbuf);
-            pixels          = gdk_pixbuf_get_pixels (pixbuf);
-
-            if (gdk_pixbuf_get_bits_per_sample (pixbuf)==8 &&
-                (n_channels==3 || n_channels==4))
-              {
-                out_pixels = g_malloc(width*height*2);
-                out = out_pixels;
-                for (y=0;y<height;y++) {
-                  for (x=0;x<width;x++) {
-                    /* http://en.wikipedia.org/wiki/Linear_feedback_shift_register */
-                    lfsr = (lfsr >> 1) ^ (unsigned int)((0 - (lfsr & 1u)) & 0xd0000001u);
-  
-                    /* dither 565 - by adding random noise and then truncating
-                     * (r>>8)*0xFF makes sure our bottom 8 bits are 0xFF if we
-                     * overflow.
-                     */
-                    guint r,g,b;
-                    r = pixels[0] + (lfsr&7);
-                    r |= (r>>8)*0xFF;
-                    g = pixels[1] + ((lfsr>>3)&3);
-                    g |= (g>>8)*0xFF;
-                    b = pixels[2] + ((lfsr>>5)&7);
-                    b |= (b>>8)*0xFF;
-                    *out = ((r<<8)&0xF800) |
-                           ((g<<3)&0x07E0) |
-                           ((b>>3)&0x001F);
-
-                    pixels += n_channels;
-                    out++;
-                  }
-                  pixels += rowstride - width*n_channels;
-                }
-                new_bg = clutter_texture_new();
-
-                if(!i) 
-                  {
-                    clutter_texture_set_from_rgb_data(CLUTTER_TEXTURE(new_bg),
-                          (guchar*)out_pixels, FALSE,
-                          width, height, width*2, 2, CLUTTER_TEXTURE_FLAG_16_BIT, &error);
-                  }
-                else 
-                  {
-                    clutter_texture_set_from_rgb_data(CLUTTER_TEXTURE(new_bg),
-                          (guchar*)out_pixels, FALSE,
-                          width, height, width*2, 2, CLUTTER_TEXTURE_FLAG_16_BIT, &error_portrait);
-                  }
-
-                g_free(out_pixels);
-              }
-            g_object_unref (pixbuf);
-          }
-      }
+      new_bg = load_png_background (cached_background_image_file,
+                                    !i ? &error : &error_portrait);
 
     if(!i) 
       {
@@ -725,6 +837,7 @@ load_background_idle (gpointer data)
   }
 
   priv->is_portrait = FALSE;
+  priv->background_loaded = TRUE;
 
   return FALSE;
 }
@@ -790,7 +903,10 @@ hd_home_view_set_live_bg (HdHomeView *view,
     }
 
   if (!client || !above_applets)
-    set_background_common (view, new_bg);
+    {
+      set_background_common (view, new_bg);
+      priv->background_loaded = FALSE;
+    }
 }
 
 void
@@ -806,12 +922,82 @@ hd_home_view_load_background (HdHomeView *view)
   if (hd_home_view_container_get_current_view (priv->view_container) == priv->id)
     priority = G_PRIORITY_HIGH_IDLE;
 
+  if (priv->load_background_source)
+    g_source_remove (priv->load_background_source);
   priv->load_background_source = g_idle_add_full (priority,
                                                   load_background_idle,
                                                   view,
                                                   NULL);
 }
 
+/* Loads the wallpaper of @view unless it's already there or on its way. */
+void
+hd_home_view_ensure_background (HdHomeView *view)
+{
+  HdHomeViewPrivate *priv;
+
+  g_return_if_fail (HD_IS_HOME_VIEW (view));
+
+  priv = view->priv;
+  if (!priv->background_loaded && !priv->load_background_source
+      && !priv->live_bg)
+    hd_home_view_load_background (view);
+}
+
+/* Releases the wallpaper textures of @view, replacing them with
+ * the plain background colour until hd_home_view_ensure_background().
+ * Live backgrounds are left alone. */
+void
+hd_home_view_unload_background (HdHomeView *view)
+{
+  HdHomeViewPrivate *priv;
+  ClutterColor clr = BACKGROUND_COLOR;
+  ClutterActor *new_bg;
+
+  g_return_if_fail (HD_IS_HOME_VIEW (view));
+
+  priv = view->priv;
+  if (priv->live_bg)
+    return;
+
+  if (priv->load_background_source)
+    priv->load_background_source = (g_source_remove (priv->load_background_source), 0);
+  if (!priv->background_loaded)
+    return;
+  priv->background_loaded = FALSE;
+
+  /* The textures remembered for the other orientation are not on stage,
+   * but one of them may be the same as priv->background. */
+  if (priv->background_temp && priv->background_temp != priv->background)
+    clutter_actor_destroy (priv->background_temp);
+  if (priv->background_sub_temp
+      && priv->background_sub_temp != priv->background_sub)
+    clutter_actor_destroy (CLUTTER_ACTOR (priv->background_sub_temp));
+  if (priv->background_temp_portrait
+      && priv->background_temp_portrait != priv->background)
+    clutter_actor_destroy (priv->background_temp_portrait);
+  if (priv->background_sub_temp_portrait
+      && priv->background_sub_temp_portrait != priv->background_sub)
+    clutter_actor_destroy (CLUTTER_ACTOR (priv->background_sub_temp_portrait));
+  priv->background_temp = priv->background_temp_portrait = NULL;
+  priv->background_sub_temp = priv->background_sub_temp_portrait = NULL;
+
+  new_bg = clutter_rectangle_new_with_color (&clr);
+  clutter_actor_set_name (new_bg, "HdHomeView::background");
+  clutter_actor_set_size (new_bg,
+                          HD_COMP_MGR_LANDSCAPE_WIDTH,
+                          HD_COMP_MGR_LANDSCAPE_HEIGHT);
+  clutter_container_add_actor (CLUTTER_CONTAINER (priv->background_container),
+                               new_bg);
+
+  if (priv->background_sub)
+    clutter_actor_destroy (CLUTTER_ACTOR (priv->background_sub));
+  if (priv->background)
+    clutter_actor_destroy (priv->background);
+  priv->background = new_bg;
+  priv->background_sub = NULL;
+}
+
 static void
 hd_home_view_set_property (GObject       *object,
 			   guint         prop_id,
@@ -87,6 +87,9 @@ void hd_home_view_set_live_bg (HdHomeView *view,
                                MBWindowManagerClient *client,
                                gboolean above_applets);
 void hd_home_view_load_background (HdHomeView *view);
+void hd_home_view_ensure_background (HdHomeView *view);
+void hd_home_view_unload_background (HdHomeView *view);
+void hd_home_view_invalidate_background_cache (HdHomeView *view);
 void hd_home_view_update_state (HdHomeView *view);
 
 void hd_home_view_change_applets_position (HdHomeView *view);
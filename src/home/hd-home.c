@@ -42,6 +42,8 @@
 #include "hd-launcher-app.h"
 #include "hd-dbus.h"
 #include "hd-title-bar.h"
+#include "hd-screenshot.h"
+#include "tidy/tidy-texture-accounting.h"
 
 #include <clutter/clutter.h>
 #include <clutter/x11/clutter-x11.h>
@@ -51,7 +53,6 @@
 
 #include <gconf/gconf-client.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
-#include <gdk-pixbuf-xlib/gdk-pixbuf-xlib.h>
 
 #include <dbus/dbus-glib.h>
 #include <dbus/dbus-glib-bindings.h>
@@ -212,6 +213,13 @@ typedef struct {
   gdouble period;
 } HdHomeDrag;
 
+/* Who to tell when a loading screenshot has been saved. */
+typedef struct {
+  HdHome *home;
+  Window  xwin;
+  long    serial;
+} HdHomeScreenshotReply;
+
 static void hd_home_class_init (HdHomeClass *klass);
 static void hd_home_init       (HdHome *self);
 static void hd_home_dispose    (GObject *object);
@@ -1118,17 +1126,53 @@ hd_home_reset_fn_state (HdHome *home)
   home->priv->ignore_next_shift_release = FALSE;
 }
 
+/* Tells the client of @xwin that its loading screenshot request
+ * identified by @serial is complete. */
+static void
+send_screenshot_reply (HdHome *home, Window xwin, long serial,
+                       gboolean isok)
+{
+  MBWindowManager *wm = MB_WM_COMP_MGR (home->priv->comp_mgr)->wm;
+  HdCompMgr     *hmgr = HD_COMP_MGR (home->priv->comp_mgr);
+  XEvent reply;
+
+  reply.xclient.type = ClientMessage;
+  reply.xclient.window = xwin;
+  reply.xclient.message_type = hd_comp_mgr_get_atom (hmgr,
+                               HD_ATOM_HILDON_LOADING_SCREENSHOT);
+  reply.xclient.format = 32;
+  reply.xclient.data.l[0] = serial;
+  reply.xclient.data.l[1] = isok;
+
+  mb_wm_util_async_trap_x_errors (wm->xdpy);
+  XSendEvent (wm->xdpy, reply.xclient.window, False,
+              NoEventMask, &reply);
+  XFlush (wm->xdpy);
+  mb_wm_util_async_untrap_x_errors ();
+}
+
+/* hd_screenshot_save_pixmap()'s callback. */
+static void
+screenshot_saved (gboolean isok, HdHomeScreenshotReply *reply)
+{
+  send_screenshot_reply (reply->home, reply->xwin, reply->serial, isok);
+  g_slice_free (HdHomeScreenshotReply, reply);
+}
+
 /*
  * Create the loading screenshot of the application of @xwin which will
  * be put up the the application is started next or remove it.  If the
  * application already has a screenshot it's retained and we don't create
- * a new one.  If @take was requested returns whether a new screenshot
- * was taken, otherwise whether the screenshot was removed successfully.
- * Does nothing if @xwin doesn't have an application we know about.
+ * a new one.  If @take was requested the client is told whether a new
+ * screenshot was taken, otherwise whether the screenshot was removed
+ * successfully.  Does nothing if @xwin doesn't have an application we
+ * know about.  Only the pixmap is read here, the file is written in the
+ * background and the reply is sent when it's in place.
  */
-static gboolean
-take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
+static void
+take_screenshot (HdHome *home, Window xwin, long serial, gboolean take)
 {
+  MBWindowManager *wm = MB_WM_COMP_MGR (home->priv->comp_mgr)->wm;
   MBWindowManagerClient *client;
   HdLauncherApp *launcher_app;
   const char *service_name;
@@ -1137,7 +1181,7 @@ take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
 
   client = mb_wm_managed_client_from_xwindow (wm, xwin);
   if (!client || !client->window)
-    return FALSE;
+    goto reply;
 
   launcher_app = hd_comp_mgr_client_get_launcher (
                                 HD_COMP_MGR_CLIENT (client->cm_client));
@@ -1145,7 +1189,7 @@ take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
     {
       g_warning ("Window 0x%lx did not have an application associated"
                  " with it", client->window->xwindow);
-      return FALSE;
+      goto reply;
     }
 
   service_name = hd_launcher_app_get_service (launcher_app);
@@ -1153,7 +1197,7 @@ take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
     {
       g_warning ("Window 0x%lx has no sane service name",
                  client->window->xwindow);
-      return FALSE; /* daft service name, don't get a loading pic */
+      goto reply; /* daft service name, don't get a loading pic */
     }
 
   filename = g_strdup_printf ("%s/.cache/launch", getenv("HOME"));
@@ -1172,17 +1216,17 @@ take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
   if (take)
   {
     Pixmap                          pixmap;
-    GdkPixbuf                      *pixbuf;
     guint                           depth;
     guint                           width, height;
     ClutterActor                   *actor, *texture;
+    HdHomeScreenshotReply          *reply;
 
     if (g_file_test (filename, G_FILE_TEST_EXISTS))
       {
         g_debug ("%s: not creating '%s', already exists",
                  __func__, filename);
         g_free (filename);
-        return FALSE;
+        goto reply;
       }
 
     actor = mb_wm_comp_mgr_clutter_client_get_actor (
@@ -1198,16 +1242,28 @@ take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
     /* We could call mb_wm_theme_get_decor_dimensions() here and take out
      * the titlebar, etc, but in practice these aren't drawn on the loading
      * image so we have to keep them on. */
-    pixbuf = gdk_pixbuf_xlib_get_from_drawable (NULL, pixmap,
-                             xlib_rgb_get_cmap(), xlib_rgb_get_visual(),
-                             0, 0, 0, 0, width, height);
-    isok = hd_pvr_texture_save (filename, pixbuf, NULL);
-    g_object_unref (pixbuf);
+    reply = g_slice_new (HdHomeScreenshotReply);
+    reply->home = home;
+    reply->xwin = xwin;
+    reply->serial = serial;
+    if (hd_screenshot_save_pixmap (wm->xdpy, pixmap, width, height, depth,
+                                   filename,
+                                   (HdScreenshotSavedFunc)screenshot_saved,
+                                   reply))
+      { /* screenshot_saved() will reply. */
+        g_free (filename);
+        return;
+      }
+    g_slice_free (HdHomeScreenshotReply, reply);
   } else
     isok = unlink (filename) == 0;
 
   g_free (filename);
-  return isok;
+  send_screenshot_reply (home, xwin, serial, isok);
+  return;
+
+reply:
+  send_screenshot_reply (home, xwin, serial, FALSE);
 }
 
 void
@@ -1222,8 +1278,6 @@ hd_home_set_live_background (HdHome *home, MBWindowManagerClient *client)
 static void
 root_window_client_message (XClientMessageEvent *event, HdHome *home)
 {
-  HdHomePrivate *priv = home->priv;
-  MBWindowManager *wm = MB_WM_COMP_MGR (priv->comp_mgr)->wm;
   HdCompMgr     *hmgr = HD_COMP_MGR (home->priv->comp_mgr);
 
 #if 0 //  FIXME should we really support NET_CURRENT_DESKTOP?
@@ -1239,23 +1293,9 @@ root_window_client_message (XClientMessageEvent *event, HdHome *home)
   if (event->message_type == hd_comp_mgr_get_atom (hmgr,
                                      HD_ATOM_HILDON_LOADING_SCREENSHOT))
     {
-      XEvent reply;
-
-      /* Tell the client when the operation is complete. */
-      reply.xclient.type = ClientMessage;
-      reply.xclient.window = event->data.l[1];
-      reply.xclient.message_type = hd_comp_mgr_get_atom (hmgr,
-                                   HD_ATOM_HILDON_LOADING_SCREENSHOT);
-      reply.xclient.format = 32;
-      reply.xclient.data.l[0] = event->serial;
-      reply.xclient.data.l[1] = take_screenshot (wm, event->data.l[1],
-                                                 event->data.l[0] != 1);
-
-      mb_wm_util_async_trap_x_errors (wm->xdpy);
-      XSendEvent (wm->xdpy, reply.xclient.window, False,
-                  NoEventMask, &reply);
-      XFlush (wm->xdpy);
-      mb_wm_util_async_untrap_x_errors ();
+      /* The client is told when the operation is complete. */
+      take_screenshot (home, event->data.l[1], event->serial,
+                       event->data.l[0] != 1);
     }
 }
 
@@ -2817,3 +2857,11 @@ hd_home_is_desktop_in_portrait_mode (void)
 	return STATE_IS_PORTRAIT (hd_render_manager_get_state ());
 }
 
+/* D-Bus method returning who holds how much texture memory and
+ * the @top_n biggest allocations. */
+gchar *
+hd_home_get_texture_memory_report (HdHome *home, guint top_n)
+{
+  return tidy_texture_accounting_report (top_n);
+}
+
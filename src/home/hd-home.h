@@ -112,6 +112,7 @@ gboolean hd_home_get_vertical_scrolling (HdHome *home);
 gboolean hd_home_is_portrait_wallpaper_enabled (HdHome *home);
 
 gboolean hd_home_is_desktop_in_portrait_mode (void);
+gchar *hd_home_get_texture_memory_report (HdHome *home, guint top_n);
 
 extern gboolean in_alt_tab;
 
@@ -40,14 +40,18 @@
 #include <math.h>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/inotify.h>
 
 #include <gtk/gtk.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <clutter/clutter.h>
 #include <tidy/tidy-finger-scroll.h>
 #include <tidy/tidy-desaturation-group.h>
+#include <tidy/tidy-texture-accounting.h>
 
 #include <matchbox/core/mb-wm.h>
 #include <matchbox/comp-mgr/mb-wm-comp-mgr.h>
@@ -67,6 +71,8 @@
 #include "hd-util.h"
 #include "hd-gtk-style.h"
 #include "hd-app-mgr.h"
+#include "hd-image-loader.h"
+#include "hd-prop-cache.h"
 /* }}} */
 
 /* Standard definitions {{{ */
@@ -461,10 +467,20 @@ typedef struct
        *                  .video.  Used to decide if it should be refreshed.
        * -- @video:       The downsampled texture of the image loaded from
        *                  .video_fname or %NULL.
+       * -- @video_pixbuf: .video_fname decoded and downscaled in the
+       *                  background, waiting to replace .video.
+       * -- @video_request: The pending background decoding of
+       *                  .video_fname or %NULL.
+       *
+       * .video_mtime is kept up to date by watching the directory of
+       * .video_fname, so entering the switcher needn't touch the disk.
+       * It's 0 if there's no video screenshot.
        */
       ClutterActor        *video;
       const gchar         *video_fname;
       time_t               video_mtime;
+      GdkPixbuf           *video_pixbuf;
+      HdImageRequest      *video_request;
     };
 
     /* Currently we don't have notification-specific fields. */
@@ -503,95 +519,81 @@ typedef struct
   void (*clip)    (ClutterActor *actor, gint appgw, gint appwh);
 } Flyops;
 
-/* For linear_effect(), resize_effect() and turnoff_effect(). */
+/*
+ * Kinds of effects known by the effect engine.  An effect is identified
+ * by its actor and kind; an actor can have at most one effect of each kind
+ * running at a time.
+ */
+typedef enum
+{
+  EFFECT_MOVE,
+  EFFECT_RESIZE,
+  EFFECT_SCALE,
+  EFFECT_ROTATE_Z,
+  EFFECT_CLIP,
+  EFFECT_FADE,
+  EFFECT_TURNOFF,
+} EffectKind;
+
+/* What to do when a fade() completes. */
+enum final_fade_action_t
+{
+  FINALLY_REST,   /* Nothing is necessary. */
+  FINALLY_HIDE,   /* Hide the other actor. */
+  FINALLY_REMOVE, /* Remove the faded actor from the other actor. */
+};
+
+/* Auxiliary data of turnoff_effect(). */
 typedef struct
 {
   /*
-   * @actor:                    The actor to be animated (refed).
-   *                            In case of turnoff_effect() it is
-   *                            a thwin.
-   * @timeline:                 Used when one wants to cancel an effect
-   *                            outside of the timeline.
-   * @new_frame_cb_id, @timeline_complete_cb_id:
-   *                            %ClutterTimeline signal handler IDs
-   *                            @new_frame_cb_id can be 0.
-   * @frame_fun:                Just about any value that can identify
-   *                            an effect.  Typically the effect's
-   *                            new-frame callback.  Can be %NULL.
+   * @particles:                The little stars dancing in the background
+   *                            of the squeezing thumbnail.  @ang0 is the
+   *                            initial angle of a particle.
+   * @all_particles:            Container of all the particles.  Used to
+   *                            help positioning and setting and to set
+   *                            uniform opacity.
    */
-  ClutterActor *actor;
-  ClutterTimeline *timeline;
-  gulong new_frame_cb_id, timeline_complete_cb_id;
-  gconstpointer effectid;
-
-  /* Effect-specific context */
-  union
+  struct
   {
-    /* For linear_effect()s. */
-    struct
-    {
-      /*
-       * In each frame a number of properties of @actor is changed lineraly,
-       * such as width and height.  Each property has its own structure.
-       * The number of properties that can be controlled by such an effect
-       * is limited by the the number of elements in the array.
-       */
-      struct
-      {
-        /*
-         * @init:             The property's value at the start of the effect.
-         * @diff:             By the end of effect how much the property should
-         *                    be different with regards to @init.
-         */
-        gfloat init, diff;
-      } linear[2];
-
-      /* Auxiliary instruction for linear_effect()s. */
-      union
-      {
-        /* For fade(). */
-        struct
-        {
-          /* What to do when the effect completes. */
-          enum final_fade_action_t
-          {
-            FINALLY_REST,   /* Nothing is necessary. */
-            FINALLY_HIDE,   /* Hide @another_actor. */
-            FINALLY_REMOVE, /* Remove EffectClosure::actor
-                             * from @another_actor. */
-          } finally;
-
-          ClutterActor *another_actor;
-        };
-      };
-    };
+    gdouble ang0;
+    ClutterActor *particle;
+  } particles[HDCM_UNMAP_PARTICLES];
+  ClutterActor *all_particles;
+} TurnoffParticles;
 
-    /* This is used by resize_effect() on __armel__. */
-    struct
-    { /* The final dimensions of @actor. */
-      guint width, height;
-    };
+/* Parameters of a linear effect, one for each property it controls. */
+typedef gfloat EffectPair[2];
 
-    /* For turnoff_effect() */
-    struct
-    {
-      /*
-       * @particles:                The little stars dancing in the background
-       *                            of the squeezing thumbnail.  @ang0 is the
-       *                            initial angle of a particle.
-       * @all_particles:            Container of all the particles.  Used to
-       *                            help positioning and setting and to set
-       *                            uniform opacity.
-       */
-      struct
-      {
-        gdouble ang0;
-        ClutterActor *particle;
-      } particles[HDCM_UNMAP_PARTICLES];
-      ClutterActor *all_particles;
-    };
-  };
-} EffectClosure;
+/*
+ * The effect engine's table of running effects, stored column-wise
+ * so that a frame can advance all of them in a single pass without
+ * chasing per-effect allocations.  Row i describes one effect.
+ * -- @len, @size:      Number of rows used and allocated.
+ * -- @actor:           The actor to be animated (refed).  In case of
+ *                      turnoff_effect() it is a thwin.
+ * -- @timeline:        Which timeline drives the effect (refed).
+ * -- @kind:            An #EffectKind.
+ * -- @init, @diff:     Parameters of the lines linear effects follow:
+ *                      value = @init + @diff*progress.  A linear effect
+ *                      can control two properties of @actor at most.
+ *                      The deferred resize_effect() keeps the final
+ *                      dimensions in @init.
+ * -- @finally:         fade()'s %final_fade_action_t.
+ * -- @aux:             fade()'s another_actor (refed) or turnoff_effect()'s
+ *                      %TurnoffParticles.
+ */
+typedef struct
+{
+  guint len, size;
+  ClutterActor    **actor;
+  ClutterTimeline **timeline;
+  guint8           *kind;
+  EffectPair       *init;
+  EffectPair       *diff;
+  guint8           *finally;
+  gpointer         *aux;
+} EffectTable;
 
 /* Used by add_effect_closure() to store what to call when the effect
  * completes. */
@@ -599,11 +601,13 @@ typedef struct
 {
   /* @fun(@actor, @funparam) is what is called eventually.
    * @fun is not %NULL, @actor is g_object_ref()ed.
-   * @handler_id identifies the signal handler. */
+   * @timeline is what we're waiting for and @serial tells the order
+   * of registration. */
   ClutterEffectCompleteFunc    fun;
   ClutterActor                *actor;
   gpointer                     funparam;
-  gulong                       handler_id;
+  ClutterTimeline             *timeline;
+  guint                        serial;
 } EffectCompleteClosure;
 /* Clutter effect data structures }}} */
 /* Type definitions }}} */
@@ -748,13 +752,28 @@ static ClutterTimeline *Fly_effect_timeline, *Zoom_effect_timeline;
 static ClutterEffectTemplate *Fly_effect, *Zoom_effect;
 
 /*
- * The list of currently running effects created with new_effect().
+ * The currently running effects created with new_effect().
  * Practically these are all effects used for flying.  Used to learn
  * if a particular effect is already running and if so change it,
  * rather than dumbly adding a new effect and create races between
- * then two of them.  Contains pointers to %EffectClosure:s.
+ * then two of them.
  */
-static GPtrArray *Effects;
+static EffectTable Effects;
+
+/* %EffectCompleteClosure:s waiting for their timeline to complete
+ * and the serial number of the next one. */
+static GArray *EffectCompletions;
+static guint EffectCompletionSerial;
+
+/*
+ * Watching video screenshots.
+ * -- @Video_watcher:     inotify channel watching the directories of
+ *                        the screenshots.
+ * -- @Video_dirs:        Maps the inotify watch descriptors
+ *                        to directory names.
+ */
+static GIOChannel *Video_watcher;
+static GHashTable *Video_dirs;
 
 /* gtkrc articles */
 static const gchar *LargeSystemFont, *SystemFont, *SmallSystemFont;
@@ -794,7 +813,9 @@ pixbuf2texture (GdkPixbuf *pixbuf)
                                             gdk_pixbuf_get_rowstride (pixbuf),
                                             gdk_pixbuf_get_n_channels (pixbuf),
                                             0, &err);
-  if (!isok)
+  if (isok)
+    tidy_texture_accounting_watch (texture, "task-navigator");
+  else
     {
       g_warning ("clutter_texture_set_from_rgb_data: %s", err->message);
       g_object_unref (texture);
@@ -806,27 +827,15 @@ damage_control: __attribute__((unused))
   return texture;
 }
 
-/* Loads @fname, resizing and cropping it as necessary to fit
- * in a @aw x @ah rectangle.  Returns %NULL on error. */
-static ClutterActor *
-load_image (char const * fname, guint aw, guint ah)
+/* Resizes and crops @pixbuf as necessary to fit in a @aw x @ah rectangle,
+ * consuming it.  It's a #HdImageScaleFunc, run by the image loader
+ * in a worker thread. */
+static GdkPixbuf *
+scale_image (GdkPixbuf * pixbuf, gint aw, gint ah, gpointer unused)
 {
-  GError *err;
-  GdkPixbuf *pixbuf;
   gint dx, dy;
   gdouble dsx, dsy, scale;
   guint vw, vh, sw, sh, dw, dh;
-  ClutterActor *final;
-  ClutterActor *texture;
-
-  /* On error the caller sure has better recovery plan than an
-   * empty rectangle.  (ie. showing the real application window). */
-  err = NULL;
-  if (!(pixbuf = gdk_pixbuf_new_from_file (fname, &err)))
-    {
-      g_warning ("%s: %s", fname, err->message);
-      return NULL;
-    }
 
   /* @sw, @sh := size in pixels of the untransformed image. */
   sw = gdk_pixbuf_get_width (pixbuf);
@@ -893,6 +902,25 @@ load_image (char const * fname, guint aw, guint ah)
       pixbuf = tmp;
     }
 
+  return pixbuf;
+}
+
+/* Turns @pixbuf, a scale_image()d image into an actor that appears
+ * as if it were @aw x @ah large, destroying @pixbuf.  Returns %NULL
+ * on error. */
+static ClutterActor *
+image2actor (GdkPixbuf * pixbuf, guint aw, guint ah)
+{
+  guint vw, vh, dw, dh;
+  ClutterActor *final;
+  ClutterActor *texture;
+
+  /* See scale_image() for the meaning of these. */
+  vw = aw / 2;
+  vh = ah / 2;
+  dw = gdk_pixbuf_get_width (pixbuf);
+  dh = gdk_pixbuf_get_height (pixbuf);
+
   if (!(texture = pixbuf2texture (pixbuf)))
     return NULL;
 
@@ -1046,81 +1074,148 @@ need_to_animate (ClutterActor * actor)
 
 /* Effects infrastructure {{{ */
 /* General {{{ */
-/* Returns whether @actos has an effect with @frame_fun.  Effects can use it
- * to recognize themselves and modify the existing one rather than starting
- * a new. */
-static EffectClosure *
-has_effect (ClutterActor * actor, gconstpointer effectid)
+static void effects_new_frame (ClutterTimeline * timeline, gint frame,
+                               gpointer unused);
+static void effects_completed (ClutterTimeline * timeline, gpointer unused);
+
+/* Returns the row of @actor's @kind effect in @Effects or -1 if it hasn't
+ * got one.  Effects can use it to recognize themselves and modify the
+ * existing one rather than starting a new. */
+static gint
+find_effect (ClutterActor * actor, EffectKind kind)
 {
   guint i;
-  EffectClosure *closure;
 
-  if (!Effects)
-    return NULL;
+  for (i = 0; i < Effects.len; i++)
+    if (Effects.actor[i] == actor && Effects.kind[i] == kind)
+      return i;
+  return -1;
+}
 
-  /* Find @actor and @frame_fun in @Effects. */
-  for (i = 0; i < Effects->len; i++)
-    {
-      closure = g_ptr_array_index (Effects, i);
-      if (closure->actor == actor && closure->effectid == effectid)
-        return closure;
-    }
+/* Returns whether @actor has a @kind effect running. */
+static inline gboolean
+has_effect (ClutterActor * actor, EffectKind kind)
+{
+  return find_effect (actor, kind) >= 0;
+}
 
-  return NULL;
+/* Make sure @Effects has room for at least one more row. */
+static void
+grow_effects (void)
+{
+  if (Effects.len < Effects.size)
+    return;
+
+  Effects.size     = Effects.size ? Effects.size * 2 : 32;
+  Effects.actor    = g_renew (ClutterActor *,    Effects.actor,    Effects.size);
+  Effects.timeline = g_renew (ClutterTimeline *, Effects.timeline, Effects.size);
+  Effects.kind     = g_renew (guint8,            Effects.kind,     Effects.size);
+  Effects.init     = g_renew (EffectPair,        Effects.init,     Effects.size);
+  Effects.diff     = g_renew (EffectPair,        Effects.diff,     Effects.size);
+  Effects.finally  = g_renew (guint8,            Effects.finally,  Effects.size);
+  Effects.aux      = g_renew (gpointer,          Effects.aux,      Effects.size);
+}
+
+/* Hook the effect engine onto @timeline unless it's already done.
+ * All effects of a timeline are driven by these two handlers. */
+static void
+attach_effects (ClutterTimeline * timeline)
+{
+  if (g_object_get_data (G_OBJECT (timeline), "hd-effects"))
+    return;
+
+  g_signal_connect (timeline, "new-frame",
+                    G_CALLBACK (effects_new_frame), NULL);
+  g_signal_connect (timeline, "completed",
+                    G_CALLBACK (effects_completed), NULL);
+  g_object_set_data (G_OBJECT (timeline), "hd-effects",
+                     GINT_TO_POINTER (TRUE));
 }
 
-/* Allocates an #EffectClosure and fills in the common fields.
- * Adds signals to @timeline. */
-static EffectClosure *
+/* Adds a row for a @kind effect of @actor to @Effects and starts
+ * @timeline.  Returns the index of the new row. */
+static guint
 new_effect (ClutterTimeline * timeline, ClutterActor * actor,
-  void (*frame_fun)(ClutterTimeline *, gint, EffectClosure *),
-  void (*complete_fun)(ClutterTimeline *, EffectClosure *))
+            EffectKind kind)
 {
-  EffectClosure *closure;
+  guint i;
 
-  closure = g_slice_new0 (EffectClosure);
-  closure->actor = g_object_ref (actor);
+  attach_effects (timeline);
+  grow_effects ();
 
-  if (frame_fun)
-    closure->new_frame_cb_id = g_signal_connect (timeline, "new-frame",
-                                                 G_CALLBACK (frame_fun),
-                                                 closure);
-  else
-    closure->new_frame_cb_id = 0;
-  closure->timeline_complete_cb_id = g_signal_connect (timeline, "completed",
-                                              G_CALLBACK (complete_fun),
-                                              closure);
+  i = Effects.len++;
+  Effects.actor[i]    = g_object_ref (actor);
+  Effects.timeline[i] = g_object_ref (timeline);
+  Effects.kind[i]     = kind;
+  Effects.init[i][0]  = Effects.init[i][1] = 0;
+  Effects.diff[i][0]  = Effects.diff[i][1] = 0;
+  Effects.finally[i]  = FINALLY_REST;
+  Effects.aux[i]      = NULL;
 
-  closure->timeline = g_object_ref (timeline);
   clutter_timeline_start (timeline);
+  return i;
+}
+
+/* Removes row @i from @Effects without releasing what it references.
+ * Moves the last row in its place. */
+static void
+remove_effect_row (guint i)
+{
+  guint last;
 
-  /* Register @closure in @Effects. */
-  if (G_UNLIKELY (!Effects))
-    Effects = g_ptr_array_new ();
-  closure->effectid = frame_fun;
-  g_ptr_array_add (Effects, closure);
+  g_assert (i < Effects.len);
+  last = --Effects.len;
+  if (i == last)
+    return;
 
-  return closure;
+  Effects.actor[i]    = Effects.actor[last];
+  Effects.timeline[i] = Effects.timeline[last];
+  Effects.kind[i]     = Effects.kind[last];
+  Effects.init[i][0]  = Effects.init[last][0];
+  Effects.init[i][1]  = Effects.init[last][1];
+  Effects.diff[i][0]  = Effects.diff[last][0];
+  Effects.diff[i][1]  = Effects.diff[last][1];
+  Effects.finally[i]  = Effects.finally[last];
+  Effects.aux[i]      = Effects.aux[last];
 }
 
-/* Undoes new_effect().  Must be called at the end of effect.
- * If @timeline is still running the effect is cancelled
- * without further ado. */
+/* Releases the auxiliary data of a @kind effect. */
 static void
-free_effect (ClutterTimeline * timeline, EffectClosure * closure)
+free_effect_aux (EffectKind kind, gpointer aux)
 {
-  if (!Effects) /* I'd love to tease kuzak with a grif(:) */
-    g_critical ("no Effects");
-  else if (!g_ptr_array_remove_fast (Effects, closure))
-    g_critical ("closure not in Effects");
-  g_assert (timeline == closure->timeline);
+  if (!aux)
+    return;
+  if (kind == EFFECT_FADE)
+    g_object_unref (aux);
+  else if (kind == EFFECT_TURNOFF)
+    g_slice_free (TurnoffParticles, aux);
+}
+
+/* Undoes new_effect().  If the effect's timeline is still running
+ * the effect is cancelled without further ado. */
+static void
+free_effect (guint i)
+{
+  ClutterActor *actor;
+  ClutterTimeline *timeline;
+
+  actor = Effects.actor[i];
+  timeline = Effects.timeline[i];
+  free_effect_aux (Effects.kind[i], Effects.aux[i]);
+  remove_effect_row (i);
 
-  if (closure->new_frame_cb_id)
-    g_signal_handler_disconnect (timeline, closure->new_frame_cb_id);
-  g_signal_handler_disconnect (timeline, closure->timeline_complete_cb_id);
   g_object_unref (timeline);
-  g_object_unref (closure->actor);
-  g_slice_free (EffectClosure, closure);
+  g_object_unref (actor);
+}
+
+/* Cancels @actor's @kind effect if it has one. */
+static void
+cancel_effect (ClutterActor * actor, EffectKind kind)
+{
+  gint i;
+
+  if ((i = find_effect (actor, kind)) >= 0)
+    free_effect (i);
 }
 /* General }}} */
 
@@ -1128,35 +1223,31 @@ free_effect (ClutterTimeline * timeline, EffectClosure * closure)
 /*
  * Start or continue a linear effect on @actor during which one or more
  * properties of @actor are changed linearly depending on the current
- * progress of @timeline.  If @actor doesn't have a @frame_fun effect yet,
- * it starts a new one.  The named parameters have the same meaning as
- * in new_effect().  The varadic argument list should be pairs of %gdouble:s
- * teminated by a NAN.  Each pair describes the endpoint values of a property.
- * If an effect is already running it is altered such that by the end of
- * @timline the properties will reach their final intended values without
- * jumping.  In @frame_fun the current value of the properties can be
- * queried with linear_effect_value().
+ * progress of @timeline.  If @actor doesn't have a @kind effect yet,
+ * it starts a new one.  The varadic argument list should be pairs of
+ * %gdouble:s teminated by a NAN.  Each pair describes the endpoint values
+ * of a property.  If an effect is already running it is altered such that
+ * by the end of @timline the properties will reach their final intended
+ * values without jumping.  Returns the effect's row in @Effects.
  */
-static EffectClosure *
+static guint
 linear_effect (ClutterTimeline * timeline, ClutterActor * actor,
-               void (*frame_fun)(ClutterTimeline *, gint, EffectClosure *),
-               void (*complete_fun)(ClutterTimeline *, EffectClosure *),
-               ...)
+               EffectKind kind, ...)
 {
-  guint i;
+  gint i;
+  guint n;
   va_list list;
   gfloat init, final;
-  EffectClosure *closure;
 
-  va_start (list, complete_fun);
-  if (G_LIKELY (!(closure = has_effect (actor, frame_fun))))
+  va_start (list, kind);
+  if (G_LIKELY ((i = find_effect (actor, kind)) < 0))
     {
       /* @init and @diff are parameters of the line. */
-      closure = new_effect (timeline, actor, frame_fun, complete_fun);
-      for (i = 0; !isnanf (init = va_arg (list, gdouble)); i++)
-        { g_assert (i < G_N_ELEMENTS (closure->linear));
-          closure->linear[i].init = init;
-          closure->linear[i].diff = va_arg (list, gdouble) - init;
+      i = new_effect (timeline, actor, kind);
+      for (n = 0; !isnanf (init = va_arg (list, gdouble)); n++)
+        { g_assert (n < G_N_ELEMENTS (Effects.init[i]));
+          Effects.init[i][n] = init;
+          Effects.diff[i][n] = va_arg (list, gdouble) - init;
         }
     }
   else
@@ -1168,39 +1259,21 @@ linear_effect (ClutterTimeline * timeline, ClutterActor * actor,
        *
        * As @timeline may not be the already running one ignore it.
        */
-      gfloat now = clutter_timeline_get_progress (closure->timeline);
-      for (i = 0; !isnanf (init = va_arg (list, gdouble)); i++)
-        { g_assert (i < G_N_ELEMENTS (closure->linear));
+      gfloat now = clutter_timeline_get_progress (Effects.timeline[i]);
+      for (n = 0; !isnanf (init = va_arg (list, gdouble)); n++)
+        { g_assert (n < G_N_ELEMENTS (Effects.init[i]));
           final = va_arg (list, gdouble);
-          closure->linear[i].diff = (final-init) / (1-now);
-          closure->linear[i].init = final - closure->linear[i].diff;
+          Effects.diff[i][n] = (final-init) / (1-now);
+          Effects.init[i][n] = final - Effects.diff[i][n];
         }
     }
   va_end (list);
 
-  return closure;
-}
-
-/* Return the value of @which property at @now. */
-static inline gfloat __attribute__((pure))
-linear_effect_value (const EffectClosure * closure, guint which, gfloat now)
-{ g_assert (which < G_N_ELEMENTS (closure->linear));
-  return closure->linear[which].init + closure->linear[which].diff*now;
+  return i;
 }
 /* Linear effects }}} */
 
 /* Effect closures {{{ */
-/* add_effect_closure()'s #ClutterTimeline::completed handler. */
-static void
-call_effect_closure (ClutterTimeline * timeline,
-                     EffectCompleteClosure *closure)
-{
-  g_signal_handler_disconnect (timeline, closure->handler_id);
-  closure->fun (closure->actor, closure->funparam);
-  g_object_unref (closure->actor);
-  g_slice_free (EffectCompleteClosure, closure);
-}
-
 /* If @fun is not %NULL call it with @actor and @funparam when
  * @timeline is "completed".  Otherwise NOP. */
 static void
@@ -1208,20 +1281,173 @@ add_effect_closure (ClutterTimeline * timeline,
                     ClutterEffectCompleteFunc fun,
                     ClutterActor * actor, gpointer funparam)
 {
-  EffectCompleteClosure *closure;
+  EffectCompleteClosure closure;
 
   if (!fun)
     return;
 
-  closure = g_slice_new (EffectCompleteClosure);
-  closure->fun        = fun;
-  closure->actor      = g_object_ref (actor);
-  closure->funparam   = funparam;
-  closure->handler_id = g_signal_connect (timeline, "completed",
-                                          G_CALLBACK (call_effect_closure),
-                                          closure);
+  if (G_UNLIKELY (!EffectCompletions))
+    EffectCompletions = g_array_new (FALSE, FALSE,
+                                     sizeof (EffectCompleteClosure));
+
+  attach_effects (timeline);
+  closure.fun       = fun;
+  closure.actor     = g_object_ref (actor);
+  closure.funparam  = funparam;
+  closure.timeline  = timeline;
+  closure.serial    = EffectCompletionSerial++;
+  g_array_append_val (EffectCompletions, closure);
+}
+
+/* Calls the add_effect_closure()s waiting for @timeline in the order
+ * they were added.  Closures added meanwhile are left for the next time. */
+static void
+call_effect_closures (ClutterTimeline * timeline)
+{
+  guint i, until;
+  EffectCompleteClosure closure;
+
+  if (!EffectCompletions)
+    return;
+
+  until = EffectCompletionSerial;
+  for (;;)
+    {
+      /* Rescan from the beginning every time, because @fun may have
+       * completed other timelines, reshuffling @EffectCompletions. */
+      for (i = 0; i < EffectCompletions->len; i++)
+        {
+          closure = g_array_index (EffectCompletions,
+                                   EffectCompleteClosure, i);
+          if (closure.timeline == timeline && closure.serial < until)
+            break;
+        }
+      if (i >= EffectCompletions->len)
+        break;
+
+      g_array_remove_index (EffectCompletions, i);
+      closure.fun (closure.actor, closure.funparam);
+      g_object_unref (closure.actor);
+    }
 }
 /* Effect closures }}} */
+
+/* Effect engine {{{ */
+static void turnoff_effect_frame (ClutterActor * thwin,
+                                  TurnoffParticles * turnoff, gdouble now);
+
+/* The effect engine's #ClutterTimeline::new-frame handler.
+ * Advances all effects of @timeline in one go. */
+static void
+effects_new_frame (ClutterTimeline * timeline, gint frame, gpointer unused)
+{
+  guint i;
+  gfloat now, v0, v1;
+
+  now = clutter_timeline_get_progress (timeline);
+  for (i = 0; i < Effects.len; i++)
+    {
+      if (Effects.timeline[i] != timeline)
+        continue;
+
+      v0 = Effects.init[i][0] + Effects.diff[i][0]*now;
+      v1 = Effects.init[i][1] + Effects.diff[i][1]*now;
+      switch (Effects.kind[i])
+        {
+          case EFFECT_MOVE:
+            clutter_actor_set_position (Effects.actor[i], v0, v1);
+            break;
+          case EFFECT_RESIZE:
+#ifdef __i386__
+            clutter_actor_set_size (Effects.actor[i], v0, v1);
+#endif /* On __armel__ the resize is deferred until completion. */
+            break;
+          case EFFECT_SCALE:
+            clutter_actor_set_scale (Effects.actor[i], v0, v1);
+            break;
+          case EFFECT_ROTATE_Z:
+            clutter_actor_set_rotation_z (Effects.actor[i], v0, v1);
+            break;
+          case EFFECT_CLIP:
+            set_clip (Effects.actor[i], v0, v1);
+            break;
+          case EFFECT_FADE:
+            clutter_actor_set_opacity (Effects.actor[i], v0);
+            break;
+          case EFFECT_TURNOFF:
+            turnoff_effect_frame (Effects.actor[i], Effects.aux[i], now);
+            break;
+        }
+    }
+}
+
+/* Does whatever a @kind effect of @actor needs to do when it's finished.
+ * Its row is already removed from @Effects by then. */
+static void
+finish_effect (EffectKind kind, ClutterActor * actor, const gfloat * init,
+               enum final_fade_action_t finally, gpointer aux)
+{
+  switch (kind)
+    {
+      case EFFECT_RESIZE:
+#ifndef __i386__
+        clutter_actor_set_size (actor, init[0], init[1]);
+#endif
+        break;
+      case EFFECT_FADE:
+        if (finally == FINALLY_HIDE)
+          clutter_actor_hide (aux);
+        else if (finally == FINALLY_REMOVE)
+          clutter_container_remove_actor (CLUTTER_CONTAINER (aux), actor);
+        break;
+      case EFFECT_TURNOFF:
+        clutter_container_remove_actor (CLUTTER_CONTAINER (Navigator),
+                        ((TurnoffParticles *)aux)->all_particles);
+        break;
+      default:
+        break;
+    }
+}
+
+/* The effect engine's #ClutterTimeline::completed handler.
+ * Finishes all effects of @timeline, then calls the closures
+ * waiting for it. */
+static void
+effects_completed (ClutterTimeline * timeline, gpointer unused)
+{
+  guint i;
+
+  for (i = Effects.len; i-- > 0; )
+    {
+      gfloat init[2];
+      gpointer aux;
+      EffectKind kind;
+      ClutterActor *actor;
+      enum final_fade_action_t finally;
+
+      /* A finish_effect() may have cancelled others. */
+      if (i >= Effects.len || Effects.timeline[i] != timeline)
+        continue;
+
+      /* Take the row out of the table first because finish_effect()
+       * can start or cancel other effects. */
+      actor   = Effects.actor[i];
+      kind    = Effects.kind[i];
+      init[0] = Effects.init[i][0];
+      init[1] = Effects.init[i][1];
+      finally = Effects.finally[i];
+      aux     = Effects.aux[i];
+      remove_effect_row (i);
+
+      finish_effect (kind, actor, init, finally, aux);
+      free_effect_aux (kind, aux);
+      g_object_unref (actor);
+      g_object_unref (timeline);
+    }
+
+  call_effect_closures (timeline);
+}
+/* Effect engine }}} */
 /* }}} */
 
 /* RMS effects {{{ */
@@ -1253,20 +1479,10 @@ add_effect_closure (ClutterTimeline * timeline,
 
 /* This beautiful macro defines effect() and effect_effect().
  * @clutter_get_fun must have a signature (#ClutterActor, ptype*, ptype*),
- * while @clutter_set_fun is (#ClutterActor, ptype, ptype). */
-#define DEFINE_RMS_EFFECT(effect, ptype,                            \
+ * while @clutter_set_fun is (#ClutterActor, ptype, ptype).  The frames
+ * are rendered by effects_new_frame() according to @kind. */
+#define DEFINE_RMS_EFFECT(effect, kind, ptype,                      \
                           clutter_get_fun, clutter_set_fun)         \
-/* @effect's %ClutterTimeline::new-frame callback. */               \
-static void                                                         \
-effect##_effect_frame (ClutterTimeline * timeline, gint frame,      \
-                       EffectClosure * closure)                     \
-{                                                                   \
-  gfloat now = clutter_timeline_get_progress (timeline);            \
-  clutter_set_fun (closure->actor,                                  \
-                   linear_effect_value (closure, 0, now),           \
-                   linear_effect_value (closure, 1, now));          \
-}                                                                   \
-                                                                    \
 static void                                                         \
 effect##_effect (ClutterTimeline * timeline, ClutterActor * actor,  \
                  ptype final1, ptype final2)                        \
@@ -1274,8 +1490,7 @@ effect##_effect (ClutterTimeline * timeline, ClutterActor * actor,  \
   ptype init1, init2;                                               \
                                                                     \
   clutter_get_fun (actor, &init1, &init2);                          \
-  linear_effect (timeline, actor,                                   \
-                 effect##_effect_frame, free_effect,                \
+  linear_effect (timeline, actor, kind,                             \
                  (gdouble)init1, (gdouble)final1,                   \
                  (gdouble)init2, (gdouble)final2,                   \
                  NAN);                                              \
@@ -1290,55 +1505,35 @@ effect (ClutterActor * actor, ptype final1, ptype final2)           \
     clutter_set_fun (actor, final1, final2);                        \
 }
 
-DEFINE_RMS_EFFECT(move, gint,
+DEFINE_RMS_EFFECT(move, EFFECT_MOVE, gint,
                   clutter_actor_get_position, clutter_actor_set_position);
 static void
 check_and_move (ClutterActor * actor, gint xpos_new, gint ypos_new)
 {
-  EffectClosure *closure;
   gint xpos_now, ypos_now;
 
   clutter_actor_get_position (actor, &xpos_now, &ypos_now);
   if (xpos_now != xpos_new || ypos_now != ypos_new)
     move (actor, xpos_new, ypos_new);
-  else if ((closure = has_effect (actor, move_effect_frame)) != NULL)
-    free_effect (closure->timeline, closure);
+  else
+    cancel_effect (actor, EFFECT_MOVE);
 }
 
 /* On the gadget (or maybe in general if we're accelerated) we can't
  * resize continously because it blocks all effects and doesn't come
  * about anyway.  It's so even if we don't clip_on_resize(). */
 #ifdef __i386__
-DEFINE_RMS_EFFECT(resize, guint,
+DEFINE_RMS_EFFECT(resize, EFFECT_RESIZE, guint,
                   clutter_actor_get_size, clutter_actor_set_size);
-static void
-check_and_resize (ClutterActor * actor, gint width_new, gint height_new)
-{
-  EffectClosure *closure;
-  guint width_now, height_now;
-
-  clutter_actor_get_size (actor, &width_now, &height_now);
-  if (width_now != width_new || height_now != height_new)
-    resize (actor, width_new, height_new);
-  else if ((closure = has_effect (actor, resize_effect_frame)) != NULL)
-    free_effect (closure->timeline, closure);
-}
 #else /* __armel__ */
-static void resize_effect_complete (ClutterTimeline * timeline,
-                                    EffectClosure * closure)
-{
-  clutter_actor_set_size (closure->actor, closure->width, closure->height);
-  free_effect (timeline, closure);
-}
-
 static void
 resize_effect (ClutterTimeline * timeline, ClutterActor * actor,
                  guint wfinal, guint hfinal)
 {
+  gint i;
   guint width, height;
-  EffectClosure *closure;
 
-  closure = has_effect (actor, resize_effect);
+  i = find_effect (actor, EFFECT_RESIZE);
   clutter_actor_get_size (actor, &width, &height);
 
   /* Resize now if the final dimension is shorter than the current.
@@ -1347,8 +1542,8 @@ resize_effect (ClutterTimeline * timeline, ClutterActor * actor,
   if (wfinal < width && hfinal < height)
     {
       clutter_actor_set_size (actor, wfinal, hfinal);
-      if (closure)
-        free_effect (timeline, closure);
+      if (i >= 0)
+        free_effect (i);
       return;
     }
   else if (wfinal < width)
@@ -1356,13 +1551,10 @@ resize_effect (ClutterTimeline * timeline, ClutterActor * actor,
   else if (hfinal < height)
     clutter_actor_set_height (actor, hfinal);
 
-  if (!closure)
-    {
-      closure = new_effect (timeline, actor, NULL, resize_effect_complete);
-      closure->effectid = resize_effect_complete;
-    }
-  closure->width  = wfinal;
-  closure->height = hfinal;
+  if (i < 0)
+    i = new_effect (timeline, actor, EFFECT_RESIZE);
+  Effects.init[i][0] = wfinal;
+  Effects.init[i][1] = hfinal;
   clutter_timeline_start (timeline);
 }
 
@@ -1374,44 +1566,41 @@ resize (ClutterActor * actor, guint width, guint height)
   else
     clutter_actor_set_size (actor, width, height);
 }
+#endif /* __armel__ */
 
 static void
 check_and_resize (ClutterActor * actor, gint width_new, gint height_new)
 {
-  EffectClosure *closure;
   guint width_now, height_now;
 
   clutter_actor_get_size (actor, &width_now, &height_now);
   if (width_now != width_new || height_now != height_new)
     resize (actor, width_new, height_new);
-  else if ((closure = has_effect (actor, resize_effect_complete)) != NULL)
-    free_effect (closure->timeline, closure);
+  else
+    cancel_effect (actor, EFFECT_RESIZE);
 }
-#endif /* __armel__ */
 
-DEFINE_RMS_EFFECT(scale, gdouble,
+DEFINE_RMS_EFFECT(scale, EFFECT_SCALE, gdouble,
                   clutter_actor_get_scale, clutter_actor_set_scale);
 static void
 check_and_scale (ClutterActor * actor, gdouble sx_new, gdouble sy_new)
 {
-  EffectClosure *closure;
   gdouble sx_now, sy_now;
 
   /* Beware the rounding errors. */
   clutter_actor_get_scale (actor, &sx_now, &sy_now);
   if (fabs (sx_now - sx_new) > 0.0001 || fabs (sy_now - sy_new) > 0.0001)
     scale (actor, sx_new, sy_new);
-  else if ((closure = has_effect (actor, scale_effect_frame)) != NULL)
-    free_effect (closure->timeline, closure);
+  else
+    cancel_effect (actor, EFFECT_SCALE);
 }
 
-DEFINE_RMS_EFFECT(rotate_z, gfloat,
+DEFINE_RMS_EFFECT(rotate_z, EFFECT_ROTATE_Z, gfloat,
                   clutter_actor_get_rotation_z, clutter_actor_set_rotation_z)
 
 static void
 check_and_rotate_z (ClutterActor * actor, gfloat angle_new, gfloat z_new)
 {
-  EffectClosure *closure;
   gfloat angle_now;
   gint z_now;
 
@@ -1420,8 +1609,8 @@ check_and_rotate_z (ClutterActor * actor, gfloat angle_new, gfloat z_new)
 
   if (angle_now != angle_new || z_now != z_new)
     rotate_z (actor, angle_new, z_new);
-  else if ((closure = has_effect (actor, rotate_z_effect_frame)) != NULL)
-    free_effect (closure->timeline, closure);
+  else
+    cancel_effect (actor, EFFECT_ROTATE_Z);
 }
 
 static void
@@ -1439,12 +1628,11 @@ clutter_actor_get_rotation_z(ClutterActor * actor, gfloat * angle, gfloat * z)
     *z=_z;
 }
 
-DEFINE_RMS_EFFECT(clip, gint, get_clip, set_clip)
+DEFINE_RMS_EFFECT(clip, EFFECT_CLIP, gint, get_clip, set_clip)
 
 static void
 check_and_clip (ClutterActor * actor, gint appwgw, gint appwgh)
 {
-  EffectClosure *closure;
   gint appwgw_now,appwgh_now;
 
   if (!actor)
@@ -1454,8 +1642,8 @@ check_and_clip (ClutterActor * actor, gint appwgw, gint appwgh)
 
   if (appwgw_now != appwgw || appwgh_now != appwgh)
     clip (actor, appwgw, appwgh);
-  else if ((closure = has_effect (actor, clip_effect_frame)) != NULL)
-    free_effect (closure->timeline, closure);
+  else
+    cancel_effect (actor, EFFECT_CLIP);
 }
 
 static void
@@ -1476,70 +1664,45 @@ get_clip(ClutterActor * actor, gint * appwgw, gint * appwgh)
 /* RMS effects }}} */
 
 /* Fading effect {{{ */
-/* frame_fun of fade() */
-static void
-fade_frame (ClutterTimeline * timeline, gint frame, EffectClosure * closure)
-{
-  clutter_actor_set_opacity (closure->actor, linear_effect_value (closure, 0,
-    clutter_timeline_get_progress (timeline)));
-}
-
-/* complete_fun of fade() */
-static void
-fade_complete (ClutterTimeline * timeline, EffectClosure * closure)
-{
-  if (closure->finally == FINALLY_HIDE)
-    clutter_actor_hide (closure->another_actor);
-  else if (closure->finally == FINALLY_REMOVE)
-    clutter_container_remove_actor (CLUTTER_CONTAINER (closure->another_actor),
-                                    closure->actor);
-  if (closure->another_actor)
-    g_object_unref (closure->another_actor);
-  free_effect (timeline, closure);
-}
-
 /*
  * Starts fading @actor to @opacity, and do @finally something to
  * @another_actor when it's complete.  If there's already such an
  * effect in progress it's overridden together with its @finally
  * action.
  */
-static EffectClosure *
+static void
 fade (ClutterTimeline * timeline, ClutterActor * actor, guint opacity,
       enum final_fade_action_t finally, ClutterActor * another_actor)
 {
-  EffectClosure *closure;
+  guint i;
 
   g_assert ((finally == FINALLY_REST) == (another_actor == NULL));
-  closure = linear_effect (timeline, actor, fade_frame, fade_complete,
-                           (gdouble)clutter_actor_get_opacity(actor),
-                           (gdouble)opacity, NAN);
+  i = linear_effect (timeline, actor, EFFECT_FADE,
+                     (gdouble)clutter_actor_get_opacity(actor),
+                     (gdouble)opacity, NAN);
 
-  closure->finally = finally;
+  Effects.finally[i] = finally;
   if (another_actor)
     g_object_ref (another_actor);
-  if (closure->another_actor)
-    g_object_unref (closure->another_actor);
-  closure->another_actor = another_actor;
+  if (Effects.aux[i])
+    g_object_unref (Effects.aux[i]);
+  Effects.aux[i] = another_actor;
 
   clutter_timeline_start (timeline);
-  return closure;
 }
 
 /* The same as fade() except that it creates an independent disposable
  * %ClutterTimeline for $msecs for the effect. */
-static EffectClosure *
+static void
 fade_for_duration (guint msecs, ClutterActor * actor, guint opacity,
                    enum final_fade_action_t finally,
                    ClutterActor * another_actor)
 {
-  EffectClosure *closure;
   ClutterTimeline *timeline;
 
   timeline = clutter_timeline_new_for_duration (msecs);
-  closure = fade (timeline, actor, opacity, finally, another_actor);
+  fade (timeline, actor, opacity, finally, another_actor);
   g_object_unref (timeline);
-  return closure;
 }
 
 /* Cancels the ongoing fade() effect on @actor if there one.
@@ -1547,10 +1710,7 @@ fade_for_duration (guint msecs, ClutterActor * actor, guint opacity,
 static void
 reset_opacity (ClutterActor * actor, guint opacity, gboolean be_shown)
 {
-  EffectClosure *closure;
-
-  if ((closure = has_effect (actor, fade_frame)) != NULL)
-    free_effect (closure->timeline, closure);
+  cancel_effect (actor, EFFECT_FADE);
   clutter_actor_set_opacity (actor, opacity);
   if (be_shown)
     clutter_actor_show (actor);
@@ -1569,13 +1729,11 @@ turnoff_fun (gdouble x0, gdouble y0, gdouble x1, gdouble y1, gdouble t)
   return ((y1-y0)*cos(t) + (y0*cos(x1)-y1*cos(x0))) / (cos(x1)-cos(x0));
 }
 
-/* ClutterTimeline::new-frame callback for turnoff_effect(). */
+/* Renders a frame of turnoff_effect() for @now. */
 static void
-turnoff_effect_frame (ClutterTimeline * timeline, gint frame,
-                      EffectClosure * closure)
+turnoff_effect_frame (ClutterActor * thwin, TurnoffParticles * turnoff,
+                      gdouble now)
 {
-  gdouble now;
-
   // thwin scale-y    0.0 .. 0.4  cosine 1.0 .. 0.1
   // thwin scale-x    0.3 .. 0.64 cosine 1.0 .. 0.1
   // thwin opacity    0.5 .. 1.0  linear 255 .. 0.0
@@ -1583,15 +1741,14 @@ turnoff_effect_frame (ClutterTimeline * timeline, gint frame,
   // particle radius  0.5 .. 1.0  cosine 8.0 .. 72
   // particle angle   0.5 .. 1.0  linear 0.0 .. PI/2
   // particle scale   0.5 .. 1.0  linear 1.0 .. 0.5
-  now = clutter_timeline_get_progress (timeline);
 
   /* @thwin */
   if (now <= 0.8)
-    clutter_actor_set_scale (closure->actor,
+    clutter_actor_set_scale (thwin,
                  now <= 0.3 ? 1.0 : turnoff_fun (0.3, 1, 0.64, 0.1, now),
                  now >= 0.4 ? 0.1 : turnoff_fun (0.0, 1, 0.4,  0.1, now));
   if (0.5 <= now)
-    clutter_actor_set_opacity (closure->actor, 510 - 510*now);
+    clutter_actor_set_opacity (thwin, 510 - 510*now);
 
   /* @particles */
   if (0.5 <= now)
@@ -1601,34 +1758,24 @@ turnoff_effect_frame (ClutterTimeline * timeline, gint frame,
 
       t = 2*now-1;
       all_rad = turnoff_fun (0.5, 8, 1, 72, now);
-      for (i = 0; i < G_N_ELEMENTS (closure->particles); i++)
+      for (i = 0; i < G_N_ELEMENTS (turnoff->particles); i++)
         {
           gdouble ang, rad;
 
-          ang = closure->particles[i].ang0 + M_PI/2 * t;
-          rad = all_rad * i/G_N_ELEMENTS (closure->particles);
-          clutter_actor_set_position (closure->particles[i].particle,
+          ang = turnoff->particles[i].ang0 + M_PI/2 * t;
+          rad = all_rad * i/G_N_ELEMENTS (turnoff->particles);
+          clutter_actor_set_position (turnoff->particles[i].particle,
                                       cos(ang)*rad, sin(ang)*rad);
-          clutter_actor_set_scale (closure->particles[i].particle,
+          clutter_actor_set_scale (turnoff->particles[i].particle,
                                    1.5-now, 1.5-now);
         }
 
-      clutter_actor_set_opacity (closure->all_particles, 255*sin(M_PI*t));
-      if (!CLUTTER_ACTOR_IS_VISIBLE (closure->all_particles))
-        clutter_actor_show (closure->all_particles);
+      clutter_actor_set_opacity (turnoff->all_particles, 255*sin(M_PI*t));
+      if (!CLUTTER_ACTOR_IS_VISIBLE (turnoff->all_particles))
+        clutter_actor_show (turnoff->all_particles);
     }
 }
 
-/* ClutterTimeline::completed callback for turnoff_effect(). */
-static void
-turnoff_effect_complete (ClutterTimeline * timeline,
-                         EffectClosure * closure)
-{
-  clutter_container_remove_actor (CLUTTER_CONTAINER (Navigator),
-                                  closure->all_particles);
-  free_effect (timeline, closure);
-}
-
 /*
  * Do a TV-turned-off effect on @thwin: first squeeze it vertically,
  * then horizontally.  At the same time it is horozontally scaled
@@ -1641,29 +1788,28 @@ turnoff_effect (ClutterTimeline * timeline, ClutterActor * thwin)
 {
   guint i;
   gint centerx, centery;
-  EffectClosure *closure;
+  TurnoffParticles *turnoff;
 
-  closure = new_effect (timeline, thwin,
-                        turnoff_effect_frame,
-                        turnoff_effect_complete);
+  turnoff = g_slice_new (TurnoffParticles);
+  Effects.aux[new_effect (timeline, thwin, EFFECT_TURNOFF)] = turnoff;
 
   /* Scale @thwin in the middle. */
   clutter_actor_move_anchor_point_from_gravity (thwin,
                                                 CLUTTER_GRAVITY_CENTER);
 
-  /* Create @closure->all_particles.  Place it at the center of @thwin
+  /* Create @turnoff->all_particles.  Place it at the center of @thwin
    * and hide it initially because particles are shown later during the
    * effect. */
   clutter_actor_get_position (thwin,  &centerx, &centery);
   centery -= hd_scrollable_group_get_viewport_y (Grid);
-  closure->all_particles = clutter_group_new ();
-  clutter_actor_set_position (closure->all_particles, centerx, centery);
+  turnoff->all_particles = clutter_group_new ();
+  clutter_actor_set_position (turnoff->all_particles, centerx, centery);
   clutter_container_add_actor (CLUTTER_CONTAINER (Navigator),
-                               closure->all_particles);
-  clutter_actor_hide (closure->all_particles);
+                               turnoff->all_particles);
+  clutter_actor_hide (turnoff->all_particles);
 
-  /* Create @closure->particles and add them to @closure->all_particles. */
-  for (i = 0; i < G_N_ELEMENTS (closure->particles); i++)
+  /* Create @turnoff->particles and add them to @turnoff->all_particles. */
+  for (i = 0; i < G_N_ELEMENTS (turnoff->particles); i++)
     {
       ClutterActor *particle;
 
@@ -1671,13 +1817,13 @@ turnoff_effect (ClutterTimeline * timeline, ClutterActor * thwin)
                                                TRUE);
       clutter_actor_set_anchor_point_from_gravity (particle,
                                                    CLUTTER_GRAVITY_CENTER);
-      clutter_container_add_actor (CLUTTER_CONTAINER (closure->all_particles),
+      clutter_container_add_actor (CLUTTER_CONTAINER (turnoff->all_particles),
                                    particle);
 
       /* All particles has an own initial angle from which they go half
        * a circle until the end of animimation. */
-      closure->particles[i].ang0 = 2*M_PI * g_random_double ();
-      closure->particles[i].particle = particle;
+      turnoff->particles[i].ang0 = 2*M_PI * g_random_double ();
+      turnoff->particles[i].particle = particle;
     }
 }
 /* Boom effect }}} */
@@ -1798,7 +1944,7 @@ show_when_complete (ClutterActor * actor)
 static void
 fade_in_when_complete (ClutterActor * actor, gpointer msecs)
 {
-  if (has_effect (actor, fade_frame))
+  if (has_effect (actor, EFFECT_FADE))
     /* A fade-out by free_thumb() must be in progress, don't override it. */
     return;
   clutter_actor_set_opacity (actor, 0);
@@ -2498,6 +2644,8 @@ create_thwin (Thumbnail * thumb, ClutterActor * prison)
   clutter_container_add_actor (CLUTTER_CONTAINER (Grid), thumb->thwin);
 }
 
+static void cancel_video_request (Thumbnail * apthumb);
+
 /* Release everything related to @thumb.  If you want it can @animate the
  * death of @thumb by a simple fading out. */
 static void
@@ -2551,6 +2699,10 @@ free_thumb (Thumbnail * thumb, gboolean animate)
         mb_wm_object_signal_disconnect (MB_WM_OBJECT (thumb->win),
                                         thumb->win_changed_cb_id);
 
+      cancel_video_request (thumb);
+      if (thumb->video_pixbuf)
+        g_object_unref (thumb->video_pixbuf);
+
       g_free(thumb->saved_title);
       if (thumb->nodest)
         XFree (thumb->nodest);
@@ -2562,58 +2714,206 @@ free_thumb (Thumbnail * thumb, gboolean animate)
 
 /* Application thumbnails {{{ */
 /* Child adoption {{{ */
-/* Returns whether the application represented by @apthumb has
- * a video screenshot and it should be loaded or reloaded.
- * If so it refreshes @apthumb->video_mtime. */
-static gboolean
-need_to_load_video (Thumbnail * apthumb)
+/* Video screenshots {{{ */
+static void install_video (Thumbnail * apthumb);
+
+/* Called by the image loader with the decoded video screenshot
+ * of @apthumb. */
+static void
+video_loaded (GdkPixbuf * pixbuf, Thumbnail * apthumb)
 {
-  /* Already has a video loaded? */
-  if (apthumb->video)
+  apthumb->video_request = NULL;
+  if (!pixbuf)
+    return;
+
+  if (apthumb->video_pixbuf)
+    g_object_unref (apthumb->video_pixbuf);
+  apthumb->video_pixbuf = pixbuf;
+
+  /* If we're showing the thumbnail replace it right away,
+   * otherwise claim_win() will do it. */
+  if (hd_task_navigator_is_active ())
+    install_video (apthumb);
+}
+
+/* Forget about the pending loading of @apthumb's video screenshot
+ * if there's one. */
+static void
+cancel_video_request (Thumbnail * apthumb)
+{
+  if (apthumb->video_request)
     {
-      struct stat sbuf;
-      gboolean clear_video, load_video;
+      hd_image_loader_cancel (apthumb->video_request);
+      apthumb->video_request = NULL;
+    }
+}
 
-      /* Refresh or unload it? */
-      load_video = clear_video = FALSE;
-      g_assert (apthumb->video_fname);
-      if (stat (apthumb->video_fname, &sbuf) < 0)
-        {
-          if (errno != ENOENT)
-            g_warning ("%s: %m", apthumb->video_fname);
-          clear_video = TRUE;
-        }
-      else if (sbuf.st_mtime > apthumb->video_mtime)
+/* Start loading @apthumb's video screenshot in the background,
+ * downscaled to the size it will be shown in the navigator. */
+static void
+load_video_async (Thumbnail * apthumb)
+{
+  cancel_video_request (apthumb);
+  apthumb->video_request = hd_image_loader_load (apthumb->video_fname,
+                                    App_window_geometry_width,
+                                    App_window_geometry_height,
+                                    scale_image,
+                                    (HdImageLoadedFunc)video_loaded,
+                                    apthumb);
+}
+
+/* Checks whether @apthumb's video screenshot has changed since we've
+ * last seen it and if so reloads it in the background. */
+static void
+refresh_video (Thumbnail * apthumb)
+{
+  struct stat sbuf;
+
+  g_assert (apthumb->video_fname);
+  if (stat (apthumb->video_fname, &sbuf) < 0)
+    {
+      if (errno != ENOENT)
+        g_warning ("%s: %m", apthumb->video_fname);
+
+      /* Gone, claim_win() will remove .video. */
+      apthumb->video_mtime = 0;
+      cancel_video_request (apthumb);
+      if (apthumb->video_pixbuf)
         {
-          clear_video = load_video = TRUE;
-          apthumb->video_mtime = sbuf.st_mtime;
+          g_object_unref (apthumb->video_pixbuf);
+          apthumb->video_pixbuf = NULL;
         }
+    }
+  else if (sbuf.st_mtime != apthumb->video_mtime)
+    {
+      apthumb->video_mtime = sbuf.st_mtime;
+      load_video_async (apthumb);
+    }
+}
+
+/* @Video_watcher's callback.  Refreshes the video screenshots
+ * which have changed. */
+static gboolean
+video_dir_changed (GIOChannel * chnl, GIOCondition cond, gpointer unused)
+{
+  gssize len;
+  const gchar *dir;
+  gchar buf[1024], *p;
+  const struct inotify_event *ev;
+
+  if ((len = read (g_io_channel_unix_get_fd (chnl), buf, sizeof (buf))) <= 0)
+    {
+      if (len < 0 && errno != EAGAIN && errno != EINTR)
+        g_warning ("%s: %m", __FUNCTION__);
+      return TRUE;
+    }
+
+  for (p = buf; p < buf + len; p += sizeof (*ev) + ev->len)
+    {
+      GList *li;
+      Thumbnail *apthumb;
+      gchar *fname;
 
-      if (clear_video)
+      ev = (const struct inotify_event *)p;
+      if (!ev->len)
+        continue;
+      if (!(dir = g_hash_table_lookup (Video_dirs,
+                                       GINT_TO_POINTER (ev->wd))))
+        continue;
+
+      fname = g_build_filename (dir, ev->name, NULL);
+      for_each_appthumb (li, apthumb)
+        if (apthumb->video_fname && !strcmp (apthumb->video_fname, fname))
+          refresh_video (apthumb);
+      g_free (fname);
+    }
+
+  return TRUE;
+}
+
+/* Start watching the directory of @apthumb's video screenshot
+ * and load it if it exists. */
+static void
+watch_video (Thumbnail * apthumb)
+{
+  gint wd;
+  gchar *dir;
+
+  if (!apthumb->video_fname)
+    return;
+
+  if (G_UNLIKELY (!Video_watcher))
+    {
+      gint fd;
+
+      if ((fd = inotify_init ()) < 0)
+        g_warning ("inotify_init: %m");
+      else
         {
-          clutter_container_remove_actor (CLUTTER_CONTAINER (apthumb->prison),
-                                          apthumb->video);
-          apthumb->video = NULL;
+          fcntl (fd, F_SETFL, O_NONBLOCK);
+          Video_watcher = g_io_channel_unix_new (fd);
+          g_io_channel_set_close_on_unref (Video_watcher, TRUE);
+          g_io_add_watch (Video_watcher, G_IO_IN, video_dir_changed, NULL);
+          Video_dirs = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                              NULL, g_free);
         }
-
-      return load_video;
     }
-  else if (apthumb->video_fname)
+
+  /* Watching the same directory again returns the same descriptor.
+   * The directories are never unwatched, there are only a few of them. */
+  dir = g_path_get_dirname (apthumb->video_fname);
+  if (Video_watcher
+      && (wd = inotify_add_watch (g_io_channel_unix_get_fd (Video_watcher),
+                                  dir, IN_CLOSE_WRITE | IN_MOVED_TO
+                                       | IN_DELETE | IN_MOVED_FROM)) >= 0)
+    g_hash_table_replace (Video_dirs, GINT_TO_POINTER (wd), dir);
+  else
+    g_free (dir);
+
+  refresh_video (apthumb);
+}
+
+/* Brings @apthumb's .video up to date with what we've loaded
+ * in the background and shows it or the application window. */
+static void
+install_video (Thumbnail * apthumb)
+{
+  /* Remove the current .video if it's outdated or gone. */
+  if (apthumb->video && (apthumb->video_pixbuf || !apthumb->video_mtime))
     {
-      struct stat sbuf;
+      clutter_container_remove_actor (CLUTTER_CONTAINER (apthumb->prison),
+                                      apthumb->video);
+      apthumb->video = NULL;
+    }
 
-      /* Do we need to load it? */
-      if (stat (apthumb->video_fname, &sbuf) == 0)
+  if (apthumb->video_pixbuf)
+    {
+      /* Make it appear as if .video were .apwin,
+       * having the same geometry. */
+      apthumb->video = image2actor (apthumb->video_pixbuf,
+                                    App_window_geometry_width,
+                                    App_window_geometry_height);
+      apthumb->video_pixbuf = NULL;
+      if (apthumb->video)
         {
-          apthumb->video_mtime = sbuf.st_mtime;
-          return TRUE;
+          clutter_actor_set_name (apthumb->video, "video");
+          clutter_actor_set_position (apthumb->video,
+                                      App_window_geometry_x,
+                                      App_window_geometry_y);
+          clutter_container_add_actor (CLUTTER_CONTAINER (apthumb->prison),
+                                       apthumb->video);
         }
-      else if (errno != ENOENT)
-        g_warning ("%s: %m", apthumb->video_fname);
     }
 
-  return FALSE;
+  if (!apthumb->video)
+    /* Needn't bother with show_all() the contents of .windows,
+     * they are shown anyway because of reparent(). */
+    clutter_actor_show (apthumb->windows);
+  else
+    /* Only show @apthumb->video. */
+    clutter_actor_hide (apthumb->windows);
 }
+/* Video screenshots }}} */
 
 /* Start managing @apthumb's application window and loads/reloads its
  * last-frame video screenshot if necessary.  Called when we enter
@@ -2648,33 +2948,9 @@ claim_win (Thumbnail * apthumb)
                          (GFunc)clutter_actor_reparent,
                          apthumb->windows);
 
-  /* Load the video screenshot and place its actor in the hierarchy. */
-  if (need_to_load_video (apthumb))
-    {
-      /* Make it appear as if .video were .apwin,
-       * having the same geometry. */
-      g_assert (!apthumb->video);
-      apthumb->video = load_image (apthumb->video_fname,
-				   App_window_geometry_width,
-				   App_window_geometry_height);
-      if (apthumb->video)
-        {
-          clutter_actor_set_name (apthumb->video, "video");
-          clutter_actor_set_position (apthumb->video,
-				      App_window_geometry_x,
-				      App_window_geometry_y);
-          clutter_container_add_actor (CLUTTER_CONTAINER (apthumb->prison),
-                                       apthumb->video);
-        }
-    }
-
-  if (!apthumb->video)
-    /* Needn't bother with show_all() the contents of .windows,
-     * they are shown anyway because of reparent(). */
-    clutter_actor_show (apthumb->windows);
-  else
-    /* Only show @apthumb->video. */
-    clutter_actor_hide (apthumb->windows);
+  /* Place the video screenshot we've loaded in the background
+   * in the hierarchy. */
+  install_video (apthumb);
 
   /* Restore the opacity/visibility of the actors that have been faded out
    * while zooming, so we won't have trouble if we happen to to need to enter
@@ -2735,7 +3011,7 @@ adopt_notification (Thumbnail * apthumb, TNote * tnote)
     }
   else
     { /* Make sure all opacities are reset to the normal values. */
-      g_assert (!has_effect (tnote->notwin, fade_frame));
+      g_assert (!has_effect (tnote->notwin, EFFECT_FADE));
       clutter_actor_hide (apthumb->prison);
       reset_opacity (apthumb->frame.all, 0, FALSE);
       reset_opacity (apthumb->close_notif_icon, 255, TRUE);
@@ -3258,6 +3534,7 @@ create_appthumb (ClutterActor * apwin)
   /* .video_fname */
   if ((app = hd_comp_mgr_client_get_launcher (HD_COMP_MGR_CLIENT (hmgrc))) != NULL)
     apthumb->video_fname = hd_launcher_app_get_switcher_icon (HD_LAUNCHER_APP (app));
+  watch_video (apthumb);
 
   /* Now the actors: .apwin, .titlebar, .windows. */
   apthumb->apwin = g_object_ref (apwin);
@@ -4714,30 +4991,39 @@ hd_task_navigator_update_win_orientation (Window xwindow, gboolean portrait)
     }
 }
 
+/* Returns the WM_CLIENT_LEADER of @xwin, a client window, or None.
+ * It comes from the property cache, being a property of the client. */
+static Window
+hd_task_navigator_get_client_leader (MBWindowManager *wm, Window xwin)
+{
+  const Window *leader;
+
+  leader = hd_prop_cache_get (wm, xwin,
+                    hd_comp_mgr_get_atom (HD_COMP_MGR (wm->comp_mgr),
+                                          HD_ATOM_WM_CLIENT_LEADER),
+                    XA_WINDOW, 32, 1, NULL);
+  return leader ? *leader : None;
+}
+
+/* The leader is usually an unmapped window which is not a client, so
+ * its #PropertyNotify:s are not selected and its properties can't be
+ * cached.  _HILDON_PORTRAIT_MODE_TASKNAV_DISABLE is read from the
+ * server every time, but it's only asked while in portrait mode in the
+ * task navigator. */
 gboolean
 hd_task_navigator_get_disable_portrait(MBWindowManagerClient *c)
 {
   Atom actual_type;
   int actual_format;
   unsigned long num_items, bytes_left;
-  unsigned char *ret_data_ptr = 0,*leader_data_ptr;
+  unsigned char *ret_data_ptr = 0;
   Display * dpy = c->wmref->xdpy;
+  Window leader;
   int result;
   gboolean disable_portrait=False;
 
-  mb_wm_util_async_trap_x_errors (dpy);
-
-  result = XGetWindowProperty (
-        dpy,
-        c->window->xwindow,
-        XInternAtom(dpy,"WM_CLIENT_LEADER",False),
-        0L, (~0L), False,
-        XA_WINDOW, &actual_type, &actual_format, &num_items,
-        &bytes_left, &leader_data_ptr);
-
-  mb_wm_util_async_untrap_x_errors ();
-
-  if ((result != Success) || !leader_data_ptr)
+  leader = hd_task_navigator_get_client_leader (c->wmref, c->window->xwindow);
+  if (leader == None)
   {
     g_warning("hd_task_navigator_get_disable_portrait - unable to get window leader.");
     return disable_portrait;
@@ -4747,16 +5033,15 @@ hd_task_navigator_get_disable_portrait(MBWindowManagerClient *c)
 
   result = XGetWindowProperty(
         dpy,
-        *(Window*)leader_data_ptr,
-        XInternAtom(dpy, "_HILDON_PORTRAIT_MODE_TASKNAV_DISABLE", False),
+        leader,
+        hd_comp_mgr_get_atom (HD_COMP_MGR (c->wmref->comp_mgr),
+                              HD_ATOM_HILDON_PORTRAIT_MODE_TASKNAV_DISABLE),
         0,1/*= one 32 bits item */ ,False,
         XA_CARDINAL, &actual_type, &actual_format, &num_items,
         &bytes_left, &ret_data_ptr);
 
   mb_wm_util_async_untrap_x_errors ();
 
-  XFree(leader_data_ptr);
-
   if (ret_data_ptr && (result == Success))
   {
     disable_portrait = *((int*)ret_data_ptr);
@@ -4771,35 +5056,27 @@ static void
 hd_task_navigator_set_disable_portrait(Thumbnail * thumb,gboolean disable)
 {
   Display * dpy=thumb->win->wm->xdpy;
+  Atom atom;
+  Window leader;
 
-  unsigned long nitems = 0;
-
-  Atom actual_type;
-  int actual_format;
-  unsigned long bytes;
-  unsigned char * leader_data_ptr = 0;
-
-  mb_wm_util_async_trap_x_errors (dpy);
-
-  int status = XGetWindowProperty (dpy, thumb->win->xwindow,
-                                   XInternAtom(dpy,"WM_CLIENT_LEADER",False), 0L, (~0L), False,
-                                   AnyPropertyType, &actual_type, &actual_format, &nitems, &bytes, &leader_data_ptr);
-  mb_wm_util_async_untrap_x_errors ();
-
-  if (status != Success || !leader_data_ptr)
+  leader = hd_task_navigator_get_client_leader (thumb->win->wm,
+                                                thumb->win->xwindow);
+  if (leader == None)
   {
     g_warning("hd_task_navigator_set_disable_portrait - unable to get window leader.");
     return;
   }
 
+  atom = hd_comp_mgr_get_atom (HD_COMP_MGR (thumb->win->wm->comp_mgr),
+                               HD_ATOM_HILDON_PORTRAIT_MODE_TASKNAV_DISABLE);
   mb_wm_util_async_trap_x_errors (dpy);
   if(disable)
   {
     gboolean value=True;
     XChangeProperty(
           dpy,
-          *(Window*)leader_data_ptr,
-          XInternAtom(dpy, "_HILDON_PORTRAIT_MODE_TASKNAV_DISABLE", False),
+          leader,
+          atom,
           XA_CARDINAL, 32, PropModeReplace,
           (unsigned char *)&value, 1);
   }
@@ -4807,15 +5084,13 @@ hd_task_navigator_set_disable_portrait(Thumbnail * thumb,gboolean disable)
   {
     XDeleteProperty(
           dpy,
-          *(Window*)leader_data_ptr,
-          XInternAtom(dpy, "_HILDON_PORTRAIT_MODE_TASKNAV_DISABLE", False));
+          leader,
+          atom);
     XSync(dpy, False);
   }
 
   mb_wm_util_async_untrap_x_errors ();
-  XFree(leader_data_ptr);
 }
 
-
 /* vim: set foldmethod=marker: */
 /* End of hd-task-navigator.c */
@@ -51,6 +51,7 @@
 #include "hd-transition.h"
 #include "hd-wm.h"
 #include "hd-orientation-lock.h"
+#include "tidy/tidy-fbo-pool.h"
 
 #undef  G_LOG_DOMAIN
 #define G_LOG_DOMAIN "hd-app-mgr"
@@ -2040,7 +2041,11 @@ hd_app_mgr_dbus_signal_handler (DBusConnection *conn,
   if (dbus_message_is_signal (msg,
                               LOWMEM_ON_SIGNAL_INTERFACE,
                               LOWMEM_ON_SIGNAL_NAME))
-    priv->lowmem = TRUE;
+    {
+      priv->lowmem = TRUE;
+      /* Don't hold on to offscreen buffers nobody is using. */
+      tidy_fbo_pool_trim ();
+    }
   else if (dbus_message_is_signal (msg,
                                    LOWMEM_OFF_SIGNAL_INTERFACE,
                                    LOWMEM_OFF_SIGNAL_NAME))
@@ -83,9 +83,9 @@ struct _HdLauncherGridPrivate
   /* Do we move the icons all together or in sequence? for launcher_in transitions */
   gboolean transition_sequenced;
   /* List of keyframes used on transitions like _IN and _IN_SUB */
-  HdKeyFrameList *transition_keyframes; // ramp for tile movement
-  HdKeyFrameList *transition_keyframes_label; // ramp for label alpha values
-  HdKeyFrameList *transition_keyframes_icon; // ramp for icon alpha values
+  HdCurve *transition_keyframes; // ramp for tile movement
+  HdCurve *transition_keyframes_label; // ramp for label alpha values
+  HdCurve *transition_keyframes_icon; // ramp for icon alpha values
 
   /* an internal status indicating how to relayout the grid (which usually is
    * the same of the real device orientation, but may not be in sync with it) */
@@ -809,15 +809,15 @@ hd_launcher_grid_transition_begin(HdLauncherGrid *grid,
       if (priv->transition_sequenced)
         {
           grid->priv->transition_keyframes =
-            hd_transition_get_keyframes(
+            hd_transition_get_curve(
                       hd_launcher_page_get_transition_string(trans_type),
                       "keyframes", "0,1");
           grid->priv->transition_keyframes_label =
-            hd_transition_get_keyframes(
+            hd_transition_get_curve(
                       hd_launcher_page_get_transition_string(trans_type),
                       "keyframes_label", "0,1");
           grid->priv->transition_keyframes_icon =
-                 hd_transition_get_keyframes(
+                 hd_transition_get_curve(
                       hd_launcher_page_get_transition_string(trans_type),
                       "keyframes_icon", "0,1");
         }
@@ -837,17 +837,17 @@ hd_launcher_grid_transition_end(HdLauncherGrid *grid)
   /* Free anything we may have allocated for the transition here */
   if (grid->priv->transition_keyframes)
     {
-      hd_key_frame_list_free(grid->priv->transition_keyframes);
+      hd_curve_unref(grid->priv->transition_keyframes);
       grid->priv->transition_keyframes = 0;
     }
   if (grid->priv->transition_keyframes_label)
     {
-      hd_key_frame_list_free(grid->priv->transition_keyframes_label);
+      hd_curve_unref(grid->priv->transition_keyframes_label);
       grid->priv->transition_keyframes_label = 0;
     }
   if (grid->priv->transition_keyframes_icon)
     {
-      hd_key_frame_list_free(grid->priv->transition_keyframes_icon);
+      hd_curve_unref(grid->priv->transition_keyframes_icon);
       grid->priv->transition_keyframes_icon = 0;
     }
 }
@@ -924,10 +924,10 @@ hd_launcher_grid_transition(HdLauncherGrid *grid,
 
                 if (priv->transition_sequenced)
                   {
-                    label_amt = hd_key_frame_interpolate(
-                          priv->transition_keyframes_label, order_amt);
-                    icon_amt = hd_key_frame_interpolate(
-                          priv->transition_keyframes_icon, order_amt);
+                    label_amt = hd_curve_get(priv->transition_keyframes_label,
+                                             order_amt);
+                    icon_amt = hd_curve_get(priv->transition_keyframes_icon,
+                                            order_amt);
 
                     if (label_amt<0) label_amt=0;
                     if (label_amt>1) label_amt=1;
@@ -935,8 +935,8 @@ hd_launcher_grid_transition(HdLauncherGrid *grid,
                     if (icon_amt>1) icon_amt = 1;
                     depth = CLUTTER_UNITS_FROM_FLOAT(
                        priv->transition_depth *
-                       (1 - hd_key_frame_interpolate(priv->transition_keyframes,
-                                                     order_amt)));
+                       (1 - hd_curve_get(priv->transition_keyframes,
+                                         order_amt)));
                   }
                 else
                   {
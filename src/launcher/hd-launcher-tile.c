@@ -36,6 +36,7 @@
 
 #include "hd-gtk-style.h"
 #include "tidy/tidy-highlight.h"
+#include "tidy/tidy-texture-accounting.h"
 #include "hd-transition.h"
 
 #define I_(str) (g_intern_static_string ((str)))
@@ -383,6 +384,7 @@ hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
           gdk_pixbuf_get_height(pixbufb),
           gdk_pixbuf_get_rowstride(pixbufb),
           gdk_pixbuf_get_n_channels(pixbufb), 0, 0);
+      tidy_texture_accounting_watch (priv->icon, "launcher-icon");
       g_object_unref(pixbufb);
     }
   if (pixbuf)
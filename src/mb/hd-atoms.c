@@ -73,6 +73,10 @@ hd_atoms_init (Display * xdpy, Atom * atoms)
     "_HILDON_TEXTURE_CLIENT_MESSAGE_SCALE",
     "_HILDON_TEXTURE_CLIENT_MESSAGE_PARENT",
     "_HILDON_TEXTURE_CLIENT_READY",
+    "_HILDON_TEXTURE_CLIENT_MESSAGE_SHM2",
+    "_HILDON_TEXTURE_CLIENT_MESSAGE_BUFFER",
+    "_HILDON_TEXTURE_CLIENT_MESSAGE_RELEASE",
+    "_HILDON_TEXTURE_CLIENT_MESSAGE_DAMAGE_BATCH",
 
     "_HILDON_LOADING_SCREENSHOT",
 
@@ -87,6 +91,10 @@ hd_atoms_init (Display * xdpy, Atom * atoms)
     "_MAEMO_ROTATION_TRANSITION",
     "_MAEMO_ROTATION_PATIENCE",
     "_MAEMO_SCREEN_SIZE",
+
+    "WM_CLIENT_LEADER",
+    /* Set on the client leader by the task navigator */
+    "_HILDON_PORTRAIT_MODE_TASKNAV_DISABLE",
   };
 
   XInternAtoms (xdpy,
@@ -68,6 +68,10 @@ typedef enum HdAtoms
   HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SCALE,
   HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_PARENT,
   HD_ATOM_HILDON_TEXTURE_CLIENT_READY,
+  HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SHM2,
+  HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_BUFFER,
+  HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_RELEASE,
+  HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_DAMAGE_BATCH,
 
   HD_ATOM_HILDON_LOADING_SCREENSHOT,
 
@@ -82,6 +86,9 @@ typedef enum HdAtoms
   HD_ATOM_MAEMO_ROTATION_PATIENCE,
   HD_ATOM_MAEMO_SCREEN_SIZE,
 
+  HD_ATOM_WM_CLIENT_LEADER,
+  HD_ATOM_HILDON_PORTRAIT_MODE_TASKNAV_DISABLE,
+
   _HD_ATOM_LAST
 } HdAtoms;
 
@@ -29,6 +29,7 @@
 #include "hd-dbus.h"
 #include "hd-atoms.h"
 #include "hd-util.h"
+#include "hd-prop-cache.h"
 #include "hd-transition.h"
 #include "hd-wm.h"
 #include "hd-home-applet.h"
@@ -54,6 +55,8 @@
 #include <clutter/x11/clutter-x11.h>
 
 #include "../tidy/tidy-blur-group.h"
+#include "../tidy/tidy-cached-group.h"
+#include "../tidy/tidy-texture-accounting.h"
 
 #include <dbus/dbus-glib-bindings.h>
 #include <mce/dbus-names.h>
@@ -109,6 +112,16 @@ struct HdCompMgrPrivate
 
   /* Track changes to the PORTRAIT properties. */
   unsigned long          property_changed_cb_id;
+  /* Atom -> HdCompMgrPropertyHandler */
+  GHashTable            *property_handlers;
+
+  /* [effects] frame_budget and how the effects' frames have kept to it,
+   * for hd_comp_mgr_dump_debug_info(). */
+  guint                  effects_budget_us;
+  gboolean               effects_budget_changed;
+  guint                  effects_ticks, effects_overruns;
+  guint                  effects_max_us;
+  guint64                effects_total_us;
 
   /* MCE D-Bus Proxy */
   DBusGProxy            *mce_proxy;
@@ -137,15 +150,27 @@ struct HdCompMgrClientPrivate
   gboolean              can_hibernate : 1;
 
   gboolean              has_video_overlay;
+
+  /* The window's WM_CLASS, %NULL if it hasn't got one. */
+  gchar                *res_name, *res_class;
 };
 
 extern gboolean hd_dbus_display_is_off;
 static guint portrait_freshness_counter;
 
+/* thp_tweaks::whitelist and ::blacklist of transitions.ini as sets of
+ * window names, and ::forcerotation, loaded when they're first needed. */
+static GHashTable *portrait_whitelist, *portrait_blacklist;
+static gint portrait_forcerotation;
+
 HdRunningApp *hd_comp_mgr_client_get_app_key (HdCompMgrClient *client,
                                                HdCompMgr *hmgr);
 
 static void hd_comp_mgr_check_do_not_disturb_flag (HdCompMgr *hmgr);
+static void hd_comp_mgr_unload_portrait_lists (gpointer unused);
+static void hd_comp_mgr_effects_frame_done (guint used_us, guint n_effects,
+                                            gpointer data);
+static void hd_comp_mgr_effects_budget_changed (gpointer hmgr);
 
 static gboolean
 hd_comp_mgr_client_prefers_compositing (MBWindowManagerClient *c);
@@ -182,54 +207,75 @@ hd_comp_mgr_client_process_hibernation_prop (HdCompMgrClient * hc)
   HdCompMgrClientPrivate * priv = hc->priv;
   MBWindowManagerClient  * wm_client = MB_WM_COMP_MGR_CLIENT (hc)->wm_client;
   HdCompMgr              * hmgr = HD_COMP_MGR (wm_client->wmref->comp_mgr);
-  Atom                   * hibernable = NULL;
+  const char             * hibernable = NULL;
 
   /* NOTE:
    *       the prop has no 'value'; if set the app is killable (hibernatable),
    *       deletes to unset.
    */
-  hibernable = hd_util_get_win_prop_data_and_validate
-                     (wm_client->wmref->xdpy,
+  hibernable = hd_prop_cache_get_string
+                     (wm_client->wmref,
 		      wm_client->window->xwindow,
-                      hmgr->priv->atoms[HD_ATOM_HILDON_APP_KILLABLE],
-                      XA_STRING,
-                      8,
-                      0,
-                      NULL);
+                      hmgr->priv->atoms[HD_ATOM_HILDON_APP_KILLABLE]);
 
   if (!hibernable)
     {
       /*try the alias*/
-      hibernable = hd_util_get_win_prop_data_and_validate
-	            (wm_client->wmref->xdpy,
+      hibernable = hd_prop_cache_get_string
+	            (wm_client->wmref,
 		     wm_client->window->xwindow,
-                     hmgr->priv->atoms[HD_ATOM_HILDON_ABLE_TO_HIBERNATE],
-                     XA_STRING,
-                     8,
-                     0,
-                     NULL);
+                     hmgr->priv->atoms[HD_ATOM_HILDON_ABLE_TO_HIBERNATE]);
     }
 
   if (hibernable)
       priv->can_hibernate = TRUE;
   else
     priv->can_hibernate = FALSE;
+}
 
-  if (hibernable)
-    XFree (hibernable);
+/* Copies the WM_CLASS of @hc's window, so that we needn't ask the
+ * X server every time we want to know whether it may rotate. */
+static void
+hd_comp_mgr_client_read_class_hint (HdCompMgrClient *hc)
+{
+  HdCompMgrClientPrivate *priv = hc->priv;
+  MBWindowManagerClient  *wm_client = MB_WM_COMP_MGR_CLIENT (hc)->wm_client;
+  const char             *res_name, *res_class;
+
+  g_free (priv->res_name);
+  g_free (priv->res_class);
+  hd_prop_cache_get_class_hint (wm_client->wmref, wm_client->window->xwindow,
+                                &res_name, &res_class);
+  priv->res_name = g_strdup (res_name);
+  priv->res_class = g_strdup (res_class);
+}
+
+/* Returns the WM_CLASS of @c like XGetClassHint(), except that the strings
+ * mustn't be freed, and without a round trip. */
+static gboolean
+hd_comp_mgr_get_class_hint (MBWindowManagerClient *c,
+                            const gchar **res_name, const gchar **res_class)
+{
+  if (c->cm_client)
+    {
+      HdCompMgrClientPrivate *priv = HD_COMP_MGR_CLIENT (c->cm_client)->priv;
+
+      *res_name = priv->res_name;
+      *res_class = priv->res_class;
+      return priv->res_name != NULL;
+    }
+  else
+    return hd_prop_cache_get_class_hint (c->wmref, c->window->xwindow,
+                                         res_name, res_class);
 }
 
 HdRunningApp *
 hd_comp_mgr_client_get_app_key (HdCompMgrClient *client, HdCompMgr *hmgr)
 {
   MBWindowManagerClient *wm_client;
-  MBWindowManager       *wm;
-  XClassHint             class_hint;
-  Status                 status = 0;
   HdRunningApp          *app = NULL;
   HdCompMgrClientPrivate *priv = client->priv;
 
-  wm = MB_WM_COMP_MGR (hmgr)->wm;
   wm_client = MB_WM_COMP_MGR_CLIENT (client)->wm_client;
 
   /* We only lookup the app for main windows and dialogs. */
@@ -237,20 +283,11 @@ hd_comp_mgr_client_get_app_key (HdCompMgrClient *client, HdCompMgr *hmgr)
       MB_WM_CLIENT_CLIENT_TYPE (wm_client) != MBWMClientTypeDialog)
     return NULL;
 
-  memset(&class_hint, 0, sizeof(XClassHint));
-
-  /* We don't care about X errors here, because they will be reported
-   * in the return value of XGetWindowAttributes */
-  mb_wm_util_async_trap_x_errors (wm->xdpy);
-
-  status = XGetClassHint(wm->xdpy, wm_client->window->xwindow, &class_hint);
-
-  mb_wm_util_async_untrap_x_errors();
-  if (!status)
-    goto out;
+  if (!priv->res_name)
+    return NULL;
 
-  app = hd_app_mgr_match_window (class_hint.res_name,
-                                 class_hint.res_class,
+  app = hd_app_mgr_match_window (priv->res_name,
+                                 priv->res_class,
                                  wm_client->window->pid);
 
   if (app)
@@ -260,17 +297,13 @@ hd_comp_mgr_client_get_app_key (HdCompMgrClient *client, HdCompMgr *hmgr)
        * - The role, if present.
        * - The window name.
        */
-      gchar *role = NULL;
+      const gchar *role = NULL;
       gchar *key = NULL;
       gint level = 0;
-      role = hd_util_get_win_prop_data_and_validate
-                         (wm_client->wmref->xdpy,
+      role = hd_prop_cache_get_string
+                         (wm_client->wmref,
                           wm_client->window->xwindow,
-                          hmgr->priv->atoms[HD_ATOM_WM_WINDOW_ROLE],
-                          XA_STRING,
-                          8,
-                          0,
-                          NULL);
+                          hmgr->priv->atoms[HD_ATOM_WM_WINDOW_ROLE]);
 
       if (MB_WM_CLIENT_CLIENT_TYPE (wm_client) == MBWMClientTypeApp)
         {
@@ -280,25 +313,16 @@ hd_comp_mgr_client_get_app_key (HdCompMgrClient *client, HdCompMgr *hmgr)
 
       key = g_strdup_printf ("%s/%s/%s/%d",
               hd_running_app_get_id (app),
-              class_hint.res_class ? class_hint.res_class : "",
+              priv->res_class ? priv->res_class : "",
               role ? role : "",
               level);
       g_debug ("%s: app %s, window key: %s\n", __FUNCTION__,
                 hd_running_app_get_id (app),
                 key);
       priv->hibernation_key = g_str_hash (key);
-      if (role)
-        XFree (role);
       g_free (key);
     }
 
- out:
-  if (class_hint.res_class)
-    XFree(class_hint.res_class);
-
-  if (class_hint.res_name)
-    XFree(class_hint.res_name);
-
   return app;
 }
 
@@ -314,6 +338,7 @@ hd_comp_mgr_client_init (MBWMObject *obj, va_list vap)
   hmgr = HD_COMP_MGR (wm_client->wmref->comp_mgr);
 
   priv = client->priv = g_new0 (HdCompMgrClientPrivate, 1);
+  hd_comp_mgr_client_read_class_hint (client);
 
   app = hd_comp_mgr_client_get_app_key (client, hmgr);
   if (app)
@@ -343,12 +368,17 @@ static void
 hd_comp_mgr_client_destroy (MBWMObject* obj)
 {
   HdCompMgrClientPrivate *priv = HD_COMP_MGR_CLIENT (obj)->priv;
+  MBWindowManagerClient  *wm_client = MB_WM_COMP_MGR_CLIENT (obj)->wm_client;
+
+  hd_prop_cache_forget (wm_client->wmref, wm_client->window->xwindow);
 
   if (priv->app)
     {
       g_object_unref (priv->app);
       priv->app = NULL;
     }
+  g_free (priv->res_name);
+  g_free (priv->res_class);
 
   g_free (priv);
 }
@@ -447,6 +477,7 @@ static void hd_comp_mgr_effect (MBWMCompMgr *mgr, MBWindowManagerClient *c,
                                 MBWMCompMgrClientEvent event);
 static Bool hd_comp_mgr_client_property_changed (XPropertyEvent *event,
                                                  HdCompMgr *hmgr);
+static void hd_comp_mgr_init_property_handlers (HdCompMgr *hmgr);
 
 int
 hd_comp_mgr_class_type ()
@@ -604,10 +635,23 @@ hd_comp_mgr_init (MBWMObject *obj, va_list vap)
                (GDestroyNotify)mb_wm_object_unref);
 
   /* Be notified about all X window property changes around here. */
+  hd_comp_mgr_init_property_handlers (hmgr);
   priv->property_changed_cb_id = mb_wm_main_context_x_event_handler_add (
                    cmgr->wm->main_ctx, None, PropertyNotify,
                    (MBWMXEventFunc)hd_comp_mgr_client_property_changed, cmgr);
 
+  /* Forget the portrait lists when they may have changed. */
+  hd_transition_ini_changed_connect (hd_comp_mgr_unload_portrait_lists, NULL);
+
+  /* Measure the effects' frames and cap them if told so. */
+  priv->effects_budget_us = MAX (hd_transition_get_int ("effects",
+                                                        "frame_budget", 0),
+                                 0);
+  hd_transition_set_frame_budget (priv->effects_budget_us,
+                                  hd_comp_mgr_effects_frame_done, hmgr);
+  hd_transition_ini_changed_connect (hd_comp_mgr_effects_budget_changed,
+                                     hmgr);
+
   if (hd_orientation_lock_is_locked_to_portrait ())
     hd_render_manager_set_state(HDRM_STATE_HOME_PORTRAIT);
   else
@@ -654,6 +698,12 @@ hd_comp_mgr_destroy (MBWMObject *obj)
                                      MB_WM_COMP_MGR (obj)->wm->main_ctx,
                                      PropertyNotify,
                                      priv->property_changed_cb_id);
+  g_hash_table_destroy (priv->property_handlers);
+  hd_transition_ini_changed_disconnect (hd_comp_mgr_unload_portrait_lists,
+                                        NULL);
+  hd_transition_ini_changed_disconnect (hd_comp_mgr_effects_budget_changed,
+                                        obj);
+  hd_transition_set_frame_budget (0, NULL, NULL);
 
   if (priv->mce_proxy)
     {
@@ -665,6 +715,38 @@ hd_comp_mgr_destroy (MBWMObject *obj)
     g_source_remove (priv->stack_sync);
 }
 
+/* Called by the effect scheduler after every frame of the effects. */
+static void
+hd_comp_mgr_effects_frame_done (guint used_us, guint n_effects,
+                                gpointer data)
+{
+  HdCompMgrPrivate *priv = HD_COMP_MGR (data)->priv;
+
+  priv->effects_ticks++;
+  priv->effects_total_us += used_us;
+  priv->effects_max_us = MAX (priv->effects_max_us, used_us);
+  if (priv->effects_budget_us && used_us > priv->effects_budget_us)
+    priv->effects_overruns++;
+
+  if (priv->effects_budget_changed)
+    {
+      priv->effects_budget_changed = FALSE;
+      priv->effects_budget_us = MAX (hd_transition_get_int ("effects",
+                                                            "frame_budget",
+                                                            0), 0);
+      hd_transition_set_frame_budget (priv->effects_budget_us,
+                                      hd_comp_mgr_effects_frame_done, data);
+    }
+}
+
+/* transitions.ini may be reloaded by any hd_transition_get_*(), so only
+ * take note and read the budget after the next frame. */
+static void
+hd_comp_mgr_effects_budget_changed (gpointer hmgr)
+{
+  HD_COMP_MGR (hmgr)->priv->effects_budget_changed = TRUE;
+}
+
 HdCompMgrClient *
 hd_comp_mgr_get_current_client (HdCompMgr *hmgr)
 {
@@ -685,215 +767,230 @@ hd_comp_mgr_client_prefers_compositing (MBWindowManagerClient *c)
   return !(HD_IS_APP (c) && hd_comp_mgr_is_non_composited (c, FALSE));
 }
 
-/* Called on #PropertyNotify to handle changes to
- * _HILDON_PORTRAIT_MODE_SUPPORT and _HILDON_PORTRAIT_MODE_REQUEST
- * and _HILDON_APP_KILLABLE and _HILDON_ABLE_TO_HIBERNATE
- * and _HILDON_DO_NOT_DISTURB and _HILDON_NOTIFICATION_THREAD. */
-Bool
-hd_comp_mgr_client_property_changed (XPropertyEvent *event, HdCompMgr *hmgr)
+/* A #PropertyNotify handler of hd_comp_mgr_client_property_changed().
+ * @c is the managed client of @event's window if the handler was added
+ * with @needs_client, otherwise %NULL.  Returns %False if other handlers
+ * needn't see @event. */
+typedef Bool (*HdCompMgrPropertyFunc) (HdCompMgr *hmgr,
+                                       MBWindowManagerClient *c,
+                                       XPropertyEvent *event);
+
+typedef struct
 {
-  Atom killable, able_to_hibernate, dnd, nothread;
-  gboolean non_comp_changed;
-  gint value;
-  MBWindowManager *wm;
-  HdCompMgrClient *cc;
-  MBWindowManagerClient *c;
+  HdCompMgrPropertyFunc  func;
+  gboolean               needs_client;
 
-  if (event->type != PropertyNotify)
-    return True;
+  /* How many times the property has changed, for the debug dump. */
+  guint                  hits;
+} HdCompMgrPropertyHandler;
 
-  killable = hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_APP_KILLABLE);
-  able_to_hibernate = hd_comp_mgr_get_atom (hmgr,
-                          HD_ATOM_HILDON_ABLE_TO_HIBERNATE);
-  dnd = hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_DO_NOT_DISTURB);
+static Bool
+hd_comp_mgr_class_hint_changed (HdCompMgr *hmgr, MBWindowManagerClient *c,
+                                XPropertyEvent *event)
+{
+  if (c && c->cm_client)
+    hd_comp_mgr_client_read_class_hint (HD_COMP_MGR_CLIENT (c->cm_client));
+  return False;
+}
 
-  wm = MB_WM_COMP_MGR (hmgr)->wm;
+static Bool
+hd_comp_mgr_live_background_changed (HdCompMgr *hmgr,
+                                     MBWindowManagerClient *c,
+                                     XPropertyEvent *event)
+{
+  HdCompMgrPrivate *priv = hmgr->priv;
+  ClutterActor *actor;
+  MBWMCompMgrClutterClient *cclient;
 
-  if (event->atom == wm->atoms[MBWM_ATOM_HILDON_LIVE_DESKTOP_BACKGROUND])
-    {
-      HdCompMgrPrivate *priv = hmgr->priv;
-      c = mb_wm_managed_client_from_xwindow (wm, event->window);
-      if (c)
-        {
-          /* TODO: handle zero value */
-          ClutterActor *actor;
-          MBWMCompMgrClutterClient *cclient =
-                MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client);
-          actor = mb_wm_comp_mgr_clutter_client_get_actor (cclient);
-          /*g_printerr ("%s: client '%s' now has live-bg value %d\n", __func__,
-                      mb_wm_client_get_name (c),
-                      c->window->live_background);*/
-          mb_wm_comp_mgr_clutter_client_set_flags (cclient,
-                                   MBWMCompMgrClutterClientDontPosition);
-          /* remove it from the switcher */
-          if (hd_task_navigator_has_window (hd_task_navigator, actor))
-            hd_switcher_remove_window_actor (priv->switcher_group,
-                                             actor, cclient);
-          hd_home_set_live_background (HD_HOME (priv->home), c);
-          if(STATE_IS_PORTRAIT (hd_render_manager_get_state ()))
-            hd_render_manager_set_state (HDRM_STATE_HOME_PORTRAIT);
-          else
-            hd_render_manager_set_state (HDRM_STATE_HOME);
-          hd_launcher_hide ();
-        }
-      return False;
-    }
-
-  if (event->atom==
-    hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_WM_WINDOW_PROGRESS_INDICATOR) ||
-      event->atom==
-    hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_WM_WINDOW_MENU_INDICATOR))
-    {
-      /* Redraw the title to display/remove the progress indicator or app
-       * menu indicator. The title itself will check what the new state should
-       * be. NOTE: we have to redo dialog titles here too, so we can't just
-       * use hd_title_bar_update. */
-      MBWindowManagerClient *top;
-      /* previous mb_wm_client_decor_mark_dirty didn't actually cause a redraw,
-       * so mark the decor itself dirty */
-      top = mb_wm_managed_client_from_xwindow(MB_WM_COMP_MGR (hmgr)->wm,
-                                              event->window);
-      if (top)
-        {
-          MBWMList *l = top->decor;
-          while (l)
-            {
-              MBWMDecor *decor = l->data;
-              if (decor->type == MBWMDecorTypeNorth)
-                mb_wm_decor_mark_dirty (decor);
-              l = l->next;
-            }
-        }
-    }
+  if (!c)
+    return False;
+
+  /* TODO: handle zero value */
+  cclient = MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client);
+  actor = mb_wm_comp_mgr_clutter_client_get_actor (cclient);
+  /*g_printerr ("%s: client '%s' now has live-bg value %d\n", __func__,
+              mb_wm_client_get_name (c),
+              c->window->live_background);*/
+  mb_wm_comp_mgr_clutter_client_set_flags (cclient,
+                           MBWMCompMgrClutterClientDontPosition);
+  /* remove it from the switcher */
+  if (hd_task_navigator_has_window (hd_task_navigator, actor))
+    hd_switcher_remove_window_actor (priv->switcher_group,
+                                     actor, cclient);
+  hd_home_set_live_background (HD_HOME (priv->home), c);
+  if(STATE_IS_PORTRAIT (hd_render_manager_get_state ()))
+    hd_render_manager_set_state (HDRM_STATE_HOME_PORTRAIT);
+  else
+    hd_render_manager_set_state (HDRM_STATE_HOME);
+  hd_launcher_hide ();
+
+  return False;
+}
+
+static Bool
+hd_comp_mgr_indicator_changed (HdCompMgr *hmgr, MBWindowManagerClient *c,
+                               XPropertyEvent *event)
+{
+  MBWMList *l;
+
+  /* Redraw the title to display/remove the progress indicator or app
+   * menu indicator. The title itself will check what the new state should
+   * be. NOTE: we have to redo dialog titles here too, so we can't just
+   * use hd_title_bar_update. */
+  /* previous mb_wm_client_decor_mark_dirty didn't actually cause a redraw,
+   * so mark the decor itself dirty */
+  if (c)
+    for (l = c->decor; l; l = l->next)
+      {
+        MBWMDecor *decor = l->data;
+        if (decor->type == MBWMDecorTypeNorth)
+          mb_wm_decor_mark_dirty (decor);
+      }
+
+  return True;
+}
+
+static Bool
+hd_comp_mgr_non_composited_changed (HdCompMgr *hmgr,
+                                    MBWindowManagerClient *c,
+                                    XPropertyEvent *event)
+{
+  gboolean client_non_comp, non_comp_changed;
+  MBWindowManagerClient *tmp;
+  gboolean found = FALSE;
+
+  if (!c || !HD_IS_APP (c))
+    return True;
 
   non_comp_changed = event->atom ==
         hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_NON_COMPOSITED_WINDOW);
-  if (event->atom == wm->atoms[MBWM_ATOM_NET_WM_STATE] || non_comp_changed)
-    {
-      c = mb_wm_managed_client_from_xwindow (wm, event->window);
-      if (c && HD_IS_APP (c))
-        {
-          gboolean client_non_comp;
-          MBWindowManagerClient *tmp;
-          gboolean found = FALSE;
-          /* check if there is a window above that needs compositing */
-          for (tmp = c->stacked_above; tmp; tmp = tmp->stacked_above)
-            if (mb_wm_client_is_map_confirmed (tmp) &&
-                hd_comp_mgr_client_prefers_compositing (tmp))
-              {
-                found = TRUE;
-                break;
-              }
-          client_non_comp = hd_comp_mgr_is_non_composited (c, non_comp_changed);
-          if (hd_render_manager_get_state () == HDRM_STATE_NON_COMPOSITED &&
-	      !client_non_comp)
-            hd_render_manager_set_state (HDRM_STATE_APP);
-          else if (hd_render_manager_get_state () == HDRM_STATE_NON_COMP_PORT
-                   && !client_non_comp)
-            hd_render_manager_set_state (HDRM_STATE_APP_PORTRAIT);
-          else if (hd_render_manager_get_state () == HDRM_STATE_APP &&
-                   !hd_transition_is_rotating () &&
-	           client_non_comp && !found)
-            hd_render_manager_set_state (HDRM_STATE_NON_COMPOSITED);
-          else if (hd_render_manager_get_state () == HDRM_STATE_APP_PORTRAIT &&
-                   !hd_transition_is_rotating () &&
-	           client_non_comp && !found)
-            hd_render_manager_set_state (HDRM_STATE_NON_COMP_PORT);
-        }
-    }
-  /* Check for changes to the hibernable state. */
-  if (event->atom == killable ||
-      event->atom == able_to_hibernate)
-    {
-      HdRunningApp *app, *current_app;
-      c = mb_wm_managed_client_from_xwindow (wm, event->window);
-      if (!c || !c->cm_client)
-        return False;
-      cc = HD_COMP_MGR_CLIENT (c->cm_client);
-      if (event->state == PropertyNewValue)
-        cc->priv->can_hibernate = TRUE;
-      else
-        cc->priv->can_hibernate = FALSE;
 
-      /* Change the hibernable state of the app only if it's not the
-       * current app.
-       */
-      app = cc->priv->app;
-      if (!app)
-        return False;
-      current_app =
-        hd_comp_mgr_client_get_app (hd_comp_mgr_get_current_client (hmgr));
-      if (!current_app || app == current_app)
-        return False;
-
-      if (event->state == PropertyNewValue)
-        hd_app_mgr_hibernatable(app, TRUE);
-      else
-        hd_app_mgr_hibernatable (app, FALSE);
+  /* check if there is a window above that needs compositing */
+  for (tmp = c->stacked_above; tmp; tmp = tmp->stacked_above)
+    if (mb_wm_client_is_map_confirmed (tmp) &&
+        hd_comp_mgr_client_prefers_compositing (tmp))
+      {
+        found = TRUE;
+        break;
+      }
+  client_non_comp = hd_comp_mgr_is_non_composited (c, non_comp_changed);
+  if (hd_render_manager_get_state () == HDRM_STATE_NON_COMPOSITED &&
+      !client_non_comp)
+    hd_render_manager_set_state (HDRM_STATE_APP);
+  else if (hd_render_manager_get_state () == HDRM_STATE_NON_COMP_PORT
+           && !client_non_comp)
+    hd_render_manager_set_state (HDRM_STATE_APP_PORTRAIT);
+  else if (hd_render_manager_get_state () == HDRM_STATE_APP &&
+           !hd_transition_is_rotating () &&
+           client_non_comp && !found)
+    hd_render_manager_set_state (HDRM_STATE_NON_COMPOSITED);
+  else if (hd_render_manager_get_state () == HDRM_STATE_APP_PORTRAIT &&
+           !hd_transition_is_rotating () &&
+           client_non_comp && !found)
+    hd_render_manager_set_state (HDRM_STATE_NON_COMP_PORT);
+
+  return True;
+}
 
-      return False;
-    }
+/* Check for changes to the hibernable state. */
+static Bool
+hd_comp_mgr_hibernable_changed (HdCompMgr *hmgr, MBWindowManagerClient *c,
+                                XPropertyEvent *event)
+{
+  HdRunningApp *app, *current_app;
+  HdCompMgrClient *cc;
 
-  if (event->atom == dnd)
-    {
-      hd_comp_mgr_check_do_not_disturb_flag (hmgr);
-      return FALSE;
-    }
+  if (!c || !c->cm_client)
+    return False;
+  cc = HD_COMP_MGR_CLIENT (c->cm_client);
+  if (event->state == PropertyNewValue)
+    cc->priv->can_hibernate = TRUE;
+  else
+    cc->priv->can_hibernate = FALSE;
 
-  nothread = hd_comp_mgr_get_atom (hmgr, HD_ATOM_NOTIFICATION_THREAD);
-  if (event->atom == nothread)
-    {
-      char *str;
-      ClutterActor *a;
+  /* Change the hibernable state of the app only if it's not the
+   * current app.
+   */
+  app = cc->priv->app;
+  if (!app)
+    return False;
+  current_app =
+    hd_comp_mgr_client_get_app (hd_comp_mgr_get_current_client (hmgr));
+  if (!current_app || app == current_app)
+    return False;
+
+  if (event->state == PropertyNewValue)
+    hd_app_mgr_hibernatable(app, TRUE);
+  else
+    hd_app_mgr_hibernatable (app, FALSE);
 
-      c = mb_wm_managed_client_from_xwindow (wm, event->window);
-      if (!c || !c->cm_client)
-        return False;
-      a = mb_wm_comp_mgr_clutter_client_get_actor (
-                          MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client));
-      str = event->state == PropertyNewValue
-        ? hd_util_get_x_window_string_property (wm, c->window->xwindow,
-                                                HD_ATOM_NOTIFICATION_THREAD)
-        : NULL;
-      if (event->state != PropertyNewValue || str)
-        /* Otherwise don't mess up more. */
-        hd_task_navigator_notification_thread_changed (hd_task_navigator,
-                                                       a, str);
-      return False;
-    }
+  return False;
+}
 
-  /* Process XVIDEO flag. If this changed then we'll want to look again at
-   * how we should blur. */
-  if (event->atom == hd_comp_mgr_get_atom (hmgr, HD_ATOM_OMAP_VIDEO_OVERLAY))
-    {
-      c = mb_wm_managed_client_from_xwindow (wm, event->window);
+static Bool
+hd_comp_mgr_do_not_disturb_changed (HdCompMgr *hmgr,
+                                    MBWindowManagerClient *c,
+                                    XPropertyEvent *event)
+{
+  hd_comp_mgr_check_do_not_disturb_flag (hmgr);
+  return False;
+}
 
-      if (c && (cc = HD_COMP_MGR_CLIENT(c->cm_client)))
-        {
-          cc->priv->has_video_overlay = hd_util_client_has_video_overlay(c);
-          hd_render_manager_update_blur_state();
-        }
-    }
+static Bool
+hd_comp_mgr_notification_thread_changed (HdCompMgr *hmgr,
+                                         MBWindowManagerClient *c,
+                                         XPropertyEvent *event)
+{
+  char *str;
+  ClutterActor *a;
+
+  if (!c || !c->cm_client)
+    return False;
+  a = mb_wm_comp_mgr_clutter_client_get_actor (
+                      MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client));
+  str = event->state == PropertyNewValue
+    ? hd_util_get_x_window_string_property (c->wmref, c->window->xwindow,
+                                            HD_ATOM_NOTIFICATION_THREAD)
+    : NULL;
+  if (event->state != PropertyNewValue || str)
+    /* Otherwise don't mess up more. */
+    hd_task_navigator_notification_thread_changed (hd_task_navigator,
+                                                   a, str);
+  return False;
+}
 
-  /* Process PORTRAIT flags */
-  if (event->atom == wm->atoms[MBWM_ATOM_HILDON_PORTRAIT_MODE_SUPPORT])
-    {
-      if (!(c = mb_wm_managed_client_from_xwindow (wm, event->window)))
-        return False;
+/* Process XVIDEO flag. If this changed then we'll want to look again at
+ * how we should blur. */
+static Bool
+hd_comp_mgr_video_overlay_changed (HdCompMgr *hmgr, MBWindowManagerClient *c,
+                                   XPropertyEvent *event)
+{
+  HdCompMgrClient *cc;
 
-      value = c->window->portrait_supported;
-      hd_task_navigator_update_win_orientation(event->window, value);
-    }
-  else if (event->atom == wm->atoms[MBWM_ATOM_HILDON_PORTRAIT_MODE_REQUEST])
+  if (c && (cc = HD_COMP_MGR_CLIENT(c->cm_client)))
     {
-      if (!(c = mb_wm_managed_client_from_xwindow (wm, event->window)))
-        return False;
-
-      value = c->window->portrait_requested;
-      hd_task_navigator_update_win_orientation(event->window, value);
+      cc->priv->has_video_overlay = hd_util_client_has_video_overlay(c);
+      hd_render_manager_update_blur_state();
     }
+
+  return True;
+}
+
+/* Process PORTRAIT flags */
+static Bool
+hd_comp_mgr_portrait_changed (HdCompMgr *hmgr, MBWindowManagerClient *c,
+                              XPropertyEvent *event)
+{
+  gint value;
+
+  if (!c)
+    return False;
+
+  if (event->atom == c->wmref->atoms[MBWM_ATOM_HILDON_PORTRAIT_MODE_SUPPORT])
+    value = c->window->portrait_supported;
   else
-    return True;
+    value = c->window->portrait_requested;
+  hd_task_navigator_update_win_orientation(event->window, value);
 
   /* Switch HDRM state if we need to.  Don't consider changing the state if
    * it is approved by the new value of the property.  We must reconsider
@@ -917,6 +1014,95 @@ hd_comp_mgr_client_property_changed (XPropertyEvent *event, HdCompMgr *hmgr)
   return False;
 }
 
+static void
+hd_comp_mgr_add_property_handler (HdCompMgr *hmgr, Atom atom,
+                                  HdCompMgrPropertyFunc func,
+                                  gboolean needs_client)
+{
+  HdCompMgrPropertyHandler *handler;
+
+  handler = g_new0 (HdCompMgrPropertyHandler, 1);
+  handler->func = func;
+  handler->needs_client = needs_client;
+  g_hash_table_insert (hmgr->priv->property_handlers,
+                       GUINT_TO_POINTER (atom), handler);
+}
+
+/* Fills the table hd_comp_mgr_client_property_changed() dispatches by. */
+static void
+hd_comp_mgr_init_property_handlers (HdCompMgr *hmgr)
+{
+  MBWindowManager *wm = MB_WM_COMP_MGR (hmgr)->wm;
+
+  hmgr->priv->property_handlers = g_hash_table_new_full (g_direct_hash,
+                                                         g_direct_equal,
+                                                         NULL, g_free);
+
+  hd_comp_mgr_add_property_handler (hmgr, XA_WM_CLASS,
+                            hd_comp_mgr_class_hint_changed, TRUE);
+  hd_comp_mgr_add_property_handler (hmgr,
+                            wm->atoms[MBWM_ATOM_HILDON_LIVE_DESKTOP_BACKGROUND],
+                            hd_comp_mgr_live_background_changed, TRUE);
+  hd_comp_mgr_add_property_handler (hmgr,
+         hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_WM_WINDOW_PROGRESS_INDICATOR),
+                            hd_comp_mgr_indicator_changed, TRUE);
+  hd_comp_mgr_add_property_handler (hmgr,
+         hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_WM_WINDOW_MENU_INDICATOR),
+                            hd_comp_mgr_indicator_changed, TRUE);
+  hd_comp_mgr_add_property_handler (hmgr, wm->atoms[MBWM_ATOM_NET_WM_STATE],
+                            hd_comp_mgr_non_composited_changed, TRUE);
+  hd_comp_mgr_add_property_handler (hmgr,
+         hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_NON_COMPOSITED_WINDOW),
+                            hd_comp_mgr_non_composited_changed, TRUE);
+  hd_comp_mgr_add_property_handler (hmgr,
+         hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_APP_KILLABLE),
+                            hd_comp_mgr_hibernable_changed, TRUE);
+  hd_comp_mgr_add_property_handler (hmgr,
+         hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_ABLE_TO_HIBERNATE),
+                            hd_comp_mgr_hibernable_changed, TRUE);
+  hd_comp_mgr_add_property_handler (hmgr,
+         hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_DO_NOT_DISTURB),
+                            hd_comp_mgr_do_not_disturb_changed, FALSE);
+  hd_comp_mgr_add_property_handler (hmgr,
+         hd_comp_mgr_get_atom (hmgr, HD_ATOM_NOTIFICATION_THREAD),
+                            hd_comp_mgr_notification_thread_changed, TRUE);
+  hd_comp_mgr_add_property_handler (hmgr,
+         hd_comp_mgr_get_atom (hmgr, HD_ATOM_OMAP_VIDEO_OVERLAY),
+                            hd_comp_mgr_video_overlay_changed, TRUE);
+  hd_comp_mgr_add_property_handler (hmgr,
+                            wm->atoms[MBWM_ATOM_HILDON_PORTRAIT_MODE_SUPPORT],
+                            hd_comp_mgr_portrait_changed, TRUE);
+  hd_comp_mgr_add_property_handler (hmgr,
+                            wm->atoms[MBWM_ATOM_HILDON_PORTRAIT_MODE_REQUEST],
+                            hd_comp_mgr_portrait_changed, TRUE);
+}
+
+/* Called on #PropertyNotify to keep the property cache fresh and to
+ * dispatch the properties we're interested in to their handlers. */
+Bool
+hd_comp_mgr_client_property_changed (XPropertyEvent *event, HdCompMgr *hmgr)
+{
+  HdCompMgrPropertyHandler *handler;
+  MBWindowManagerClient *c;
+
+  if (event->type != PropertyNotify)
+    return True;
+
+  hd_prop_cache_invalidate (event->window, event->atom);
+
+  handler = g_hash_table_lookup (hmgr->priv->property_handlers,
+                                 GUINT_TO_POINTER (event->atom));
+  if (!handler)
+    return True;
+
+  handler->hits++;
+  c = handler->needs_client
+    ? mb_wm_managed_client_from_xwindow (MB_WM_COMP_MGR (hmgr)->wm,
+                                         event->window)
+    : NULL;
+  return handler->func (hmgr, c, event);
+}
+
 static void
 hd_comp_mgr_turn_on (MBWMCompMgr *mgr)
 {
@@ -1436,16 +1622,44 @@ hd_comp_mgr_get_client_transient_for (MBWindowManagerClient *c)
     : NULL;
 }
 
+/* Let the cached group @actor is in know what to render again the next
+ * time it's told to update.  This is done whether or not the damage can
+ * be seen now, since it may be by then. */
+static void
+hd_comp_mgr_damage_cached_group(ClutterActor *actor,
+                                int x, int y, int width, int height)
+{
+  ClutterActor *parent;
+  ClutterGeometry area = {x, y, width, height};
+
+  for (parent = clutter_actor_get_parent(actor); parent;
+       parent = clutter_actor_get_parent(parent))
+    if (TIDY_IS_CACHED_GROUP(parent))
+      break;
+  if (!parent)
+    return;
+
+  if (hd_util_get_actor_bounds(actor, &area, NULL))
+    tidy_cached_group_changed_area(parent, &area);
+  else
+    tidy_cached_group_changed_area(parent, NULL);
+}
+
 static void
 hd_comp_mgr_texture_update_area(HdCompMgr *hmgr,
                                 int x, int y, int width, int height,
                                 ClutterActor* actor)
 {
   ClutterActor *parent;
-  gboolean blur_update = FALSE;
+  gboolean blur_update = FALSE, blur_hint;
   ClutterActor *actors_stage;
 
-  if (!actor || !CLUTTER_ACTOR_IS_VISIBLE(actor) || hmgr == 0)
+  if (!actor || hmgr == 0)
+    return;
+
+  hd_comp_mgr_damage_cached_group(actor, x, y, width, height);
+
+  if (!CLUTTER_ACTOR_IS_VISIBLE(actor))
     return;
 
   if (hd_dbus_display_is_off)
@@ -1474,6 +1688,11 @@ hd_comp_mgr_texture_update_area(HdCompMgr *hmgr,
     /* if it's not on stage, it's not visible */
     return;
 
+  /* Damage that can't be seen doesn't change what blur groups have
+   * blurred either, so don't make them throw it away. */
+  blur_hint = width > 0 && height > 0
+    && clutter_actor_get_paint_opacity(actor) > 0;
+
   while (parent && parent != actors_stage)
     {
       if (!CLUTTER_ACTOR_IS_VISIBLE(parent))
@@ -1485,7 +1704,8 @@ hd_comp_mgr_texture_update_area(HdCompMgr *hmgr,
            * an application now as it causes a flicker, so
            * instead we just hint that next time we become
            * unblurred, we need to recalculate. */
-          tidy_blur_group_hint_source_changed(parent);
+          if (blur_hint)
+            tidy_blur_group_hint_source_changed(parent);
           /* ONLY set blur_update if the image is buffered ->
            * we are actually blurred */
           if (tidy_blur_group_source_buffered(parent))
@@ -1667,12 +1887,8 @@ hd_comp_mgr_is_non_composited (MBWindowManagerClient *client,
   MBWindowManager *wm;
   HdCompMgr *hmgr;
   MBWMClientWindow *win;
-  Atom atom, actual_type;
-  int format;
-  unsigned long items, left;
-  unsigned char *prop;
-  Status ret;
-  int value = 1;
+  Atom atom;
+  const long *prop;
 
   if (!HD_IS_APP (client))
     return FALSE;
@@ -1682,16 +1898,13 @@ hd_comp_mgr_is_non_composited (MBWindowManagerClient *client,
   if (!HD_APP (client)->non_composited_read)
     {
       /* check if the window is blacklisted */
-      XClassHint class_hint;
-      memset (&class_hint, 0, sizeof (XClassHint));
-      mb_wm_util_async_trap_x_errors (wm->xdpy);
-      ret = XGetClassHint (wm->xdpy, client->window->xwindow, &class_hint);
-      mb_wm_util_async_untrap_x_errors ();
+      const gchar *res_name, *res_class;
 
-      if (ret && class_hint.res_class)
+      if (hd_comp_mgr_get_class_hint (client, &res_name, &res_class)
+          && res_class)
         {
-          if (!strcmp (class_hint.res_class, "Chessui") ||
-              !strcmp (class_hint.res_class, "Mahjong"))
+          if (!strcmp (res_class, "Chessui") ||
+              !strcmp (res_class, "Mahjong"))
             {
               /* g_printerr ("%s: mahjong or chess\n", __func__); */
               HD_APP (client)->non_composited_read = True;
@@ -1699,12 +1912,6 @@ hd_comp_mgr_is_non_composited (MBWindowManagerClient *client,
               HD_APP (client)->force_composited = True;
             }
         }
-
-      if (class_hint.res_class)
-        XFree (class_hint.res_class);
-
-      if (class_hint.res_name)
-        XFree (class_hint.res_name);
     }
 
   if (HD_APP (client)->force_composited)
@@ -1721,30 +1928,15 @@ hd_comp_mgr_is_non_composited (MBWindowManagerClient *client,
 
   hmgr = HD_COMP_MGR (wm->comp_mgr);
   win = client->window;
-  prop = NULL;
 
   atom = hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_NON_COMPOSITED_WINDOW);
-
-  mb_wm_util_async_trap_x_errors (wm->xdpy);
-  ret = XGetWindowProperty (wm->xdpy, win->xwindow,
-                            atom, 0, 1, False,
-                            XA_INTEGER, &actual_type, &format,
-                            &items, &left, &prop);
-  mb_wm_util_async_untrap_x_errors ();
-  if (ret != Success)
-    return FALSE;
+  prop = hd_prop_cache_get (wm, win->xwindow, atom, XA_INTEGER, 32, 0, NULL);
 
   HD_APP (client)->non_composited_read = True;
 
   if (prop)
     {
-      value = (int)*prop;
-      XFree (prop);
-    }
-
-  if (actual_type == XA_INTEGER)
-    {
-      if (value)
+      if (*prop)
         {
           HD_APP (client)->non_composited = True;
           if (client->window->ewmh_state & MBWMClientWindowEWMHStateFullscreen)
@@ -1785,11 +1977,8 @@ hd_comp_mgr_handle_stackable (MBWindowManagerClient *client,
   HdCompMgr             *hmgr = HD_COMP_MGR (wm->comp_mgr);
   HdApp                 *app = HD_APP (client);
   Window                 win_group;
-  unsigned char         *prop = NULL;
-  unsigned long          items, left;
-  int			 format;
-  Atom                   stack_atom, actual_type;
-  Status                ret;
+  const long            *prop;
+  Atom                   stack_atom;
 
   app->stack_index = -1;  /* initially a non-stackable */
   *replaced = *add_to_tn = NULL;
@@ -1797,26 +1986,12 @@ hd_comp_mgr_handle_stackable (MBWindowManagerClient *client,
   fix_transiency (client);
   stack_atom = hd_comp_mgr_get_atom (hmgr, HD_ATOM_HILDON_STACKABLE_WINDOW);
 
-  mb_wm_util_async_trap_x_errors (wm->xdpy);
-  /*
-   * XGetWindowProperty() is a synchronization point so any errors reported
-   * through the X error handler is most probably due to a bug earlier.
-   * Let's hide the crap under the carpet and ignore it.
-   *
-   * It doesn't make much a difference because the errors would be trapped
-   * and ignored anyway because of various bugs in matchbox (errors being
-   * trapped twice).  Let's pretend they're not.
-   */
-  ret = XGetWindowProperty (wm->xdpy, win->xwindow,
-                            stack_atom, 0, 1, False,
-                            XA_INTEGER, &actual_type, &format,
-                            &items, &left, &prop);
-  mb_wm_util_async_untrap_x_errors ();
-  if (ret != Success)
-    /* Now, the call really failed. */
-    return;
+  /* Most likely it's been prefetched when the window was first seen,
+   * and X errors are returned with the reply. */
+  prop = hd_prop_cache_get (wm, win->xwindow, stack_atom,
+                            XA_INTEGER, 32, 0, NULL);
 
-  if (actual_type == XA_INTEGER)
+  if (prop)
     {
       MBWindowManagerClient *c_tmp;
       HdApp *old_leader = NULL;
@@ -2020,9 +2195,6 @@ hd_comp_mgr_handle_stackable (MBWindowManagerClient *client,
         }
     }
 
-  if (prop)
-    XFree (prop);
-
   /* all stackables have stack_index >= 0 */
   g_assert (!app->leader || (app->leader && app->stack_index >= 0));
 }
@@ -2139,12 +2311,12 @@ hd_comp_mgr_map_notify (MBWMCompMgr *mgr, MBWindowManagerClient *c)
       (!transient_for ||
        mb_wm_client_get_next_focused_app (transient_for) != NULL))
     {
-      guint32 *value;
+      const long *value;
       Atom dnd_override = hd_comp_mgr_get_atom (HD_COMP_MGR (mgr),
 						HD_ATOM_HILDON_DO_NOT_DISTURB_OVERRIDE);
 
-      value = hd_util_get_win_prop_data_and_validate (c->wmref->xdpy,
-                c->window->xwindow, dnd_override, XA_INTEGER, 32, 1, NULL);
+      value = hd_prop_cache_get (c->wmref, c->window->xwindow, dnd_override,
+                                 XA_INTEGER, 32, 1, NULL);
 
       if (!value || *value != 1)
         {
@@ -2152,14 +2324,8 @@ hd_comp_mgr_map_notify (MBWMCompMgr *mgr, MBWindowManagerClient *c)
                    __FUNCTION__);
           mb_wm_client_hide (c);
           mb_wm_client_deliver_delete (c);
-
-         if (value)
-            XFree (value);
           return;
         }
-
-      if (value)
-        XFree (value);
     }
 
   ctype = MB_WM_CLIENT_CLIENT_TYPE (c);
@@ -3757,6 +3923,9 @@ hd_comp_mgr_dump_debug_info (const gchar *tag)
   int i, revert, ninputshapes, unused;
   XRectangle *inputshape;
   ClutterActor *stage;
+  gchar *texmem, **lines;
+  GHashTableIter iter;
+  gpointer atom, handler;
 
   if (tag)
     g_debug ("%s", tag);
@@ -3809,8 +3978,40 @@ hd_comp_mgr_dump_debug_info (const gchar *tag)
     g_debug ("    %dx%d%+d%+d", MBWM_GEOMETRY(&inputshape[i]));
   XFree(inputshape);
 
+  g_debug ("PropertyNotify:");
+  g_hash_table_iter_init (&iter,
+                   HD_COMP_MGR (root->wm->comp_mgr)->priv->property_handlers);
+  while (g_hash_table_iter_next (&iter, &atom, &handler))
+    {
+      char *name;
+
+      name = XGetAtomName (root->wm->xdpy, GPOINTER_TO_UINT (atom));
+      g_debug ("  %s: %u", name,
+               ((HdCompMgrPropertyHandler *)handler)->hits);
+      XFree (name);
+    }
+
+  {
+    HdCompMgrPrivate *priv = HD_COMP_MGR (root->wm->comp_mgr)->priv;
+
+    g_debug ("Effects: %u frames, %u us on average, %u us at most, "
+             "%u over the budget of %u us",
+             priv->effects_ticks,
+             priv->effects_ticks
+               ? (guint)(priv->effects_total_us / priv->effects_ticks) : 0,
+             priv->effects_max_us, priv->effects_overruns,
+             priv->effects_budget_us);
+  }
+
   dump_clutter_actor_tree (clutter_stage_get_default (), NULL);
   hd_app_mgr_dump_app_list (TRUE);
+
+  texmem = tidy_texture_accounting_report (10);
+  lines = g_strsplit (texmem, "\n", 0);
+  for (i = 0; lines[i] && lines[i][0]; i++)
+    g_debug ("%s", lines[i]);
+  g_strfreev (lines);
+  g_free (texmem);
 #endif
 }
 
@@ -3899,13 +4100,82 @@ hd_comp_mgr_update_applets_on_current_desktop_property (HdCompMgr *hmgr)
   mb_wm_util_async_untrap_x_errors ();
 }
 
+/* Parses thp_tweaks::@key of transitions.ini, a list of window names,
+ * into a set. */
+static GHashTable *
+hd_comp_mgr_parse_name_list (const gchar *key)
+{
+  GHashTable *set;
+  gchar *list, **names;
+  guint i;
+
+  set = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  list = hd_transition_get_string ("thp_tweaks", key, "");
+  names = g_strsplit_set (list, " \t,;", -1);
+  for (i = 0; names[i]; i++)
+    if (*names[i])
+      g_hash_table_insert (set, g_strdup (names[i]), GINT_TO_POINTER (1));
+  g_strfreev (names);
+  g_free (list);
+
+  return set;
+}
+
+/* Reading transitions.ini may reload it and unload the lists under
+ * our feet, so the new ones are only published once they're all read. */
+static void
+hd_comp_mgr_load_portrait_lists (void)
+{
+  GHashTable *whitelist, *blacklist;
+  gint forcerotation;
+
+  if (portrait_whitelist && portrait_blacklist)
+    return;
+
+  whitelist = hd_comp_mgr_parse_name_list ("whitelist");
+  blacklist = hd_comp_mgr_parse_name_list ("blacklist");
+  forcerotation = hd_transition_get_int ("thp_tweaks", "forcerotation", 0);
+
+  hd_comp_mgr_unload_portrait_lists (NULL);
+  portrait_whitelist = whitelist;
+  portrait_blacklist = blacklist;
+  portrait_forcerotation = forcerotation;
+}
+
+/* Called when transitions.ini has changed to reload the lists
+ * the next time they're needed. */
+static void
+hd_comp_mgr_unload_portrait_lists (gpointer unused)
+{
+  if (portrait_whitelist)
+    {
+      g_hash_table_destroy (portrait_whitelist);
+      portrait_whitelist = NULL;
+    }
+  if (portrait_blacklist)
+    {
+      g_hash_table_destroy (portrait_blacklist);
+      portrait_blacklist = NULL;
+    }
+}
+
+/* Returns the name of @c's window as the whitelist and the blacklist
+ * know it, or %NULL. */
+static const gchar *
+hd_comp_mgr_get_portrait_name (MBWindowManagerClient *c,
+                               const gchar **res_class)
+{
+  const gchar *res_name;
+
+  if (!hd_comp_mgr_get_class_hint (c, &res_name, res_class) || !*res_class)
+    return NULL;
+  return res_name;
+}
+
 gboolean
 hd_comp_mgr_is_whitelisted(MBWindowManager *wm, MBWindowManagerClient *c)
 {
-  gchar *whitelist;
-  XClassHint class_hint;
-  Status ret;
-  gchar *wname = NULL;
+  const gchar *wname, *wclass;
   gboolean is_on_whitelist = FALSE;
 
   if ((!c) || !MB_WINDOW_MANAGER(wm) || c == wm->desktop)
@@ -3917,22 +4187,9 @@ hd_comp_mgr_is_whitelisted(MBWindowManager *wm, MBWindowManagerClient *c)
       return FALSE;
   }
 
-  whitelist = g_strdup(hd_transition_get_string("thp_tweaks", "whitelist", ""));
-  memset(&class_hint, 0, sizeof(XClassHint));
-  mb_wm_util_async_trap_x_errors (wm->xdpy);
-  ret = XGetClassHint (wm->xdpy, c->window->xwindow, &class_hint);
-  mb_wm_util_async_untrap_x_errors ();
-
-  if (ret && class_hint.res_class)
-    wname = g_strdup(class_hint.res_name);
-
-  if (class_hint.res_class)
-    XFree(class_hint.res_class);
-
-  if (class_hint.res_name)
-    XFree(class_hint.res_name);
-
-  if (g_strrstr(whitelist, wname))
+  hd_comp_mgr_load_portrait_lists ();
+  wname = hd_comp_mgr_get_portrait_name (c, &wclass);
+  if (wname && g_hash_table_lookup (portrait_whitelist, wname))
     is_on_whitelist = TRUE;
 
   PORTRAIT ("Whitelist: WName %s; Supp: %d; Req: %d; SuppInh: %d, ReqInh: %d", wname, c->portrait_supported, c->portrait_requested, c->portrait_supported_inherited, c->portrait_requested_inherited);
@@ -3941,74 +4198,45 @@ hd_comp_mgr_is_whitelisted(MBWindowManager *wm, MBWindowManagerClient *c)
       PORTRAIT("Whitelist: Parent Sup: %d Req: %d", c->transient_for->portrait_supported, c->transient_for->portrait_requested);
 #endif
 
-  g_free(whitelist);
-  g_free(wname);
-
   return is_on_whitelist;
 }
 
 gboolean
 hd_comp_mgr_is_blacklisted(MBWindowManager *wm, MBWindowManagerClient *c)
 {
-  gchar *blacklist;
-  XClassHint class_hint;
-  Status ret;
-  gchar *wname = NULL;
+  const gchar *wname, *wclass;
   gboolean blacklisted = FALSE;
-  gboolean blacklisted_by_desktopfile = FALSE;
-  gboolean forcerotation = hd_transition_get_int("thp_tweaks", "forcerotation", 0);
 
   if ((!c) || !HD_IS_APP (c) || !MB_WINDOW_MANAGER(wm) || c == wm->desktop)
     return FALSE;
 
-  blacklist = g_strdup (hd_transition_get_string ("thp_tweaks", "blacklist", ""));
-  memset (&class_hint, 0, sizeof (XClassHint));
-  mb_wm_util_async_trap_x_errors (wm->xdpy);
-  ret = XGetClassHint (wm->xdpy, c->window->xwindow, &class_hint);
-  mb_wm_util_async_untrap_x_errors ();
-
-  if (ret && class_hint.res_class)
-    wname = g_strdup (class_hint.res_name);
+  wname = hd_comp_mgr_get_portrait_name (c, &wclass);
 
   /* Check, if X-CSSU-Force-Landscape=true. */
-  blacklisted_by_desktopfile = hd_comp_mgr_is_blacklisted_parse_desktop_file (wname, class_hint.res_class, c->window->pid);
-
-  if (class_hint.res_class)
-    XFree(class_hint.res_class);
-
-  if (class_hint.res_name)
-    XFree(class_hint.res_name);
-
-  if (!blacklisted_by_desktopfile)
-    {
-      if (g_strrstr(blacklist, wname))
-        blacklisted = TRUE;
-
-      if (c->stacked_below && (wname == NULL))
-        if (hd_comp_mgr_is_blacklisted (wm, c->stacked_below))
-          blacklisted = TRUE;
-    }
-
-  g_free (blacklist);
-  g_free (wname);
-
-  if (blacklisted_by_desktopfile)
+  if (hd_comp_mgr_is_blacklisted_parse_desktop_file (wname, wclass,
+                                                     c->window->pid))
     return TRUE;
 
+  hd_comp_mgr_load_portrait_lists ();
+  if (wname)
+    blacklisted = g_hash_table_lookup (portrait_blacklist, wname) != NULL;
+  else if (c->stacked_below && hd_comp_mgr_is_blacklisted (wm, c->stacked_below))
+    blacklisted = TRUE;
+
   /* Do not lock to landscape a window which supports portrait mode. */
   if (c->portrait_supported || c->portrait_requested)
       return FALSE;
 
   /* We don't want blacklisted windows when forcerotation == 0. */
-  if (!forcerotation)
+  if (!portrait_forcerotation)
     return FALSE;
 
   return blacklisted;
 }
 
 gboolean
-hd_comp_mgr_is_blacklisted_parse_desktop_file(char *res_name, 
-                                              char *res_class, GPid pid)
+hd_comp_mgr_is_blacklisted_parse_desktop_file(const char *res_name,
+                                              const char *res_class, GPid pid)
 {
   HdLauncherTree *tree;
   HdLauncherItem *item;
@@ -4033,35 +4261,13 @@ hd_comp_mgr_is_blacklisted_parse_desktop_file(char *res_name,
 gboolean
 hd_comp_mgr_is_callui_window (MBWindowManager *wm, MBWindowManagerClient *c)
 {
-  gchar *whitelist = "rtcom-call-ui";
-  XClassHint class_hint;
-  Status ret;
-  gchar *wname = NULL;
-  gboolean is_callui_window = FALSE;
+  const gchar *wname, *wclass;
 
   if ((!c) || !MB_WINDOW_MANAGER(wm) || c == wm->desktop)
     return FALSE;
 
-  memset(&class_hint, 0, sizeof(XClassHint));
-  mb_wm_util_async_trap_x_errors (wm->xdpy);
-  ret = XGetClassHint (wm->xdpy, c->window->xwindow, &class_hint);
-  mb_wm_util_async_untrap_x_errors ();
-
-  if (ret && class_hint.res_class)
-    wname = g_strdup(class_hint.res_name);
-
-  if (class_hint.res_class)
-    XFree(class_hint.res_class);
-
-  if (class_hint.res_name)
-    XFree(class_hint.res_name);
-
-  if (g_strrstr(whitelist, wname))
-    is_callui_window = TRUE;
-
-  g_free(wname);
-
-  return is_callui_window;
+  wname = hd_comp_mgr_get_portrait_name (c, &wclass);
+  return wname && !strcmp (wname, "rtcom-call-ui");
 }
 
 gboolean
@@ -24,6 +24,7 @@
 #include "hd-decor.h"
 #include "hd-theme.h"
 #include "hd-comp-mgr.h"
+#include "hd-prop-cache.h"
 #include "hd-app.h"
 
 #include "hd-title-bar.h"
@@ -120,34 +121,12 @@ static gboolean
 hd_decor_window_check_prop (MBWindowManager *wm, Window w, HdAtoms atom)
 {
   HdCompMgr *hmgr = HD_COMP_MGR (wm->comp_mgr);
-  Atom progress_indicator =
-      hd_comp_mgr_get_atom (hmgr, atom);
-  Atom actual_type_return;
-  int actual_format_return;
-  unsigned long nitems_return;
-  unsigned long bytes_after_return;
-  unsigned char* prop_return = NULL;
-  int result = 0;
-
-  mb_wm_util_async_trap_x_errors(wm->xdpy);
-  XGetWindowProperty (wm->xdpy, w,
-                      progress_indicator,
-                      0, G_MAXLONG,
-                      False,
-                      AnyPropertyType,
-                      &actual_type_return,
-                      &actual_format_return,
-                      &nitems_return,
-                      &bytes_after_return,
-                      &prop_return);
-  if (prop_return)
-    {
-      result = prop_return[0];
-      XFree (prop_return);
-    }
-  mb_wm_util_async_untrap_x_errors();
+  const unsigned char *prop;
 
-  return result;
+  /* Looked at every time the decoration is updated, so better be cached. */
+  prop = hd_prop_cache_get (wm, w, hd_comp_mgr_get_atom (hmgr, atom),
+                            AnyPropertyType, 0, 0, NULL);
+  return prop ? prop[0] : 0;
 }
 
 gboolean
@@ -24,6 +24,7 @@
 #include "hd-note.h"
 #include "hd-comp-mgr.h"
 #include "hd-util.h"
+#include "hd-prop-cache.h"
 #include "hd-wm.h"
 #include "hd-render-manager.h"
 
@@ -57,13 +58,17 @@ static HdAtoms IEProperties[] =
   HD_ATOM_HILDON_INCOMING_EVENT_NOTIFICATION_DESTINATION,
 };
 
+/* Returns a copy of a string property of @self, which is most likely
+ * cached already.  g_free() it. */
 static char *
 get_x_window_string_property (HdNote *self, HdAtoms atom_id)
 {
-  return hd_util_get_x_window_string_property (
-                                  MB_WM_CLIENT (self)->wmref,
-                                  MB_WM_CLIENT (self)->window->xwindow,
-                                  atom_id);
+  MBWindowManager *wm = MB_WM_CLIENT (self)->wmref;
+
+  return g_strdup (hd_prop_cache_get_string (wm,
+                          MB_WM_CLIENT (self)->window->xwindow,
+                          hd_comp_mgr_get_atom (HD_COMP_MGR (wm->comp_mgr),
+                                                atom_id)));
 }
 
 static void
@@ -145,8 +150,9 @@ x_window_property_changed (XPropertyEvent *event, HdNote *self)
        *      else
        *        mass = TRUE;
        */
-      if (self->properties[i])
-        XFree (self->properties[i]);
+      /* Our handler may be called before the one of the #HdCompMgr. */
+      hd_prop_cache_invalidate (event->window, event->atom);
+      g_free (self->properties[i]);
       self->properties[i] = NULL;
       mb_wm_object_signal_emit (MB_WM_OBJECT (self), HdNoteSignalChanged);
       break;
@@ -217,8 +223,7 @@ hd_note_destroy (MBWMObject *this)
                                   PropertyNotify,
                                   note->property_changed_cb_id);
       for (i = 0; i < G_N_ELEMENTS (IEProperties); i++)
-        if (note->properties[i])
-          XFree (note->properties[i]);
+        g_free (note->properties[i]);
     }
 }
 
@@ -249,12 +254,22 @@ hd_note_init (MBWMObject *this, va_list vap)
 	  g_warning ("Unknown hildon notification type.");
 	}
 
-      XFree (prop);
+      g_free (prop);
     }
 
   if (note->note_type == HdNoteTypeIncomingEvent)
     {
       MBGeometry geom;
+      Atom atoms[G_N_ELEMENTS (IEProperties)];
+      guint i;
+
+      /* The switcher will want all of them soon. */
+      for (i = 0; i < G_N_ELEMENTS (IEProperties); i++)
+        atoms[i] = hd_comp_mgr_get_atom (HD_COMP_MGR (wm->comp_mgr),
+                                         IEProperties[i]);
+      hd_prop_cache_prefetch (wm, client->window->xwindow,
+                              atoms, G_N_ELEMENTS (atoms));
+
       geom.width  = client->frame_geometry.width;
       geom.height = client->frame_geometry.height;
       geom.x = 0;
@@ -570,7 +585,7 @@ hd_note_stack (MBWindowManagerClient *client,
 
 
 /* Define an accessor function that caches @IEProperties[@prop]'s value
- * in #HdNote.properties and returns it, which must not be XFree()d. */
+ * in #HdNote.properties and returns it, which must not be freed. */
 #define DEFINE_ACCESSOR(prop, field)                                          \
 const char *hd_note_get_##field (HdNote *self)                                \
 {                                                                             \
@@ -29,6 +29,42 @@
 #include <sys/time.h>
 #include <sys/shm.h>
 #include <time.h>
+#include <string.h>
+
+/*
+ * Version 2 of the shared memory protocol
+ *
+ * With _HILDON_TEXTURE_CLIENT_MESSAGE_SHM the client and we share a single
+ * buffer, so the client tears the picture if it draws while we upload.
+ * A client can avoid that by sending _HILDON_TEXTURE_CLIENT_MESSAGE_SHM2
+ * (key, width, height, bpp, n_buffers) instead, where the segment holds
+ * 2..HD_REMOTE_TEXTURE_MAX_BUFFERS frames of width*height*bpp bytes each,
+ * one after the other.  Buffer 0 is shown initially.
+ *
+ * When the client has finished a frame it sends
+ * _HILDON_TEXTURE_CLIENT_MESSAGE_BUFFER (index, x, y, width, height),
+ * where the rectangle is what changed since the buffer shown before.
+ * Every buffer must hold a complete frame.  We stop reading the previous
+ * buffer at once and give it back to the client with a
+ * _HILDON_TEXTURE_CLIENT_MESSAGE_RELEASE (index) message to the window.
+ * Until then the client must not touch it.
+ *
+ * Version 3 adds batched damage.  If the client sets
+ * HD_REMOTE_TEXTURE_SHM_DAMAGE_RING in the last item of SHM2, a
+ * HdRemoteTextureDamageRing follows the pixel buffers in the segment.
+ * The last item of SHM has never been looked at, so old clients may
+ * leave anything there.  A single-buffered client wanting the ring
+ * sends SHM2 with n_buffers 1, and goes on as if it had sent SHM.
+ * Instead of a _HILDON_TEXTURE_CLIENT_MESSAGE_DAMAGE for every rectangle
+ * the client can add them to the ring and send a single
+ * _HILDON_TEXTURE_CLIENT_MESSAGE_DAMAGE_BATCH.  We read the ring once
+ * before the next redraw, however many batches arrived meanwhile.
+ * If the client overruns the ring we damage the whole texture.
+ *
+ * The second item of the _HILDON_TEXTURE_CLIENT_READY property is the
+ * highest protocol version we understand.
+ */
+#define PROTOCOL_VERSION 3
 
 #define CLIENT_MESSAGE_DEBUG 0//1
 
@@ -46,6 +82,10 @@ static guint32 offset_atom;
 static guint32 scale_atom;
 static guint32 parent_atom;
 static guint32 ready_atom;
+static guint32 shm2_atom;
+static guint32 buffer_atom;
+static guint32 release_atom;
+static guint32 damage_batch_atom;
 static gboolean atoms_initialized = 0;
 
 void
@@ -56,7 +96,66 @@ hd_remote_texture_request_geometry (MBWindowManagerClient *client,
 				     MBWMClientReqGeomType  flags);
 static void
 hd_remote_texture_set_shm(HdRemoteTexture *tex, key_t key,
-                          guint width, guint height, guint bpp);
+                          guint width, guint height, guint bpp,
+                          guint buffers, gboolean damage_ring);
+
+/* Tells the client it may draw into @buffer again. */
+static void
+hd_remote_texture_release_buffer (HdRemoteTexture *self, guint buffer)
+{
+  MBWindowManagerClient *client = MB_WM_CLIENT (self);
+  Display *xdpy = client->wmref->xdpy;
+  XEvent xev;
+
+  memset (&xev, 0, sizeof (xev));
+  xev.xclient.type = ClientMessage;
+  xev.xclient.window = client->window->xwindow;
+  xev.xclient.message_type = release_atom;
+  xev.xclient.format = 32;
+  xev.xclient.data.l[0] = buffer;
+
+  mb_wm_util_async_trap_x_errors (xdpy);
+  XSendEvent (xdpy, xev.xclient.window, False, NoEventMask, &xev);
+  XFlush (xdpy);
+  mb_wm_util_async_untrap_x_errors ();
+}
+
+/* Where the damage ring starts in a segment of @size bytes of pixels. */
+#define DAMAGE_RING_OFFSET(size)  (((size) + 7) & ~7)
+
+/* Damages the rectangles the client has added to the ring since the last
+ * time, or the whole texture if it has overwritten some of them. */
+static gboolean
+hd_remote_texture_drain_damage (HdRemoteTexture *self)
+{
+  const HdRemoteTextureDamageRing *ring = self->damage_ring;
+  guint32 head, tail;
+
+  self->damage_drain_cb = 0;
+  if (!ring)
+    return FALSE;
+
+  head = g_atomic_int_get ((gint *)&ring->head);
+  tail = self->damage_tail;
+  if (head - tail <= HD_REMOTE_TEXTURE_DAMAGE_RING_SIZE)
+    for (; tail != head; tail++)
+      {
+        guint i = tail % HD_REMOTE_TEXTURE_DAMAGE_RING_SIZE;
+
+        tidy_mem_texture_damage (self->texture,
+                                 ring->rects[i].x, ring->rects[i].y,
+                                 ring->rects[i].width, ring->rects[i].height);
+      }
+
+  /* Has the client lapped us either before or while we were reading? */
+  if (g_atomic_int_get ((gint *)&ring->head) - self->damage_tail
+      > HD_REMOTE_TEXTURE_DAMAGE_RING_SIZE)
+    tidy_mem_texture_damage (self->texture, 0, 0,
+                             self->shm_width, self->shm_height);
+
+  self->damage_tail = head;
+  return FALSE;
+}
 
 static Bool
 hd_remote_texture_client_message (XClientMessageEvent *xev, void *userdata)
@@ -89,12 +188,82 @@ hd_remote_texture_client_message (XClientMessageEvent *xev, void *userdata)
         hd_remote_texture_set_shm(self, shm_key,
             shm_width,
             shm_height,
-            shm_bpp);
+            shm_bpp, 1, FALSE);
 
         CM_DEBUG ("RemoteTexture %p: shm(key=%d, width=%d, height=%d, bpp=%d)\n",
                   self, shm_key,
                   shm_width, shm_height, shm_bpp);
     }
+  else if (xev->message_type == shm2_atom)
+    {
+        key_t shm_key = (key_t) xev->data.l[0];
+        guint shm_width = (guint) xev->data.l[1];
+        guint shm_height = (guint) xev->data.l[2];
+        guint shm_bpp = (guint) xev->data.l[3];
+        guint shm_buffers = (guint) xev->data.l[4] & 0xff;
+        guint flags = (guint) xev->data.l[4] & ~0xff;
+
+        CM_DEBUG ("RemoteTexture %p: shm2(key=%d, width=%d, height=%d, "
+                  "bpp=%d, buffers=%d)\n", self, shm_key,
+                  shm_width, shm_height, shm_bpp, shm_buffers);
+        if (shm_buffers < 1 || shm_buffers > HD_REMOTE_TEXTURE_MAX_BUFFERS)
+          {
+            g_warning ("RemoteTexture %p: can't share %u buffers",
+                       self, shm_buffers);
+            return False;
+          }
+
+        hd_remote_texture_set_shm(self, shm_key,
+            shm_width,
+            shm_height,
+            shm_bpp, shm_buffers,
+            flags & HD_REMOTE_TEXTURE_SHM_DAMAGE_RING);
+    }
+  else if (xev->message_type == buffer_atom)
+    {
+        guint buffer = (guint) xev->data.l[0];
+        gint x = (gint) xev->data.l[1];
+        gint y = (gint) xev->data.l[2];
+        gint width = (gint) xev->data.l[3];
+        gint height = (gint) xev->data.l[4];
+        guint previous;
+
+        CM_DEBUG ("RemoteTexture %p: buffer(index=%u, x=%d, y=%d, "
+                  "width=%d, height=%d)\n",
+                  self, buffer, x, y, width, height);
+        if (!self->shm_addr || self->shm_buffers < 2
+            || buffer >= self->shm_buffers)
+          {
+            g_warning ("RemoteTexture %p: stray buffer %u", self, buffer);
+            return False;
+          }
+
+        previous = self->shm_current;
+        self->shm_current = buffer;
+        tidy_mem_texture_set_buffer(self->texture,
+            self->shm_addr
+              + buffer * self->shm_width * self->shm_height * self->shm_bpp);
+        tidy_mem_texture_damage(self->texture, x, y, width, height);
+
+        /* The texture doesn't look at the previous buffer anymore. */
+        if (previous != buffer)
+          hd_remote_texture_release_buffer (self, previous);
+    }
+  else if (xev->message_type == damage_batch_atom)
+    {
+        CM_DEBUG ("RemoteTexture %p: damage-batch()\n", self);
+        if (!self->damage_ring)
+          {
+            g_warning ("RemoteTexture %p: damage batch without a ring", self);
+            return False;
+          }
+
+        /* Read them all at once before the next redraw. */
+        if (!self->damage_drain_cb)
+          self->damage_drain_cb = g_idle_add_full (CLUTTER_PRIORITY_REDRAW - 1,
+                          (GSourceFunc)hd_remote_texture_drain_damage,
+                          self, NULL);
+    }
   else if (xev->message_type == damage_atom)
     {
         gint x = (gint) xev->data.l[0];
@@ -274,6 +443,14 @@ hd_remote_texture_realize (MBWindowManagerClient *client)
 	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_PARENT);
 	ready_atom = hd_comp_mgr_get_atom
 	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_READY);
+	shm2_atom = hd_comp_mgr_get_atom
+	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_SHM2);
+	buffer_atom = hd_comp_mgr_get_atom
+	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_BUFFER);
+	release_atom = hd_comp_mgr_get_atom
+	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_RELEASE);
+	damage_batch_atom = hd_comp_mgr_get_atom
+	    (hmgr, HD_ATOM_HILDON_TEXTURE_CLIENT_MESSAGE_DAMAGE_BATCH);
 
 	atoms_initialized = 1;
     }
@@ -304,13 +481,13 @@ hd_remote_texture_realize (MBWindowManagerClient *client)
   XSelectInput (wm->xdpy, window, event_mask);
 
   /* Set the ready atom on the window -- everything is in place to receive
-   * ClientMessage events. */
+   * ClientMessage events.  Old clients only look at the first item. */
 
-  long val = 1;
+  long val[] = { 1, PROTOCOL_VERSION };
   XChangeProperty (wm->xdpy, window,
 		   ready_atom,
 		   XA_ATOM, 32, PropModeReplace,
-		   (unsigned char *) &val, 1);
+		   (unsigned char *) val, G_N_ELEMENTS (val));
 }
 
 static void
@@ -348,7 +525,7 @@ hd_remote_texture_destroy (MBWMObject *this)
                                                  self->client_message_handler_id);
   }
   /* unattach ourselves if we were attached */
-  hd_remote_texture_set_shm(self, 0, 0, 0, 0);
+  hd_remote_texture_set_shm(self, 0, 0, 0, 0, 0, FALSE);
   /* free our texture */
   clutter_actor_destroy(CLUTTER_ACTOR(self->texture));
   self->texture = 0;
@@ -458,9 +635,19 @@ hd_remote_texture_new (MBWindowManager *wm, MBWMClientWindow *win)
 
 static void
 hd_remote_texture_set_shm(HdRemoteTexture *tex, key_t key,
-                          guint width, guint height, guint bpp)
+                          guint width, guint height, guint bpp,
+                          guint buffers, gboolean damage_ring)
 {
   int shm_id;
+
+  if (tex->damage_drain_cb)
+    {
+      g_source_remove (tex->damage_drain_cb);
+      tex->damage_drain_cb = 0;
+    }
+  tex->damage_ring = NULL;
+  tex->damage_tail = 0;
+
   /* un-attach this segment */
   if (tex->shm_addr)
     {
@@ -474,6 +661,8 @@ hd_remote_texture_set_shm(HdRemoteTexture *tex, key_t key,
       tex->shm_width = 0;
       tex->shm_height = 0;
       tex->shm_bpp = 0;
+      tex->shm_buffers = 0;
+      tex->shm_current = 0;
     }
 
   if (key == 0)
@@ -483,7 +672,9 @@ hd_remote_texture_set_shm(HdRemoteTexture *tex, key_t key,
   tex->shm_width = width;
   tex->shm_height = height;
   tex->shm_bpp = bpp;
-  guint size = width*height*bpp;
+  guint size = width*height*bpp*buffers;
+  if (damage_ring)
+    size = DAMAGE_RING_OFFSET(size) + sizeof(HdRemoteTextureDamageRing);
   if ((shm_id = shmget(key, size, 0666)) < 0)
     {
       g_critical("%s: shmget failed, size %d", __FUNCTION__, size);
@@ -504,6 +695,14 @@ hd_remote_texture_set_shm(HdRemoteTexture *tex, key_t key,
       return;
     }
 
+  tex->shm_buffers = buffers;
+  tex->shm_current = 0;
+  if (damage_ring)
+    {
+      tex->damage_ring = (const HdRemoteTextureDamageRing *)
+        (tex->shm_addr + DAMAGE_RING_OFFSET(width*height*bpp*buffers));
+      tex->damage_tail = tex->damage_ring->head;
+    }
   tidy_mem_texture_set_data(tex->texture,
       tex->shm_addr,
       tex->shm_width, tex->shm_height,
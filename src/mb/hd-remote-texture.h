@@ -28,6 +28,28 @@
 #include <matchbox/client-types/mb-wm-client-app.h>
 #include <tidy/tidy-mem-texture.h>
 
+/* Highest number of buffers a version 2 (_HILDON_TEXTURE_CLIENT_MESSAGE_SHM2)
+ * client can share with us. */
+#define HD_REMOTE_TEXTURE_MAX_BUFFERS 3
+
+/* Set in the last item of _HILDON_TEXTURE_CLIENT_MESSAGE_SHM2
+ * if a HdRemoteTextureDamageRing follows the pixel buffers. */
+#define HD_REMOTE_TEXTURE_SHM_DAMAGE_RING (1 << 8)
+#define HD_REMOTE_TEXTURE_DAMAGE_RING_SIZE 64
+
+/* Shared with the client, 8-byte aligned after the last pixel buffer.
+ * The client writes rectangles at @head % SIZE and increments @head,
+ * which counts all rectangles written so far. */
+typedef struct
+{
+  guint32 head;
+  guint32 reserved;
+  struct
+  {
+    gint32 x, y, width, height;
+  } rects[HD_REMOTE_TEXTURE_DAMAGE_RING_SIZE];
+} HdRemoteTextureDamageRing;
+
 typedef struct HdRemoteTexture      HdRemoteTexture;
 typedef struct HdRemoteTextureClass HdRemoteTextureClass;
 
@@ -49,6 +71,17 @@ struct HdRemoteTexture
   guint         shm_height;
   guint         shm_bpp;
   const guchar *shm_addr;
+
+  /* The number of buffers in the segment and the one being shown.
+   * Version 1 clients have a single buffer. */
+  guint         shm_buffers;
+  guint         shm_current;
+
+  /* Optional damage ring in the segment, how far we've read it and
+   * the idle callback reading it before the next redraw. */
+  const HdRemoteTextureDamageRing *damage_ring;
+  guint32       damage_tail;
+  guint         damage_drain_cb;
 };
 
 struct HdRemoteTextureClass
@@ -58,6 +58,7 @@
 #include "hd-animation-actor.h"
 #include "hd-remote-texture.h"
 #include "hd-util.h"
+#include "hd-prop-cache.h"
 
 static int  hd_wm_init       (MBWMObject *object, va_list vap);
 static void hd_wm_destroy    (MBWMObject *object);
@@ -153,7 +154,7 @@ hd_wm_comp_mgr_new (MBWindowManager *wm)
 }
 
 static MBWindowManagerClient*
-hd_wm_client_new (MBWindowManager *wm, MBWMClientWindow *win)
+hd_wm_client_new_for_type (MBWindowManager *wm, MBWMClientWindow *win)
 {
   HdCompMgr            *hmgr = HD_COMP_MGR (wm->comp_mgr);
   MBWindowManagerClass *wm_class =
@@ -247,6 +248,39 @@ hd_wm_client_new (MBWindowManager *wm, MBWMClientWindow *win)
     }
 }
 
+/* The properties the clients' constructors and the map notification
+ * look at, which we request in one go for new windows. */
+static const HdAtoms prefetched_properties[] =
+{
+  HD_ATOM_WM_WINDOW_ROLE,
+  HD_ATOM_HILDON_APP_KILLABLE,
+  HD_ATOM_HILDON_ABLE_TO_HIBERNATE,
+  HD_ATOM_HILDON_STACKABLE_WINDOW,
+  HD_ATOM_HILDON_NON_COMPOSITED_WINDOW,
+  HD_ATOM_HILDON_WM_WINDOW_PROGRESS_INDICATOR,
+  HD_ATOM_HILDON_WM_WINDOW_MENU_INDICATOR,
+  HD_ATOM_HILDON_NOTIFICATION_TYPE,
+  HD_ATOM_HILDON_DO_NOT_DISTURB_OVERRIDE,
+};
+
+static MBWindowManagerClient*
+hd_wm_client_new (MBWindowManager *wm, MBWMClientWindow *win)
+{
+  HdCompMgr *hmgr = HD_COMP_MGR (wm->comp_mgr);
+  MBWindowManagerClient *client;
+  Atom atoms[G_N_ELEMENTS (prefetched_properties) + 1];
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (prefetched_properties); i++)
+    atoms[i] = hd_comp_mgr_get_atom (hmgr, prefetched_properties[i]);
+  atoms[i++] = XA_WM_CLASS;
+  hd_prop_cache_prefetch (wm, win->xwindow, atoms, i);
+
+  if (!(client = hd_wm_client_new_for_type (wm, win)))
+    hd_prop_cache_forget (wm, win->xwindow);
+  return client;
+}
+
 #if 0
 static gboolean
 show_info_note (gpointer data)
@@ -8,6 +8,9 @@
 
 #include "tidy-blur-group.h"
 #include "tidy-util.h"
+#include "tidy-texture-accounting.h"
+#include "tidy-fbo-pool.h"
+#include "tidy-kawase-shaders.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -19,8 +22,11 @@
 
 #include <string.h>
 #include <locale.h>
+#include <math.h>
 
 #include "util/hd-transition.h"
+#include "util/hd-cpu-blur.h"
+#include "hildon-desktop.h"
 
 /* #define it something sane */
 #define TIDY_IS_SANE_BLUR_GROUP(obj)    ((obj) != NULL)
@@ -50,6 +56,23 @@
  * there may be some SGX syncing problem causing the second iteration to
  * work with the texture from *before* the first iteration */
 
+/* With [blur] mode = kawase in transitions.ini we don't do blur steps,
+ * but downsample the source through a chain of half-size textures and
+ * upsample it back ("dual Kawase" blur), all in the same frame.  This is
+ * the maximum length of the chain.  Without shaders the passes are plain
+ * bilinear scaling, which is still a decent blur. */
+#define KAWASE_LEVELS 4
+/* Don't go below this size in the chain. */
+#define KAWASE_MIN_SIZE 8
+
+/* Without shaders we read back the source, blur it on the CPU and
+ * upload the result once per blur change.  Before blurring, the source
+ * is shrunk by up to this much, so the cost doesn't grow with the radius
+ * as much.  It's shrunk so that it's still blurred by at least
+ * CPU_BLUR_MIN_SIGMA texels. */
+#define CPU_BLUR_MAX_SHRINK 4
+#define CPU_BLUR_MIN_SIGMA  2
+
 /* The OpenGL fragment shader used to do blur and desaturation.
  * We use 3 samples here arranged in a rough triangle. We need
  * 2 versions as GLES and GL use slightly different syntax */
@@ -110,6 +133,8 @@ const char *BLUR_VERTEX_SHADER =
     "  tex_coord_b = tex_coord + vec2(blurx, blury);\n"
     "  frag_color = color_attrib;\n"
   "}\n";
+const char *KAWASE_DOWN_FRAGMENT_SHADER = TIDY_KAWASE_DOWN_FRAGMENT_SHADER;
+const char *KAWASE_UP_FRAGMENT_SHADER = TIDY_KAWASE_UP_FRAGMENT_SHADER;
 const char *SATURATE_FRAGMENT_SHADER =
 "precision lowp float;\n"
 "varying lowp    vec4  frag_color;\n"
@@ -129,6 +154,8 @@ const char *SATURATE_FRAGMENT_SHADER =
 const char *BLUR_FRAGMENT_SHADER = "";
 const char *BLUR_FRAGMENT_SHADER_BLURLESS = "";
 const char *BLUR_VERTEX_SHADER = "";
+const char *KAWASE_DOWN_FRAGMENT_SHADER = "";
+const char *KAWASE_UP_FRAGMENT_SHADER = "";
 const char *SATURATE_FRAGMENT_SHADER = "";
 #endif /* HAS_GLES */
 
@@ -143,7 +170,24 @@ struct _TidyBlurGroupPrivate
   CoglHandle fbo_a;
   CoglHandle tex_b;
   CoglHandle fbo_b;
+  /* The size of tex_[ab], even while we've put them back to the pool */
+  guint tex_width, tex_height;
   CoglHandle tex_chequer; /* chequer texture used for dimming video overlays */
+
+  /* Dual Kawase blur: the downsampling chain, @kawase_levels long */
+  gboolean kawase;
+  ClutterShader *shader_kawase_down;
+  ClutterShader *shader_kawase_up;
+  CoglHandle kawase_tex[KAWASE_LEVELS];
+  CoglHandle kawase_fbo[KAWASE_LEVELS];
+  gint kawase_levels;
+  /* transitions.ini has changed, see whether [blur] mode has too */
+  gboolean mode_changed;
+
+  /* Blurred on the CPU: the result and whether to paint that */
+  gboolean cpu_blur;
+  CoglHandle tex_cpu;
+  gboolean cpu_blurred;
   gboolean current_is_a;
   gboolean current_is_rotated;
 
@@ -165,6 +209,13 @@ struct _TidyBlurGroupPrivate
   /* if anything changed we need to recalculate preblur */
   gboolean source_changed;
 
+  /* Bumped whenever our children are damaged or restacked.  What we have
+   * blurred is only reused while it was rendered from the same
+   * generation and the same stacking, see tidy_blur_group_source_dirty(). */
+  guint source_generation;
+  guint blurred_generation;
+  guint blurred_stacking;
+
   /* don't progress the animation for one clutter_actor_paint() */
   gboolean skip_progress;
 
@@ -201,7 +252,7 @@ gboolean tidy_blur_group_notify_modified_real(ClutterActor          *actor,
   TidyBlurGroup *container = TIDY_BLUR_GROUP(actor);
   TidyBlurGroupPrivate *priv = container->priv;
   if (child != NULL)
-    priv->source_changed = TRUE;
+    priv->source_generation++;
   return TRUE;
 }
 
@@ -243,7 +294,118 @@ static void tidy_blur_group_check_shader(TidyBlurGroup *group,
    }
 }
 
-/* Allocate @priv->fbo_[ab]. */
+/* Get *@tex and *@fbo from the pool.  Returns whether they are the
+ * same as we've put back. */
+static gboolean
+tidy_blur_group_new_fbo (TidyBlurGroup *self, guint width, guint height,
+                         CoglHandle *tex, CoglHandle *fbo)
+{
+  TidyBlurGroupPrivate *priv = self->priv;
+
+  return tidy_fbo_pool_get(width, height,
+                           priv->use_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 :
+                                             COGL_PIXEL_FORMAT_RGB_565,
+                           "blur-group", tex, fbo);
+}
+
+/* Put back @priv->fbo_[ab] and the Kawase chain to the pool while we
+ * don't need them, so that other groups can use them.  If @keep we'll
+ * still use what we have blurred if we get them back intact. */
+static void
+tidy_blur_group_free_textures (TidyBlurGroup *self, gboolean keep)
+{
+  TidyBlurGroupPrivate *priv = self->priv;
+  gint i;
+
+  tidy_fbo_pool_put(&priv->tex_a, &priv->fbo_a, keep);
+  tidy_fbo_pool_put(&priv->tex_b, &priv->fbo_b, keep);
+  for (i = 0; i < priv->kawase_levels; i++)
+    tidy_fbo_pool_put(&priv->kawase_tex[i], &priv->kawase_fbo[i], keep);
+  priv->kawase_levels = 0;
+}
+
+/* Reads [blur] mode from transitions.ini.  If it's changed everything
+ * we've blurred is thrown away, since the chain goes with the mode. */
+static void
+tidy_blur_group_read_mode (TidyBlurGroup *self)
+{
+  TidyBlurGroupPrivate *priv = self->priv;
+  gboolean kawase;
+  gchar *mode;
+
+  priv->mode_changed = FALSE;
+  mode = hd_transition_get_string("blur", "mode", "steps");
+  kawase = !priv->tweaks_blurless && !strcmp(mode, "kawase");
+  g_free(mode);
+  if (kawase == priv->kawase)
+    return;
+
+  tidy_blur_group_free_textures(self, FALSE);
+  priv->kawase = kawase;
+  priv->current_blur_step = 0;
+  priv->max_blur_step = 0;
+  priv->source_changed = TRUE;
+  if (kawase)
+    {
+      tidy_blur_group_check_shader(self, &priv->shader_kawase_down,
+                                   KAWASE_DOWN_FRAGMENT_SHADER, 0);
+      tidy_blur_group_check_shader(self, &priv->shader_kawase_up,
+                                   KAWASE_UP_FRAGMENT_SHADER, 0);
+    }
+}
+
+/* transitions.ini may be reloaded in the middle of painting, so only
+ * take note and read the mode before we paint next. */
+static void
+tidy_blur_group_ini_changed (gpointer self)
+{
+  TIDY_BLUR_GROUP(self)->priv->mode_changed = TRUE;
+  clutter_actor_queue_redraw(CLUTTER_ACTOR(self));
+}
+
+/* Get @priv->fbo_[ab] and the Kawase chain from the pool for painting.
+ * If anyone else has used them meanwhile we need to start over. */
+static void
+tidy_blur_group_get_textures (TidyBlurGroup *self)
+{
+  TidyBlurGroupPrivate *priv = self->priv;
+  guint tex_width, tex_height;
+  gboolean intact;
+  gint i;
+
+  if (priv->fbo_a || !priv->tex_width || !priv->tex_height)
+    return;
+
+  tex_width = priv->tex_width;
+  tex_height = priv->tex_height;
+  intact = tidy_blur_group_new_fbo(self, tex_width, tex_height,
+                                   &priv->tex_a, &priv->fbo_a);
+  intact &= tidy_blur_group_new_fbo(self, tex_width, tex_height,
+                                    &priv->tex_b, &priv->fbo_b);
+
+  if (priv->kawase)
+    for (i = 0; i < KAWASE_LEVELS; i++)
+      {
+        tex_width  /= 2;
+        tex_height /= 2;
+        if (tex_width < KAWASE_MIN_SIZE || tex_height < KAWASE_MIN_SIZE)
+          break;
+        tidy_blur_group_new_fbo(self, tex_width, tex_height,
+                                &priv->kawase_tex[i], &priv->kawase_fbo[i]);
+        cogl_texture_set_filters(priv->kawase_tex[i], CGL_LINEAR, CGL_LINEAR);
+        priv->kawase_levels++;
+      }
+
+  if (!intact)
+    {
+      priv->current_blur_step = 0;
+      priv->max_blur_step = 0;
+      priv->source_changed = TRUE;
+    }
+}
+
+/* Work out the size of @priv->fbo_[ab] when we're resized.  We get
+ * them in _paint(). */
 static void
 tidy_blur_group_allocate_textures (TidyBlurGroup *self)
 {
@@ -257,29 +419,12 @@ tidy_blur_group_allocate_textures (TidyBlurGroup *self)
 #endif
 
 #if !RESIZE_TEXTURE
-  if (priv->fbo_a && priv->fbo_b)
+  if (priv->tex_width && priv->tex_height)
     /* Rotate in _paint() rather than resize. */
     return;
 #endif
 
-  /* Free the textures. */
-  if (priv->fbo_a)
-    {
-      cogl_offscreen_unref(priv->fbo_a);
-      cogl_texture_unref(priv->tex_a);
-      priv->fbo_a = 0;
-      priv->tex_a = 0;
-    }
-  if (priv->fbo_b)
-    {
-      cogl_offscreen_unref(priv->fbo_b);
-      cogl_texture_unref(priv->tex_b);
-      priv->fbo_b = 0;
-      priv->tex_b = 0;
-    }
-
-  /* (Re)create the textures + offscreen buffers.  Downsample by 2.
-   * We can specify mipmapping here, but we don't need it. */
+  /* Downsample by 2. */
   clutter_actor_get_size(CLUTTER_ACTOR(self), &tex_width, &tex_height);
 
   /* if we want blurless desaturation, don't downsample (downsampling
@@ -289,20 +434,13 @@ tidy_blur_group_allocate_textures (TidyBlurGroup *self)
       tex_width  /= 2;
       tex_height /= 2;
     }
+  if (tex_width == priv->tex_width && tex_height == priv->tex_height)
+    return;
 
-  priv->tex_a = cogl_texture_new_with_size(
-            tex_width, tex_height, 0, FALSE /* mipmap */,
-            priv->use_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 :
-                              COGL_PIXEL_FORMAT_RGB_565);
-  cogl_texture_set_filters(priv->tex_a, CGL_NEAREST, CGL_NEAREST);
-  priv->fbo_a = cogl_offscreen_new_to_texture(priv->tex_a);
-
-  priv->tex_b = cogl_texture_new_with_size(
-            tex_width, tex_height, 0, FALSE /* mipmap */,
-            priv->use_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 :
-                              COGL_PIXEL_FORMAT_RGB_565);
-  cogl_texture_set_filters(priv->tex_b, CGL_NEAREST, CGL_NEAREST);
-  priv->fbo_b = cogl_offscreen_new_to_texture(priv->tex_b);
+  /* Free the textures, we'll get new ones when we paint next. */
+  tidy_blur_group_free_textures(self, FALSE);
+  priv->tex_width = tex_width;
+  priv->tex_height = tex_height;
 
   priv->current_blur_step = 0;
   priv->source_changed = TRUE;
@@ -369,6 +507,247 @@ tidy_blur_group_fallback_blur(TidyBlurGroup *group, int tex_width, int tex_heigh
   cogl_blend_func(CGL_SRC_ALPHA, CGL_ONE_MINUS_SRC_ALPHA);
 }
 
+/* Render @src scaled into @dst with a Kawase @shader, which samples
+ * @spread half-texels of @src away. */
+static void
+tidy_blur_group_kawase_pass(TidyBlurGroup *group, ClutterShader *shader,
+                            CoglHandle src, CoglHandle dst, CoglHandle dst_fbo,
+                            float spread)
+{
+  TidyBlurGroupPrivate *priv = group->priv;
+
+  tidy_util_cogl_push_offscreen_buffer(dst_fbo);
+  if (priv->use_shader && shader)
+    {
+      clutter_shader_set_is_enabled (shader, TRUE);
+      clutter_shader_set_uniform_1f (shader, "offx",
+                                 0.5f * spread / cogl_texture_get_width(src));
+      clutter_shader_set_uniform_1f (shader, "offy",
+                                 0.5f * spread / cogl_texture_get_height(src));
+    }
+
+  cogl_texture_rectangle (src, 0, 0,
+                          CLUTTER_INT_TO_FIXED (cogl_texture_get_width(dst)),
+                          CLUTTER_INT_TO_FIXED (cogl_texture_get_height(dst)),
+                          0, 0, CFX_ONE, CFX_ONE);
+
+  if (priv->use_shader && shader)
+    clutter_shader_set_is_enabled (shader, FALSE);
+  tidy_util_cogl_pop_offscreen_buffer();
+}
+
+/* Blur the source in tex_a into tex_b by @priv->blur_step in one go,
+ * going down and up the Kawase chain. */
+static void
+tidy_blur_group_kawase_blur(TidyBlurGroup *group)
+{
+  static const ClutterColor white = { 0xff, 0xff, 0xff, 0xff };
+  TidyBlurGroupPrivate *priv = group->priv;
+  CoglHandle src;
+  gint levels, i;
+  float radius, spread;
+
+  /* blur_step rounds of the blur shader make a gaussian of about
+   * sqrt(blur_step/2) texels radius, and every level of the chain
+   * doubles ours.  Make up for the rest by sampling further. */
+  radius = sqrtf(2 * priv->blur_step);
+  for (levels = 1; levels < priv->kawase_levels && (1 << levels) < radius;
+       levels++)
+    /* find the shortest chain */;
+  spread = CLAMP(radius / (1 << (levels-1)), 1, 3);
+
+  cogl_blend_func(CGL_ONE, CGL_ZERO);
+  cogl_color (&white);
+  cogl_texture_set_filters(priv->tex_a, CGL_LINEAR, CGL_LINEAR);
+
+  src = priv->tex_a;
+  for (i = 0; i < levels; i++)
+    {
+      tidy_blur_group_kawase_pass(group, priv->shader_kawase_down, src,
+                                  priv->kawase_tex[i], priv->kawase_fbo[i],
+                                  spread);
+      src = priv->kawase_tex[i];
+    }
+  for (i = levels-1; i >= 0; i--)
+    {
+      if (i > 0)
+        tidy_blur_group_kawase_pass(group, priv->shader_kawase_up, src,
+                                  priv->kawase_tex[i-1], priv->kawase_fbo[i-1],
+                                  spread);
+      else
+        tidy_blur_group_kawase_pass(group, priv->shader_kawase_up, src,
+                                  priv->tex_b, priv->fbo_b, spread);
+      src = i > 0 ? priv->kawase_tex[i-1] : priv->tex_b;
+    }
+
+  cogl_texture_set_filters(priv->tex_a, CGL_NEAREST, CGL_NEAREST);
+  cogl_blend_func(CGL_SRC_ALPHA, CGL_ONE_MINUS_SRC_ALPHA);
+
+  /* Unlike the steps we leave the source in tex_a intact. */
+  priv->current_is_a = FALSE;
+}
+
+/* Recursively fold the stacking order and visibility of this actor and
+ * its children into *hashp.  Adding, removing, restacking, showing and
+ * hiding actors don't always notify us, but they change this. */
+static void
+recursive_hash_stacking(ClutterActor *actor, guint *hashp)
+{
+  *hashp = *hashp * 33 + GPOINTER_TO_UINT(actor)
+    + CLUTTER_ACTOR_IS_VISIBLE(actor);
+  if (CLUTTER_IS_CONTAINER(actor))
+    {
+      clutter_container_foreach(CLUTTER_CONTAINER(actor),
+                                (ClutterCallback)recursive_hash_stacking,
+                                hashp);
+      /* end of the container */
+      *hashp = *hashp * 33 + 1;
+    }
+}
+
+/* Whether the children have changed since we last rendered them,
+ * so what we have blurred can't be reused. */
+static gboolean
+tidy_blur_group_source_dirty(TidyBlurGroup *group)
+{
+  TidyBlurGroupPrivate *priv = group->priv;
+  guint stacking;
+
+  stacking = 0;
+  clutter_container_foreach(CLUTTER_CONTAINER(group),
+                            (ClutterCallback)recursive_hash_stacking,
+                            &stacking);
+  if (stacking != priv->blurred_stacking)
+    {
+      priv->blurred_stacking = stacking;
+      priv->source_generation++;
+    }
+
+  return priv->source_changed
+    || priv->source_generation != priv->blurred_generation;
+}
+
+/* Blur @pixels by @sigma on the CPU into @priv->tex_cpu. */
+static void
+tidy_blur_group_cpu_blur_pixels(TidyBlurGroup *group, const guchar *pixels,
+                                gint width, gint height, gint rowstride,
+                                float sigma)
+{
+  TidyBlurGroupPrivate *priv = group->priv;
+  gint factor, w, h;
+  guchar *small;
+
+  for (factor = 1; factor < CPU_BLUR_MAX_SHRINK
+       && sigma / (factor*2) >= CPU_BLUR_MIN_SIGMA; factor *= 2)
+    /* shrink as much as we can */;
+  w = width / factor;
+  h = height / factor;
+  if (!w || !h)
+    return;
+
+  small = g_malloc(w * h * 4);
+  hd_cpu_blur_shrink(pixels, width, height, rowstride, factor, small);
+  hd_cpu_blur(small, w, h, hd_cpu_blur_radius(sigma / factor),
+              hd_disable_threads() ? 1 : g_get_num_processors());
+
+  if (priv->tex_cpu && (cogl_texture_get_width(priv->tex_cpu) != w
+                        || cogl_texture_get_height(priv->tex_cpu) != h))
+    {
+      tidy_texture_accounting_remove(priv->tex_cpu);
+      cogl_texture_unref(priv->tex_cpu);
+      priv->tex_cpu = 0;
+    }
+  if (priv->tex_cpu)
+    cogl_texture_set_region(priv->tex_cpu, 0, 0, 0, 0, w, h, w, h,
+                            COGL_PIXEL_FORMAT_RGBA_8888, w * 4, small);
+  else
+    {
+      priv->tex_cpu = cogl_texture_new_from_data(w, h, 0, FALSE,
+                                                 COGL_PIXEL_FORMAT_RGBA_8888,
+                                                 COGL_PIXEL_FORMAT_RGBA_8888,
+                                                 w * 4, small);
+      tidy_texture_accounting_add(priv->tex_cpu, "blur-group",
+                                  priv->tex_cpu);
+    }
+  g_free(small);
+
+  priv->cpu_blurred = priv->tex_cpu != 0;
+}
+
+/* Read back the source from tex_a and blur it by @priv->blur_step. */
+static void
+tidy_blur_group_cpu_blur_texture(TidyBlurGroup *group,
+                                 gint tex_width, gint tex_height)
+{
+  TidyBlurGroupPrivate *priv = group->priv;
+  guchar *pixels;
+
+  pixels = g_malloc(tex_width * tex_height * 4);
+  if (cogl_texture_get_data(priv->tex_a, COGL_PIXEL_FORMAT_RGBA_8888,
+                            tex_width * 4, pixels))
+    /* blur_step rounds of the blur shader make about this much */
+    tidy_blur_group_cpu_blur_pixels(group, pixels, tex_width, tex_height,
+                                    tex_width * 4,
+                                    sqrtf(priv->blur_step / 2.0f));
+  g_free(pixels);
+}
+
+#ifdef __i386__
+/* Without offscreen buffers read back what we've just painted from
+ * the screen, blur it and paint it over.  Only if we aren't rotated
+ * or anything, so the actor is a rectangle on the screen.  Returns
+ * whether it's painted anything. */
+static gboolean
+tidy_blur_group_cpu_blur_screen(TidyBlurGroup *group, gint width, gint height)
+{
+  TidyBlurGroupPrivate *priv = group->priv;
+  ClutterColor col = { 0xff, 0xff, 0xff, 0xff };
+  ClutterVertex verts[4];
+  gint x, y, w, h;
+
+  clutter_actor_get_abs_allocation_vertices(CLUTTER_ACTOR(group), verts);
+  x = CLUTTER_UNITS_TO_DEVICE(verts[0].x);
+  y = CLUTTER_UNITS_TO_DEVICE(verts[0].y);
+  w = CLUTTER_UNITS_TO_DEVICE(verts[1].x) - x;
+  h = CLUTTER_UNITS_TO_DEVICE(verts[2].y) - y;
+  if (verts[0].y != verts[1].y || verts[0].x != verts[2].x
+      || w <= 0 || h <= 0)
+    return FALSE;
+
+  if (!priv->tex_cpu || tidy_blur_group_source_dirty(group)
+      || priv->current_blur_step != priv->blur_step)
+    {
+      guchar *pixels;
+      guint stage_height;
+
+      stage_height = clutter_actor_get_height(clutter_stage_get_default());
+      pixels = g_malloc(w * h * 4);
+      glReadPixels(x, stage_height - y - h, w, h,
+                   GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+      /* Twice as much as in tex_a, which is half-size. */
+      tidy_blur_group_cpu_blur_pixels(group, pixels, w, h, w * 4,
+                                      2 * sqrtf(priv->blur_step / 2.0f));
+      g_free(pixels);
+
+      priv->source_changed = FALSE;
+      priv->blurred_generation = priv->source_generation;
+      priv->current_blur_step = priv->blur_step;
+    }
+  if (!priv->tex_cpu)
+    return FALSE;
+
+  /* The rows we read are bottom-up. */
+  col.alpha = clutter_actor_get_paint_opacity(CLUTTER_ACTOR(group));
+  cogl_color(&col);
+  cogl_texture_set_filters(priv->tex_cpu, CGL_LINEAR, CGL_LINEAR);
+  cogl_texture_rectangle(priv->tex_cpu, 0, 0,
+                         CLUTTER_INT_TO_FIXED(width),
+                         CLUTTER_INT_TO_FIXED(height),
+                         0, CFX_ONE, CFX_ONE, 0);
+  return TRUE;
+}
+#endif
+
 /* If priv->chequer, draw a chequer pattern over the screen */
 static void
 tidy_blur_group_do_chequer(TidyBlurGroup *group, guint width, guint height)
@@ -449,6 +828,9 @@ tidy_blur_group_paint (ClutterActor *actor)
   if (!TIDY_IS_SANE_BLUR_GROUP(actor))
     return;
 
+  if (priv->mode_changed)
+    tidy_blur_group_read_mode(container);
+
   clutter_actor_get_allocation_box(actor, &box);
   width  = CLUTTER_UNITS_TO_DEVICE(box.x2 - box.x1);
   height = CLUTTER_UNITS_TO_DEVICE(box.y2 - box.y1);
@@ -458,9 +840,11 @@ tidy_blur_group_paint (ClutterActor *actor)
   if (!tidy_blur_group_source_buffered(actor) ||
       !tidy_blur_group_children_visible(group))
     {
-      /* set our buffer as damaged, so next time it gets re-created */
+      /* Keep what we've blurred, we'll only re-create it next time
+       * if the children change in the meantime or someone else takes
+       * our buffers. */
       priv->current_blur_step = 0;
-      priv->source_changed = TRUE;
+      tidy_blur_group_free_textures(container, TRUE);
       /* render direct */
       CLUTTER_ACTOR_CLASS(tidy_blur_group_parent_class)->paint(actor);
       tidy_blur_group_do_chequer(container, width, height);
@@ -472,6 +856,8 @@ tidy_blur_group_paint (ClutterActor *actor)
     { /* If we can't blur properly do something nicer instead :) */
       /* Otherwise crash... */
       CLUTTER_ACTOR_CLASS(tidy_blur_group_parent_class)->paint(actor);
+      if (priv->cpu_blur && priv->blur_step > 0)
+        tidy_blur_group_cpu_blur_screen(container, width, height);
       col.blue = priv->brightness * 255;
       col.red = col.green = priv->brightness * 127;
       col.alpha = (1-priv->saturation) * 255;
@@ -482,6 +868,13 @@ tidy_blur_group_paint (ClutterActor *actor)
     }
 #endif
 
+  tidy_blur_group_get_textures(container);
+  if (!priv->fbo_a)
+    {
+      CLUTTER_ACTOR_CLASS(tidy_blur_group_parent_class)->paint(actor);
+      return;
+    }
+
   tex_width  = cogl_texture_get_width(priv->tex_a);
   tex_height = cogl_texture_get_height(priv->tex_a);
 
@@ -497,6 +890,9 @@ tidy_blur_group_paint (ClutterActor *actor)
       priv->current_blur_step = 0;
     }
 
+  if (tidy_blur_group_source_dirty(container))
+    priv->source_changed = TRUE;
+
   /* Draw children into an offscreen buffer */
   if (priv->source_changed && priv->current_blur_step==0)
     {
@@ -531,9 +927,11 @@ tidy_blur_group_paint (ClutterActor *actor)
       cogl_pop_matrix();
 
       priv->source_changed = FALSE;
+      priv->blurred_generation = priv->source_generation;
       priv->current_blur_step = 0;
       priv->max_blur_step = 0;
       priv->current_is_a = TRUE;
+      priv->cpu_blurred = FALSE;
       //g_debug("Rendered buffer");
       steps_this_frame++;
     }
@@ -541,6 +939,34 @@ tidy_blur_group_paint (ClutterActor *actor)
     /* Progressing the animation doesn't play well with rotation. */
     goto skip_progress;
 
+  /* What we have is blurred max_blur_step already (either we're fading
+   * it or we've kept it from the last time), don't blur it any more
+   * until we need more than that. */
+  if (priv->current_blur_step < priv->max_blur_step)
+    priv->current_blur_step = MIN(priv->max_blur_step, priv->blur_step);
+
+  if (priv->kawase && priv->kawase_levels)
+    {
+      if (priv->current_blur_step < priv->blur_step)
+        {
+          tidy_blur_group_kawase_blur(container);
+          priv->current_blur_step = priv->blur_step;
+          priv->max_blur_step = priv->blur_step;
+        }
+    }
+  else if (priv->cpu_blur && !priv->use_shader)
+    {
+      if (priv->current_blur_step < priv->blur_step)
+        {
+          tidy_blur_group_cpu_blur_texture(container, tex_width, tex_height);
+          if (priv->cpu_blurred)
+            {
+              priv->current_blur_step = priv->blur_step;
+              priv->max_blur_step = priv->blur_step;
+            }
+        }
+    }
+
   while (priv->current_blur_step < priv->blur_step &&
          steps_this_frame<MAX_STEPS_PER_FRAME)
     {
@@ -589,9 +1015,8 @@ tidy_blur_group_paint (ClutterActor *actor)
       steps_this_frame++;
       priv->max_blur_step = priv->current_blur_step;
       priv->current_is_a = !priv->current_is_a;
-      /* We've destroyed our source image, so next time we've zoomed out we
-       * need to re-create it */
-      priv->source_changed = TRUE;
+      /* We've destroyed our source image, but we keep what we've blurred
+       * it to as long as the children don't change. */
     }
 
 skip_progress:
@@ -713,7 +1138,10 @@ skip_progress:
 
   /* Set the blur texture to linear interpolation - so we draw it smoothly
    * Onto the screen */
-  current_tex = priv->current_is_a ? priv->tex_a : priv->tex_b;
+  if (priv->cpu_blurred)
+    current_tex = priv->tex_cpu;
+  else
+    current_tex = priv->current_is_a ? priv->tex_a : priv->tex_b;
   cogl_texture_set_filters(current_tex, CGL_LINEAR, CGL_LINEAR);
 
   if ((priv->zoom >= 1) || !priv->use_mirror)
@@ -849,23 +1277,23 @@ tidy_blur_group_dispose (GObject *gobject)
 {
   TidyBlurGroup *container = TIDY_BLUR_GROUP(gobject);
   TidyBlurGroupPrivate *priv = container->priv;
+  gint i;
 
-  if (priv->fbo_a)
-    {
-      cogl_offscreen_unref(priv->fbo_a);
-      cogl_texture_unref(priv->tex_a);
-      priv->fbo_a = 0;
-      priv->tex_a = 0;
-    }
-  if (priv->fbo_b)
+  hd_transition_ini_changed_disconnect(tidy_blur_group_ini_changed, container);
+  tidy_blur_group_free_textures(container, FALSE);
+  tidy_fbo_pool_forget(&priv->tex_a, &priv->fbo_a);
+  tidy_fbo_pool_forget(&priv->tex_b, &priv->fbo_b);
+  for (i = 0; i < KAWASE_LEVELS; i++)
+    tidy_fbo_pool_forget(&priv->kawase_tex[i], &priv->kawase_fbo[i]);
+  if (priv->tex_cpu)
     {
-      cogl_offscreen_unref(priv->fbo_b);
-      cogl_texture_unref(priv->tex_b);
-      priv->fbo_b = 0;
-      priv->tex_b = 0;
+      tidy_texture_accounting_remove(priv->tex_cpu);
+      cogl_texture_unref(priv->tex_cpu);
+      priv->tex_cpu = 0;
     }
   if (priv->tex_chequer)
     {
+      tidy_texture_accounting_remove(priv->tex_chequer);
       cogl_texture_unref(priv->tex_chequer);
       priv->tex_chequer = 0;
     }
@@ -906,6 +1334,8 @@ tidy_blur_group_init (TidyBlurGroup *self)
   priv->source_changed = TRUE;
   priv->tweaks_blurless = hd_transition_get_int("thp_tweaks", "blurless", 0);
   priv->blurless_saturation = hd_transition_get_double("thp_tweaks", "blurless_saturation", 0);
+  priv->cpu_blur = !priv->tweaks_blurless
+    && hd_transition_get_int("blur", "cpu", 1);
 
 #if CLUTTER_COGL_HAS_GLES
   priv->use_shader = cogl_features_available(COGL_FEATURE_SHADERS_GLSL);
@@ -919,6 +1349,8 @@ tidy_blur_group_init (TidyBlurGroup *self)
   priv->fbo_a = 0;
   priv->tex_b = 0;
   priv->fbo_b = 0;
+  priv->tex_width = 0;
+  priv->tex_height = 0;
   priv->current_is_a = TRUE;
   priv->current_is_rotated = FALSE;
   /* dimming for the vignette */
@@ -948,6 +1380,8 @@ tidy_blur_group_init (TidyBlurGroup *self)
       COGL_PIXEL_FORMAT_A_8,
       CHEQUER_SIZE,
       dither_data);
+  tidy_texture_accounting_add(priv->tex_chequer, "blur-group",
+                              priv->tex_chequer);
 
   if (priv->tweaks_blurless)
     {
@@ -962,6 +1396,8 @@ tidy_blur_group_init (TidyBlurGroup *self)
 
   tidy_blur_group_check_shader(self, &priv->shader_saturate,
                                SATURATE_FRAGMENT_SHADER, 0);
+  tidy_blur_group_read_mode(self);
+  hd_transition_ini_changed_connect(tidy_blur_group_ini_changed, self);
 
   g_signal_connect(self, "notify::allocation",
                    G_CALLBACK(tidy_blur_group_allocate_textures), NULL);
@@ -1172,7 +1608,7 @@ void tidy_blur_group_set_source_changed(ClutterActor *blur_group)
     return;
 
   priv = TIDY_BLUR_GROUP(blur_group)->priv;
-  priv->source_changed = TRUE;
+  priv->source_generation++;
   /* This will actually force a redraw */
   priv->current_blur_step = 0;
   clutter_actor_queue_redraw(blur_group);
@@ -1182,7 +1618,7 @@ void tidy_blur_group_set_source_changed(ClutterActor *blur_group)
  * tidy_blur_group_hint_source_changed:
  *
  * Notifies the blur group that it needs to update next time it becomes
- * unblurred.
+ * unblurred.  Until then it keeps what it has blurred.
  */
 void tidy_blur_group_hint_source_changed(ClutterActor *blur_group)
 {
@@ -1192,7 +1628,7 @@ void tidy_blur_group_hint_source_changed(ClutterActor *blur_group)
     return;
 
   priv = TIDY_BLUR_GROUP(blur_group)->priv;
-  priv->source_changed = TRUE;
+  priv->source_generation++;
 }
 
 void tidy_blur_group_stop_progressing(ClutterActor *blur_group)
@@ -6,6 +6,8 @@
 
 #include "tidy-cached-group.h"
 #include "tidy-util.h"
+#include "tidy-fbo-pool.h"
+#include "tidy-dirty-rects.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -17,6 +19,7 @@
 
 #include <string.h>
 #include <locale.h>
+#include <math.h>
 
 #define TIDY_CACHED_GROUP_DEFAULT_DOWNSAMPLING  2.0
 
@@ -25,6 +28,8 @@ struct _TidyCachedGroupPrivate
   /* Internal TidyCachedGroup stuff */
   CoglHandle tex;
   CoglHandle fbo;
+  /* The size of tex, even while we've put it back to the pool */
+  int tex_width, tex_height;
   /* When we rendered to this texture, did we render rotated? */
   gboolean rotated;
 
@@ -34,6 +39,16 @@ struct _TidyCachedGroupPrivate
   float cache_amount;
   /* if anything changed we need to recalculate preblur */
   gboolean source_changed;
+  /* What has been damaged since we last rendered, in our coordinates,
+   * and whether we can't tell (so all of it).  When we are told to
+   * update we only re-render that much, and only if @refresh_dirty. */
+  TidyDirtyRects dirty;
+  gboolean damaged_all;
+  gboolean refresh_dirty;
+  /* The stacking, visibility and geometry of the children when we last
+   * rendered all of them.  If that has changed the damage doesn't tell
+   * us what to render, since things have moved without any. */
+  guint rendered_stacking;
   /* how much quality loss you can afford when rendering cached texture */
   float downsample;
 };
@@ -43,6 +58,92 @@ G_DEFINE_TYPE_WITH_CODE (TidyCachedGroup,
                          CLUTTER_TYPE_GROUP,
                          G_ADD_PRIVATE (TidyCachedGroup));
 
+/* When our children are modified we don't know which area has changed,
+ * so everything needs to be re-rendered next time.  When it is only us
+ * that has been modified child==NULL */
+static gboolean
+tidy_cached_group_notify_modified_real(ClutterActor *actor,
+                                       ClutterActor *child)
+{
+  if (child != NULL)
+    TIDY_CACHED_GROUP(actor)->priv->damaged_all = TRUE;
+  return TRUE;
+}
+
+/* Fold the stacking order, visibility, geometry and opacity of this
+ * actor and its children into *@hashp. */
+static void
+recursive_hash_stacking(ClutterActor *actor, guint *hashp)
+{
+  ClutterGeometry geo;
+
+  clutter_actor_get_geometry(actor, &geo);
+  *hashp = *hashp * 33 + GPOINTER_TO_UINT(actor)
+    + CLUTTER_ACTOR_IS_VISIBLE(actor);
+  *hashp = *hashp * 33 + geo.x;
+  *hashp = *hashp * 33 + geo.y;
+  *hashp = *hashp * 33 + geo.width;
+  *hashp = *hashp * 33 + geo.height;
+  *hashp = *hashp * 33 + clutter_actor_get_opacity(actor);
+  if (CLUTTER_IS_CONTAINER(actor))
+    {
+      clutter_container_foreach(CLUTTER_CONTAINER(actor),
+                                (ClutterCallback)recursive_hash_stacking,
+                                hashp);
+      /* end of the container */
+      *hashp = *hashp * 33 + 1;
+    }
+}
+
+static guint
+tidy_cached_group_hash_stacking(TidyCachedGroup *group)
+{
+  guint stacking = 0;
+
+  clutter_container_foreach(CLUTTER_CONTAINER(group),
+                            (ClutterCallback)recursive_hash_stacking,
+                            &stacking);
+  return stacking;
+}
+
+/* Scissor the offscreen buffer to @rect (in our coordinates) mapped into
+ * the @tex_width x @tex_height texture, the same way it is mapped when
+ * rendering into it. */
+static void
+tidy_cached_group_scissor(const TidyDirtyRect *rect,
+                          gint width, gint height,
+                          gint tex_width, gint tex_height,
+                          gboolean rotate_90)
+{
+  gfloat x1, y1, x2, y2;
+  gint sx1, sy1, sx2, sy2;
+
+  if (rotate_90)
+    {
+      x1 = (gfloat)(height - rect->y - rect->height) * tex_width / height;
+      x2 = (gfloat)(height - rect->y) * tex_width / height;
+      y1 = (gfloat)rect->x * tex_height / width;
+      y2 = (gfloat)(rect->x + rect->width) * tex_height / width;
+    }
+  else
+    {
+      x1 = (gfloat)rect->x * tex_width / width;
+      x2 = (gfloat)(rect->x + rect->width) * tex_width / width;
+      y1 = (gfloat)rect->y * tex_height / height;
+      y2 = (gfloat)(rect->y + rect->height) * tex_height / height;
+    }
+
+  /* Round outwards, and a texel more for the half-texel offset and
+   * the bilinear filtering. */
+  sx1 = MAX((gint)x1 - 1, 0);
+  sy1 = MAX((gint)y1 - 1, 0);
+  sx2 = MIN((gint)ceilf(x2) + 1, tex_width);
+  sy2 = MIN((gint)ceilf(y2) + 1, tex_height);
+
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(sx1, sy1, MAX(sx2 - sx1, 0), MAX(sy2 - sy1, 0));
+}
+
 /* An implementation for the ClutterGroup::paint() vfunc,
    painting all the child actors: */
 static void
@@ -71,6 +172,8 @@ tidy_cached_group_paint (ClutterActor *actor)
   if (priv->cache_amount < 0.01 ||
       width==0 || height==0)
     {
+      /* Let others use our buffer meanwhile. */
+      tidy_fbo_pool_put(&priv->tex, &priv->fbo, TRUE);
       /* render direct */
       CLUTTER_ACTOR_CLASS (tidy_cached_group_parent_class)->paint(actor);
       return;
@@ -90,37 +193,29 @@ tidy_cached_group_paint (ClutterActor *actor)
   int tex_height = 0;
 
   /* check sizes */
-  if (priv->tex)
-    {
-      tex_width = cogl_texture_get_width(priv->tex);
-      tex_height = cogl_texture_get_height(priv->tex);
-    }
 #if RESIZE_TEXTURE
-  /* free texture if the size is wrong */
-  if (tex_width!=exp_width || tex_height!=exp_height) {
-    if (priv->fbo)
-      {
-        cogl_offscreen_unref(priv->fbo);
-        cogl_texture_unref(priv->tex);
-        priv->fbo = 0;
-        priv->tex = 0;
-      }
-    priv->source_changed = TRUE;
+  /* get a new texture if the size is wrong */
+  if (priv->tex_width!=exp_width || priv->tex_height!=exp_height) {
+    tidy_fbo_pool_put(&priv->tex, &priv->fbo, FALSE);
+    priv->tex_width = priv->tex_height = 0;
   }
 #endif
-  /* create the texture + offscreen buffer if they didn't exist. */
-  if (!priv->tex)
+  if (!priv->tex_width || !priv->tex_height)
     {
-      tex_width = exp_width;
-      tex_height = exp_height;
-
-      priv->tex = cogl_texture_new_with_size(
-                tex_width, tex_height, 0, FALSE /*mipmap*/,
-                priv->use_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 :
-                                  COGL_PIXEL_FORMAT_RGB_565);
-      cogl_texture_set_filters(priv->tex, CGL_NEAREST, CGL_NEAREST);
-      priv->fbo = cogl_offscreen_new_to_texture (priv->tex);
+      priv->tex_width = exp_width;
+      priv->tex_height = exp_height;
     }
+  tex_width = priv->tex_width;
+  tex_height = priv->tex_height;
+
+  /* get the texture + offscreen buffer back from the pool, or new ones
+   * if someone else has had them meanwhile. */
+  if (!priv->tex
+      && !tidy_fbo_pool_get(tex_width, tex_height,
+                            priv->use_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 :
+                                              COGL_PIXEL_FORMAT_RGB_565,
+                            "cached-group", &priv->tex, &priv->fbo))
+    priv->source_changed = TRUE;
   /* It may be that we have resized, but the texture has not.
    * If so, try and keep screen looking 'nice' by rotating so that
    * we don't have a texture that is totally the wrong aspect ratio */
@@ -132,8 +227,9 @@ tidy_cached_group_paint (ClutterActor *actor)
       priv->source_changed = TRUE;
     }
 
-  /* Draw children into an offscreen buffer */
-  if (priv->source_changed)
+  /* Draw children into an offscreen buffer, all of them or only
+   * what's been damaged */
+  if (priv->source_changed || priv->refresh_dirty)
     {
       cogl_push_matrix();
       tidy_util_cogl_push_offscreen_buffer(priv->fbo);
@@ -148,14 +244,36 @@ tidy_cached_group_paint (ClutterActor *actor)
         cogl_scale(CFX_ONE*tex_width/width, CFX_ONE*tex_height/height);
       }
 
-      cogl_paint_init(&bgcol);
-      cogl_color (&white);
-      CLUTTER_ACTOR_CLASS (tidy_cached_group_parent_class)->paint(actor);
+      if (priv->source_changed)
+        {
+          priv->rendered_stacking = tidy_cached_group_hash_stacking(container);
+          cogl_paint_init(&bgcol);
+          cogl_color (&white);
+          CLUTTER_ACTOR_CLASS (tidy_cached_group_parent_class)->paint(actor);
+        }
+      else
+        {
+          guint i;
+
+          for (i = 0; i < priv->dirty.n; i++)
+            {
+              tidy_cached_group_scissor(&priv->dirty.rects[i],
+                                        width, height,
+                                        tex_width, tex_height, rotate_90);
+              cogl_paint_init(&bgcol);
+              cogl_color (&white);
+              CLUTTER_ACTOR_CLASS (tidy_cached_group_parent_class)->paint(actor);
+            }
+          glDisable(GL_SCISSOR_TEST);
+        }
 
       tidy_util_cogl_pop_offscreen_buffer();
       cogl_pop_matrix();
 
       priv->source_changed = FALSE;
+      priv->refresh_dirty = FALSE;
+      priv->damaged_all = FALSE;
+      tidy_dirty_rects_clear(&priv->dirty);
     }
 
   /* Render what we've blurred to the screen */
@@ -202,13 +320,7 @@ tidy_cached_group_dispose (GObject *gobject)
   TidyCachedGroup *container = TIDY_CACHED_GROUP(gobject);
   TidyCachedGroupPrivate *priv = container->priv;
 
-  if (priv->fbo)
-    {
-      cogl_offscreen_unref(priv->fbo);
-      cogl_texture_unref(priv->tex);
-      priv->fbo = 0;
-      priv->tex = 0;
-    }
+  tidy_fbo_pool_forget(&priv->tex, &priv->fbo);
 
   G_OBJECT_CLASS (tidy_cached_group_parent_class)->dispose (gobject);
 }
@@ -223,6 +335,7 @@ tidy_cached_group_class_init (TidyCachedGroupClass *klass)
 
   /* Provide implementations for ClutterActor vfuncs: */
   actor_class->paint = tidy_cached_group_paint;
+  actor_class->notify_modified = tidy_cached_group_notify_modified_real;
 }
 
 static void
@@ -235,9 +348,15 @@ tidy_cached_group_init (TidyCachedGroup *self)
   priv->downsample = TIDY_CACHED_GROUP_DEFAULT_DOWNSAMPLING;
   priv->use_alpha = FALSE;
   priv->source_changed = TRUE;
+  priv->damaged_all = FALSE;
+  priv->refresh_dirty = FALSE;
+  priv->rendered_stacking = 0;
+  tidy_dirty_rects_clear(&priv->dirty);
 
   priv->tex = 0;
   priv->fbo = 0;
+  priv->tex_width = 0;
+  priv->tex_height = 0;
 }
 
 /*
@@ -294,7 +413,10 @@ void tidy_cached_group_set_downsampling_factor(ClutterActor *cached_group,
 }
 
 /**
- * Notifies the group that it needs to update what it has cached
+ * Notifies the group that it needs to update what it has cached.
+ * Only what has been damaged since it was last rendered is rendered
+ * again, if we know what that is and nothing has been moved, shown,
+ * hidden or restacked meanwhile.
  */
 void tidy_cached_group_changed(ClutterActor *cached_group)
 {
@@ -304,7 +426,48 @@ void tidy_cached_group_changed(ClutterActor *cached_group)
     return;
 
   priv = TIDY_CACHED_GROUP(cached_group)->priv;
-  priv->source_changed = TRUE;
+  if (priv->damaged_all
+      || priv->rendered_stacking
+           != tidy_cached_group_hash_stacking(TIDY_CACHED_GROUP(cached_group)))
+    priv->source_changed = TRUE;
+  else if (priv->dirty.n)
+    priv->refresh_dirty = TRUE;
+}
+
+/**
+ * Tells the group that @area of the stage has been damaged, which it
+ * will render again the next time it's told to update.  %NULL @area
+ * means everything.
+ */
+void tidy_cached_group_changed_area(ClutterActor *cached_group,
+                                    const ClutterGeometry *area)
+{
+  TidyCachedGroupPrivate *priv;
+  ClutterUnit x1, y1, x2, y2;
+
+  if (!TIDY_IS_CACHED_GROUP(cached_group))
+    return;
+
+  priv = TIDY_CACHED_GROUP(cached_group)->priv;
+  if (!area
+      || !clutter_actor_transform_stage_point(cached_group,
+                           CLUTTER_UNITS_FROM_INT(area->x),
+                           CLUTTER_UNITS_FROM_INT(area->y),
+                           &x1, &y1)
+      || !clutter_actor_transform_stage_point(cached_group,
+                           CLUTTER_UNITS_FROM_INT(area->x + area->width),
+                           CLUTTER_UNITS_FROM_INT(area->y + area->height),
+                           &x2, &y2))
+    {
+      priv->damaged_all = TRUE;
+      return;
+    }
+
+  tidy_dirty_rects_add(&priv->dirty,
+                       CLUTTER_UNITS_TO_INT(MIN(x1, x2)),
+                       CLUTTER_UNITS_TO_INT(MIN(y1, y2)),
+                       CLUTTER_UNITS_TO_INT(ABS(x2 - x1)) + 1,
+                       CLUTTER_UNITS_TO_INT(ABS(y2 - y1)) + 1);
 }
 
 
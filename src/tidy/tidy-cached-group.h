@@ -38,6 +38,8 @@ void tidy_cached_group_set_render_cache(ClutterActor *cached_group, float amount
 void tidy_cached_group_set_downsampling_factor(ClutterActor *cached_group,
                                                float downsample);
 void tidy_cached_group_changed(ClutterActor *cached_group);
+void tidy_cached_group_changed_area(ClutterActor *cached_group,
+                                    const ClutterGeometry *area);
 
 
 G_END_DECLS
@@ -9,6 +9,7 @@
 
 #include "tidy-desaturation-group.h"
 #include "tidy-util.h"
+#include "tidy-fbo-pool.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -187,29 +188,26 @@ tidy_desaturation_group_allocate_textures (TidyDesaturationGroup *self)
     return;
 #endif
 
-  /* Free the texture. */
-  if (priv->fbo_a)
-    {
-      cogl_offscreen_unref(priv->fbo_a);
-      cogl_texture_unref(priv->tex_a);
-      priv->fbo_a = 0;
-      priv->tex_a = 0;
-    }
-
-  /* (Re)create the texture and offscreen buffer.
-   * We can specify mipmapping here, but we don't need it. */
+  /* (Re)get the texture and offscreen buffer from the pool.  If the
+   * size hasn't changed it's the same one again. */
   clutter_actor_get_size(CLUTTER_ACTOR(self), &tex_width, &tex_height);
-
-  priv->tex_a = cogl_texture_new_with_size(
-            tex_width, tex_height, 0, FALSE /* mipmap */,
-            COGL_PIXEL_FORMAT_RGBA_8888);
-  cogl_texture_set_filters(priv->tex_a, CGL_NEAREST, CGL_NEAREST);
-  priv->fbo_a = cogl_offscreen_new_to_texture(priv->tex_a);
+  tidy_fbo_pool_put(&priv->tex_a, &priv->fbo_a, FALSE);
+  tidy_fbo_pool_get(tex_width, tex_height, COGL_PIXEL_FORMAT_RGBA_8888,
+                    "desaturation-group", &priv->tex_a, &priv->fbo_a);
 
   priv->current_desaturation_step = 0;
   priv->source_changed = TRUE;
 }
 
+/* We're resized, so if we're using the texture we need a new one.
+ * Otherwise _paint() gets one when it needs it. */
+static void
+tidy_desaturation_group_allocation_changed (TidyDesaturationGroup *self)
+{
+  if (self->priv->fbo_a)
+    tidy_desaturation_group_allocate_textures(self);
+}
+
 static gboolean
 tidy_desaturation_group_children_visible(ClutterGroup *group)
 {
@@ -297,9 +295,11 @@ tidy_desaturation_group_paint (ClutterActor *actor)
   if (!tidy_desaturation_group_source_buffered(actor) ||
       !tidy_desaturation_group_children_visible(group))
     {
-      /* set our buffer as damaged, so next time it gets re-created */
+      /* set our buffer as damaged, so next time it gets re-created,
+       * and let others use it meanwhile */
       priv->current_desaturation_step = 0;
       priv->source_changed = TRUE;
+      tidy_fbo_pool_put(&priv->tex_a, &priv->fbo_a, FALSE);
       CLUTTER_ACTOR_CLASS(tidy_desaturation_group_parent_class)->paint(actor);
       return;
     }
@@ -309,6 +309,9 @@ tidy_desaturation_group_paint (ClutterActor *actor)
       return;
 #endif
 
+  if (!priv->fbo_a)
+    tidy_desaturation_group_allocate_textures(container);
+
   tex_width  = cogl_texture_get_width(priv->tex_a);
   tex_height = cogl_texture_get_height(priv->tex_a);
 
@@ -389,13 +392,7 @@ tidy_desaturation_group_dispose (GObject *gobject)
   TidyDesaturationGroup *container = TIDY_DESATURATION_GROUP(gobject);
   TidyDesaturationGroupPrivate *priv = container->priv;
 
-  if (priv->fbo_a)
-    {
-      cogl_offscreen_unref(priv->fbo_a);
-      cogl_texture_unref(priv->tex_a);
-      priv->fbo_a = 0;
-      priv->tex_a = 0;
-    }
+  tidy_fbo_pool_put(&priv->tex_a, &priv->fbo_a, FALSE);
 
   G_OBJECT_CLASS (tidy_desaturation_group_parent_class)->dispose (gobject);
 }
@@ -437,7 +434,8 @@ tidy_desaturation_group_init (TidyDesaturationGroup *self)
                                DESATURATE_SATURATE_FRAGMENT_SHADER, 0);
 
   g_signal_connect(self, "notify::allocation",
-                   G_CALLBACK(tidy_desaturation_group_allocate_textures), NULL);
+                   G_CALLBACK(tidy_desaturation_group_allocation_changed),
+                   NULL);
 }
 
 /*
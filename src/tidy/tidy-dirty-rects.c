@@ -0,0 +1,118 @@
+#include "tidy-dirty-rects.h"
+
+static gsize
+rect_area (const TidyDirtyRect *r)
+{
+  return (gsize)r->width * r->height;
+}
+
+static gboolean
+rect_contains (const TidyDirtyRect *outer, const TidyDirtyRect *inner)
+{
+  return outer->x <= inner->x && outer->y <= inner->y
+    && outer->x + outer->width  >= inner->x + inner->width
+    && outer->y + outer->height >= inner->y + inner->height;
+}
+
+static void
+rect_union (const TidyDirtyRect *a, const TidyDirtyRect *b,
+            TidyDirtyRect *u)
+{
+  gint x2, y2;
+
+  x2 = MAX (a->x + a->width,  b->x + b->width);
+  y2 = MAX (a->y + a->height, b->y + b->height);
+  u->x = MIN (a->x, b->x);
+  u->y = MIN (a->y, b->y);
+  u->width  = x2 - u->x;
+  u->height = y2 - u->y;
+}
+
+static void
+remove_rect (TidyDirtyRects *dirty, guint i)
+{
+  dirty->rects[i] = dirty->rects[--dirty->n];
+}
+
+void
+tidy_dirty_rects_clear (TidyDirtyRects *dirty)
+{
+  dirty->n = 0;
+}
+
+/*
+ * Adds the @width x @height rectangle at @x, @y to @dirty.  If the union
+ * with an existing rectangle costs less to upload than the two apart it's
+ * merged into that, and the result is added again, since it may overlap
+ * more.  When @dirty is full it's merged with whichever rectangle grows
+ * the least.
+ */
+void
+tidy_dirty_rects_add (TidyDirtyRects *dirty,
+                      gint x, gint y, gint width, gint height)
+{
+  TidyDirtyRect r;
+
+  if (width <= 0 || height <= 0)
+    return;
+  r.x = x;
+  r.y = y;
+  r.width = width;
+  r.height = height;
+
+  for (;;)
+    {
+      TidyDirtyRect u, best_u;
+      gssize gain, best_gain;
+      guint i, best;
+
+      best = dirty->n;
+      best_gain = G_MINSSIZE;
+      best_u = r;
+      for (i = 0; i < dirty->n; )
+        {
+          if (rect_contains (&dirty->rects[i], &r))
+            return;
+          if (rect_contains (&r, &dirty->rects[i]))
+            {
+              remove_rect (dirty, i);
+              continue;
+            }
+
+          /* What we'd save by uploading the union only. */
+          rect_union (&dirty->rects[i], &r, &u);
+          gain = (gssize)(rect_area (&dirty->rects[i]) + rect_area (&r)
+                          + TIDY_DIRTY_RECTS_UPLOAD_COST)
+            - (gssize)rect_area (&u);
+          if (gain > best_gain)
+            {
+              best = i;
+              best_gain = gain;
+              best_u = u;
+            }
+          i++;
+        }
+
+      if (best == dirty->n
+          || (best_gain < 0 && dirty->n < TIDY_DIRTY_RECTS_MAX))
+        {
+          dirty->rects[dirty->n++] = r;
+          return;
+        }
+
+      remove_rect (dirty, best);
+      r = best_u;
+    }
+}
+
+/* Returns the number of pixels tidy_mem_texture would upload for @dirty. */
+gsize
+tidy_dirty_rects_area (const TidyDirtyRects *dirty)
+{
+  gsize area;
+  guint i;
+
+  for (area = i = 0; i < dirty->n; i++)
+    area += rect_area (&dirty->rects[i]);
+  return area;
+}
@@ -0,0 +1,31 @@
+#ifndef _TIDY_DIRTY_RECTS
+#define _TIDY_DIRTY_RECTS
+
+#include <glib.h>
+
+/* A small bounded set of rectangles needing to be uploaded to a texture.
+ * Rectangles are only merged if uploading their union is cheaper than
+ * uploading them separately, or if there's no room left. */
+
+#define TIDY_DIRTY_RECTS_MAX 4
+
+/* The fixed cost of an upload besides the pixels, in pixels. */
+#define TIDY_DIRTY_RECTS_UPLOAD_COST 2048
+
+typedef struct
+{
+  gint x, y, width, height;
+} TidyDirtyRect;
+
+typedef struct
+{
+  guint n;
+  TidyDirtyRect rects[TIDY_DIRTY_RECTS_MAX];
+} TidyDirtyRects;
+
+void  tidy_dirty_rects_clear (TidyDirtyRects *dirty);
+void  tidy_dirty_rects_add   (TidyDirtyRects *dirty,
+                              gint x, gint y, gint width, gint height);
+gsize tidy_dirty_rects_area  (const TidyDirtyRects *dirty);
+
+#endif
@@ -0,0 +1,201 @@
+#include "tidy-fbo-pool.h"
+#include "tidy-texture-accounting.h"
+
+/* Free buffers are freed after they've been unused for between one
+ * and two of these (seconds). */
+#define TRIM_INTERVAL 10
+
+/* The pool is only ever used from the main thread. */
+typedef struct {
+  CoglHandle       tex, fbo;
+  guint            width, height;
+  CoglPixelFormat  format;
+  /* Whether someone has got it. */
+  gboolean         busy;
+  /* The @tex variable it was put back from, if its contents are worth
+   * keeping.  If it's got back into the same it's as it was left. */
+  gconstpointer    owner;
+  /* Whether it was free at the last trim already. */
+  gboolean         stale;
+} TidyFboPoolEntry;
+
+static GList *entries;
+static guint trim_timeout;
+
+static void
+free_entry (TidyFboPoolEntry *entry)
+{
+  tidy_texture_accounting_remove (entry->tex);
+  cogl_offscreen_unref (entry->fbo);
+  cogl_texture_unref (entry->tex);
+  g_slice_free (TidyFboPoolEntry, entry);
+}
+
+/* Frees the buffers which have been free since the last time,
+ * and keeps calling us while there are free buffers. */
+static gboolean
+trim_stale (gpointer unused)
+{
+  GList *li, *next;
+  gboolean any_free;
+
+  any_free = FALSE;
+  for (li = entries; li; li = next)
+    {
+      TidyFboPoolEntry *entry = li->data;
+
+      next = li->next;
+      if (entry->busy)
+        continue;
+      if (entry->stale)
+        {
+          free_entry (entry);
+          entries = g_list_delete_link (entries, li);
+        }
+      else
+        {
+          entry->stale = TRUE;
+          any_free = TRUE;
+        }
+    }
+
+  if (!any_free)
+    trim_timeout = 0;
+  return any_free;
+}
+
+/*
+ * Gets a @width x @height buffer of @format, either a free one from the
+ * pool or a new one, and returns it in @tex and @fbo.  Returns whether
+ * it is the buffer which was put back from @tex last and nobody has
+ * had it since, so it has the same contents.
+ */
+gboolean
+tidy_fbo_pool_get (guint width, guint height, CoglPixelFormat format,
+                   const gchar *tag, CoglHandle *tex, CoglHandle *fbo)
+{
+  gconstpointer owner = tex;
+  TidyFboPoolEntry *entry, *found;
+  gboolean intact;
+  GList *li;
+
+  found = NULL;
+  for (li = entries; li; li = li->next)
+    {
+      entry = li->data;
+      if (entry->busy || entry->width != width || entry->height != height
+          || entry->format != format)
+        continue;
+      if (entry->owner == owner)
+        {
+          found = entry;
+          break;
+        }
+      /* Otherwise rather one nobody wants back, and the least
+       * recently used of those. */
+      if (!found || !entry->owner || found->owner)
+        found = entry;
+    }
+
+  if (found)
+    {
+      entry = found;
+      intact = entry->owner == owner;
+    }
+  else
+    {
+      entry = g_slice_new (TidyFboPoolEntry);
+      entry->tex = cogl_texture_new_with_size (width, height, 0,
+                                               FALSE /* mipmap */, format);
+      entry->fbo = cogl_offscreen_new_to_texture (entry->tex);
+      entry->width = width;
+      entry->height = height;
+      entry->format = format;
+      entries = g_list_prepend (entries, entry);
+      intact = FALSE;
+    }
+
+  entry->busy = TRUE;
+  entry->owner = NULL;
+  cogl_texture_set_filters (entry->tex, CGL_NEAREST, CGL_NEAREST);
+  tidy_texture_accounting_add (entry->tex, tag, entry->tex);
+
+  *tex = entry->tex;
+  *fbo = entry->fbo;
+  return intact;
+}
+
+/* Puts back the buffer in @tex and @fbo and clears them.  If @keep,
+ * getting it back into @tex will say it's intact.  Does nothing if
+ * they are already clear. */
+void
+tidy_fbo_pool_put (CoglHandle *tex, CoglHandle *fbo, gboolean keep)
+{
+  TidyFboPoolEntry *entry;
+  GList *li;
+
+  if (!*tex)
+    return;
+
+  for (li = entries; li; li = li->next)
+    {
+      entry = li->data;
+      if (entry->tex != *tex)
+        continue;
+
+      g_assert (entry->busy && entry->fbo == *fbo);
+      entry->busy = FALSE;
+      entry->owner = keep ? tex : NULL;
+      entry->stale = FALSE;
+      tidy_texture_accounting_add (entry->tex, "fbo-pool", entry->tex);
+
+      /* The most recently used first, they are likely to be
+       * asked for again. */
+      entries = g_list_delete_link (entries, li);
+      entries = g_list_prepend (entries, entry);
+
+      if (!trim_timeout)
+        trim_timeout = g_timeout_add_seconds (TRIM_INTERVAL,
+                                              trim_stale, NULL);
+      break;
+    }
+
+  *tex = 0;
+  *fbo = 0;
+}
+
+/* Puts back the buffer in @tex and @fbo like tidy_fbo_pool_put(), and
+ * forgets about any buffer kept for @tex, which is going away. */
+void
+tidy_fbo_pool_forget (CoglHandle *tex, CoglHandle *fbo)
+{
+  GList *li;
+
+  tidy_fbo_pool_put (tex, fbo, FALSE);
+  for (li = entries; li; li = li->next)
+    {
+      TidyFboPoolEntry *entry = li->data;
+
+      if (entry->owner == tex)
+        entry->owner = NULL;
+    }
+}
+
+/* Frees all the buffers which are free right now. */
+void
+tidy_fbo_pool_trim (void)
+{
+  GList *li, *next;
+
+  for (li = entries; li; li = next)
+    {
+      TidyFboPoolEntry *entry = li->data;
+
+      next = li->next;
+      if (!entry->busy)
+        {
+          free_entry (entry);
+          entries = g_list_delete_link (entries, li);
+        }
+    }
+}
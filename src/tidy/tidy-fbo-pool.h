@@ -0,0 +1,23 @@
+#ifndef _TIDY_FBO_POOL
+#define _TIDY_FBO_POOL
+
+#include <clutter/clutter.h>
+#include <cogl/cogl.h>
+
+/* Offscreen buffers shared by the effect groups.  A buffer is a texture
+ * and an offscreen buffer rendering into it, handed out by size and
+ * format into a @tex and @fbo pair of variables.  Groups put their
+ * buffers back when they're not using them, so that others can take
+ * them, and get them back into the same variables with their contents
+ * intact if nobody has.  Buffers nobody takes are freed after a while.
+ * The variables must be tidy_fbo_pool_forget()ed before they go away.
+ * @tag is as for tidy_texture_accounting_add(). */
+gboolean tidy_fbo_pool_get    (guint width, guint height,
+                               CoglPixelFormat format, const gchar *tag,
+                               CoglHandle *tex, CoglHandle *fbo);
+void     tidy_fbo_pool_put    (CoglHandle *tex, CoglHandle *fbo,
+                               gboolean keep);
+void     tidy_fbo_pool_forget (CoglHandle *tex, CoglHandle *fbo);
+void     tidy_fbo_pool_trim   (void);
+
+#endif
@@ -33,6 +33,7 @@
 #include "tidy-scroll-view.h"
 
 #include "util/hd-transition.h"
+#include "util/hd-motion-history.h"
 
 #define TIDY_FINGER_SCROLL_INITIAL_SCROLLBAR_DELAY (2000)
 #define TIDY_FINGER_SCROLL_FADE_SCROLLBAR_IN_TIME (250)
@@ -58,6 +59,8 @@ struct _TidyFingerScrollPrivate
 
   GArray                *motion_buffer;
   guint                  last_motion;
+  /* X time of the last event which went into @motion_buffer. */
+  guint32                last_motion_time;
 
   /* Variables for storing acceleration information for kinetic mode */
   ClutterTimeline       *deceleration_timeline;
@@ -212,12 +215,38 @@ tidy_finger_scroll_class_init (TidyFingerScrollClass *klass)
                                                       G_PARAM_READWRITE));
 }
 
+/* Appends a motion to @priv->motion_buffer, dropping the oldest one
+ * if it's full. */
+static void
+push_motion (TidyFingerScrollPrivate *priv,
+             ClutterUnit x, ClutterUnit y, const GTimeVal *time)
+{
+  TidyFingerScrollMotion *motion;
+
+  priv->last_motion ++;
+  if (priv->last_motion == priv->motion_buffer->len)
+    {
+      priv->motion_buffer = g_array_remove_index (priv->motion_buffer, 0);
+      g_array_set_size (priv->motion_buffer, priv->last_motion);
+      priv->last_motion --;
+    }
+
+  motion = &g_array_index (priv->motion_buffer,
+                           TidyFingerScrollMotion, priv->last_motion);
+  motion->x = x;
+  motion->y = y;
+  motion->time = *time;
+}
+
 static gboolean
 motion_event_cb (ClutterActor *actor,
                  ClutterMotionEvent *event,
                  TidyFingerScroll *scroll)
 {
   ClutterUnit x, y;
+  HdMotionSample history[8];
+  GTimeVal now;
+  guint i, n;
 
   TidyFingerScrollPrivate *priv = scroll->priv;
 
@@ -266,20 +295,29 @@ motion_event_cb (ClutterActor *actor,
             }
         }
 
-      priv->last_motion ++;
-      if (priv->last_motion == priv->motion_buffer->len)
+      /* The motion compressed away since the last event still counts
+       * when estimating the velocity.  Date it back by its X time. */
+      g_get_current_time (&now);
+      n = hd_motion_history_get (priv->last_motion_time, event->time,
+                                 history, MIN (G_N_ELEMENTS (history),
+                                               priv->motion_buffer->len));
+      for (i = 0; i < n; i++)
         {
-          priv->motion_buffer = g_array_remove_index (priv->motion_buffer, 0);
-          g_array_set_size (priv->motion_buffer, priv->last_motion);
-          priv->last_motion --;
+          ClutterUnit hx, hy;
+          GTimeVal time = now;
+
+          if (!clutter_actor_transform_stage_point (actor,
+                                   CLUTTER_UNITS_FROM_DEVICE (history[i].x),
+                                   CLUTTER_UNITS_FROM_DEVICE (history[i].y),
+                                   &hx, &hy))
+            continue;
+          g_time_val_add (&time, -1000 *
+                          (glong)(gint32)(event->time - history[i].time));
+          push_motion (priv, hx, hy, &time);
         }
-
-      motion = &g_array_index (priv->motion_buffer,
-                               TidyFingerScrollMotion, priv->last_motion);
-      motion->x = x;
-      motion->y = y;
-      g_get_current_time (&motion->time);
+      push_motion (priv, x, y, &now);
     }
+  priv->last_motion_time = event->time;
 
   return FALSE;
 }
@@ -796,6 +834,7 @@ captured_event_cb (ClutterActor     *actor,
                                            &motion->x, &motion->y)))
         {
           g_get_current_time (&motion->time);
+          priv->last_motion_time = bevent->time;
 
           /* Save the coordinates of the first touch to be able to determine
            * whether we've exceeded the drag treshold when processing motion
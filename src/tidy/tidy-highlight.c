@@ -7,10 +7,16 @@
 #endif
 
 #include "tidy-highlight.h"
+#include "tidy-fbo-pool.h"
+#include "tidy-util.h"
 #include <clutter/clutter-actor.h>
 
 #include "cogl/cogl.h"
 
+/* The glow is baked for amounts of 0 and powers of two texels up to
+ * 1 << (HIGHLIGHT_GLOW_LEVELS-2), and cross-faded in between. */
+#define HIGHLIGHT_GLOW_LEVELS 7
+
 enum
 {
   PROP_0,
@@ -55,13 +61,28 @@ enum
   "  gl_FragColor = color;\n"
   "}\n";
 
+/* The shader's output for one amount, in white, as big as we are.
+ * It lives in the FBO pool between paints. */
+typedef struct
+{
+  CoglHandle           tex, fbo;
+  /* What it was baked from. */
+  CoglHandle           source;
+  guint                generation;
+} TidyHighlightGlow;
+
 struct _TidyHighlightPrivate
 {
   ClutterTexture      *parent_texture;
   ClutterShader       *shader;
+  gulong               pixbuf_change_id;
 
   float                amount;
   ClutterColor         color;
+
+  TidyHighlightGlow    glows[HIGHLIGHT_GLOW_LEVELS];
+  /* Bumped when the parent texture changes, making the glows stale. */
+  guint                generation;
 };
 
 G_DEFINE_TYPE_WITH_CODE (TidyHighlight,
@@ -140,90 +161,167 @@ tidy_highlight_get_preferred_height (ClutterActor *self,
                                               natural_height_p);
 }
 
+/* How many texels the glow of @level is. */
+static gint
+tidy_highlight_level_amount (gint level)
+{
+  return level ? 1 << (level-1) : 0;
+}
+
+/* Render the glow of @level around the parent texture into @glow,
+ * which is @width x @height like us. */
 static void
-tidy_highlight_paint (ClutterActor *self)
+tidy_highlight_bake (TidyHighlight *self, TidyHighlightGlow *glow,
+                     CoglHandle cogl_texture, gint width, gint height,
+                     gint level)
 {
-  TidyHighlightPrivate  *priv;
-  ClutterActor                *parent_texture;
-  gint                         x_1, y_1, x_2, y_2;
-  ClutterColor                 col = { 0xff, 0xff, 0xff, 0xff };
-  CoglHandle                   cogl_texture;
+  static const ClutterColor    white = { 0xff, 0xff, 0xff, 0xff };
+  static const ClutterColor    transparent = { 0, 0, 0, 0 };
+  TidyHighlightPrivate        *priv = self->priv;
   guint                        tex_width, tex_height;
   ClutterFixed                 overlapx, overlapy;
   CoglTextureVertex            verts[4];
 
-  priv = TIDY_HIGHLIGHT (self)->priv;
-
-  /* no need to paint stuff if we don't have a texture to sub */
-  if (!priv->parent_texture || !priv->shader)
-    return;
-
-  /* parent texture may have been hidden, there for need to make sure its
-   * realised with resources available.
-  */
-  parent_texture = CLUTTER_ACTOR (priv->parent_texture);
-  if (!CLUTTER_ACTOR_IS_REALIZED (parent_texture))
-    clutter_actor_realize (parent_texture);
-
-  col = priv->color;
-  col.alpha = col.alpha * clutter_actor_get_paint_opacity (self) / 256;
-  cogl_color (&col);
-
-  clutter_actor_get_allocation_coords (self, &x_1, &y_1, &x_2, &y_2);
-
-  cogl_texture = clutter_texture_get_cogl_texture (priv->parent_texture);
-
-  if (cogl_texture == COGL_INVALID_HANDLE)
-    return;
-
   tex_width = cogl_texture_get_width (cogl_texture);
   tex_height = cogl_texture_get_height (cogl_texture);
 
-  if (priv->shader)
-    {
-      clutter_shader_set_is_enabled (priv->shader, TRUE);
-      clutter_shader_set_uniform_1f (priv->shader, "blurx",
-                                     priv->amount / tex_width);
-      clutter_shader_set_uniform_1f (priv->shader, "blury",
-                                     priv->amount / tex_height);
-    }
-
+  clutter_shader_set_is_enabled (priv->shader, TRUE);
+  clutter_shader_set_uniform_1f (priv->shader, "blurx",
+                   (float)tidy_highlight_level_amount (level) / tex_width);
+  clutter_shader_set_uniform_1f (priv->shader, "blury",
+                   (float)tidy_highlight_level_amount (level) / tex_height);
 
   /* if we're bigger than the texture, make us 1:1 by just extending
    * our edges outside those of the texture. We have to do this with
    * cogl_texture_polygon not cogl_rectangle, because clutter thinks
    * that we want to repeat rectangles and messes everything up */
   overlapx = CLUTTER_FLOAT_TO_FIXED(
-      ((x_2 - x_1) - tex_width) / (float)(tex_width*2));
+      (width - (gint)tex_width) / (float)(tex_width*2));
   overlapy = CLUTTER_FLOAT_TO_FIXED(
-      ((y_2 - y_1) - tex_height) / (float)(tex_height*2));
+      (height - (gint)tex_height) / (float)(tex_height*2));
 
   verts[0].x = 0;
   verts[0].y = 0;
   verts[0].z = 0;
   verts[0].tx = -overlapx;
   verts[0].ty = -overlapy;
-  verts[1].x = CLUTTER_INT_TO_FIXED (x_2 - x_1);
+  verts[1].x = CLUTTER_INT_TO_FIXED (width);
   verts[1].y = 0;
   verts[1].z = 0;
   verts[1].tx = CFX_ONE+overlapx;
   verts[1].ty = -overlapy;
-  verts[2].x = CLUTTER_INT_TO_FIXED (x_2 - x_1);
-  verts[2].y = CLUTTER_INT_TO_FIXED (y_2 - y_1);
+  verts[2].x = CLUTTER_INT_TO_FIXED (width);
+  verts[2].y = CLUTTER_INT_TO_FIXED (height);
   verts[2].z = 0;
   verts[2].tx = CFX_ONE+overlapx;
   verts[2].ty = CFX_ONE+overlapy;
   verts[3].x = 0;
-  verts[3].y = CLUTTER_INT_TO_FIXED (y_2 - y_1);
+  verts[3].y = CLUTTER_INT_TO_FIXED (height);
   verts[3].z = 0;
   verts[3].tx = -overlapx;
   verts[3].ty = CFX_ONE+overlapy;
 
-  /* Parent paint translated us into position */
+  /* Replace rather than blend, so we get the shader's alpha as it is
+   * and the colour can be applied when painting. */
+  cogl_push_matrix ();
+  tidy_util_cogl_push_offscreen_buffer (glow->fbo);
+  cogl_paint_init (&transparent);
+  cogl_blend_func (CGL_ONE, CGL_ZERO);
+  cogl_color (&white);
   cogl_texture_polygon (cogl_texture, 4, verts, FALSE);
+  cogl_blend_func (CGL_SRC_ALPHA, CGL_ONE_MINUS_SRC_ALPHA);
+  tidy_util_cogl_pop_offscreen_buffer ();
+  cogl_pop_matrix ();
+
+  clutter_shader_set_is_enabled (priv->shader, FALSE);
 
-  if (priv->shader)
-    clutter_shader_set_is_enabled (priv->shader, FALSE);
+  glow->source = cogl_texture;
+  glow->generation = priv->generation;
+}
+
+static void
+tidy_highlight_paint (ClutterActor *self)
+{
+  TidyHighlightPrivate  *priv;
+  ClutterActor                *parent_texture;
+  gint                         x_1, y_1, x_2, y_2;
+  ClutterColor                 col = { 0xff, 0xff, 0xff, 0xff };
+  CoglHandle                   cogl_texture;
+  gint                         level, i;
+  float                        amount, mix;
+
+  priv = TIDY_HIGHLIGHT (self)->priv;
+
+  /* no need to paint stuff if we don't have a texture to sub */
+  if (!priv->parent_texture || !priv->shader)
+    return;
+
+  /* parent texture may have been hidden, there for need to make sure its
+   * realised with resources available.
+  */
+  parent_texture = CLUTTER_ACTOR (priv->parent_texture);
+  if (!CLUTTER_ACTOR_IS_REALIZED (parent_texture))
+    clutter_actor_realize (parent_texture);
+
+  clutter_actor_get_allocation_coords (self, &x_1, &y_1, &x_2, &y_2);
+  if (x_2 <= x_1 || y_2 <= y_1)
+    return;
+
+  cogl_texture = clutter_texture_get_cogl_texture (priv->parent_texture);
+
+  if (cogl_texture == COGL_INVALID_HANDLE)
+    return;
+
+  /* Find the two levels around the amount and how much of the upper
+   * one to mix in. */
+  amount = CLAMP (priv->amount, 0,
+                  tidy_highlight_level_amount (HIGHLIGHT_GLOW_LEVELS-1));
+  for (level = 0; level < HIGHLIGHT_GLOW_LEVELS-2
+       && tidy_highlight_level_amount (level+1) < amount; level++)
+    /* find the level below */;
+  mix = (amount - tidy_highlight_level_amount (level))
+    / (tidy_highlight_level_amount (level+1)
+       - tidy_highlight_level_amount (level));
+
+  for (i = level; i <= level+1; i++)
+    {
+      TidyHighlightGlow *glow = &priv->glows[i];
+      float              opacity = i == level ? 1 - mix : mix;
+
+      if (opacity < 1.0f / 256)
+        continue;
+
+      /* Get the glow for this level back from the pool, and only run
+       * the shader if it's not what we left there. */
+      if (!tidy_fbo_pool_get (x_2 - x_1, y_2 - y_1,
+                              COGL_PIXEL_FORMAT_RGBA_8888,
+                              "highlight", &glow->tex, &glow->fbo)
+          || glow->source != cogl_texture
+          || glow->generation != priv->generation)
+        tidy_highlight_bake (TIDY_HIGHLIGHT (self), glow, cogl_texture,
+                             x_2 - x_1, y_2 - y_1, i);
+
+      col = priv->color;
+      col.alpha = col.alpha * clutter_actor_get_paint_opacity (self)
+        * opacity / 256;
+      cogl_color (&col);
+
+      /* Parent paint translated us into position */
+      cogl_texture_set_filters (glow->tex, CGL_LINEAR, CGL_LINEAR);
+      cogl_texture_rectangle (glow->tex, 0, 0,
+                              CLUTTER_INT_TO_FIXED (x_2 - x_1),
+                              CLUTTER_INT_TO_FIXED (y_2 - y_1),
+                              0, 0, CFX_ONE, CFX_ONE);
+
+      tidy_fbo_pool_put (&glow->tex, &glow->fbo, TRUE);
+    }
+}
+
+static void
+tidy_highlight_parent_changed (ClutterTexture *texture, TidyHighlight *self)
+{
+  self->priv->generation++;
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (self));
 }
 
 static void
@@ -236,8 +334,11 @@ set_parent_texture (TidyHighlight *ctexture,
 
   if (priv->parent_texture)
     {
+      g_signal_handler_disconnect (priv->parent_texture,
+                                   priv->pixbuf_change_id);
       g_object_unref (priv->parent_texture);
       priv->parent_texture = NULL;
+      priv->generation++;
 
       if (was_visible)
         clutter_actor_hide (actor);
@@ -246,6 +347,10 @@ set_parent_texture (TidyHighlight *ctexture,
   if (texture)
     {
       priv->parent_texture = g_object_ref (texture);
+      priv->pixbuf_change_id =
+        g_signal_connect (texture, "pixbuf-change",
+                          G_CALLBACK (tidy_highlight_parent_changed),
+                          ctexture);
 
       /* queue a redraw if the subd texture is already visible */
       if (CLUTTER_ACTOR_IS_VISIBLE (priv->parent_texture) &&
@@ -265,11 +370,18 @@ tidy_highlight_dispose (GObject *object)
 {
   TidyHighlight         *self = TIDY_HIGHLIGHT(object);
   TidyHighlightPrivate  *priv = self->priv;
+  gint                   i;
 
   if (priv->parent_texture)
-    g_object_unref (priv->parent_texture);
+    {
+      g_signal_handler_disconnect (priv->parent_texture,
+                                   priv->pixbuf_change_id);
+      g_object_unref (priv->parent_texture);
+    }
 
   priv->parent_texture = NULL;
+  for (i = 0; i < HIGHLIGHT_GLOW_LEVELS; i++)
+    tidy_fbo_pool_forget (&priv->glows[i].tex, &priv->glows[i].fbo);
   /* TODO: handle disposal of cached shader? */
 
   G_OBJECT_CLASS (tidy_highlight_parent_class)->dispose (object);
@@ -358,6 +470,7 @@ tidy_highlight_init (TidyHighlight *self)
   priv->parent_texture = NULL;
   priv->amount = 0;
   priv->color = white;
+  priv->generation = 1;
 
 #if CLUTTER_COGL_HAS_GLES
   /* We can't use shaders on x86/GL because they're different (and Xephyr
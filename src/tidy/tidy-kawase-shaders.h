@@ -0,0 +1,44 @@
+#ifndef _TIDY_KAWASE_SHADERS
+#define _TIDY_KAWASE_SHADERS
+
+/* The fragment shaders of TidyBlurGroup's dual Kawase blur, kept apart
+ * so that tests/test-kawase.c can run them too. */
+
+/* Dual Kawase downsampling: the middle and the four diagonal neighbours
+ * at offset * half a texel of the bigger source texture. */
+#define TIDY_KAWASE_DOWN_FRAGMENT_SHADER \
+"precision lowp float;\n" \
+"varying mediump vec2  tex_coord;\n" \
+"uniform lowp sampler2D tex;\n" \
+"uniform mediump float offx;\n" \
+"uniform mediump float offy;\n" \
+"void main () {\n" \
+"  lowp vec4 color = texture2D (tex, tex_coord) * 0.5;\n" \
+"  color += texture2D (tex, tex_coord + vec2(-offx, -offy)) * 0.125;\n" \
+"  color += texture2D (tex, tex_coord + vec2( offx,  offy)) * 0.125;\n" \
+"  color += texture2D (tex, tex_coord + vec2( offx, -offy)) * 0.125;\n" \
+"  color += texture2D (tex, tex_coord + vec2(-offx,  offy)) * 0.125;\n" \
+"  gl_FragColor = color;\n" \
+"}\n"
+
+/* ...and upsampling: a ring of eight samples around the pixel. */
+#define TIDY_KAWASE_UP_FRAGMENT_SHADER \
+"precision lowp float;\n" \
+"varying mediump vec2  tex_coord;\n" \
+"uniform lowp sampler2D tex;\n" \
+"uniform mediump float offx;\n" \
+"uniform mediump float offy;\n" \
+"void main () {\n" \
+"  lowp vec4 color = \n" \
+"       texture2D (tex, tex_coord + vec2(-offx*2.0, 0.0)) * 0.0833 + \n" \
+"       texture2D (tex, tex_coord + vec2( offx*2.0, 0.0)) * 0.0833 + \n" \
+"       texture2D (tex, tex_coord + vec2(0.0, -offy*2.0)) * 0.0833 + \n" \
+"       texture2D (tex, tex_coord + vec2(0.0,  offy*2.0)) * 0.0833 + \n" \
+"       texture2D (tex, tex_coord + vec2(-offx, -offy)) * 0.1667 + \n" \
+"       texture2D (tex, tex_coord + vec2( offx, -offy)) * 0.1667 + \n" \
+"       texture2D (tex, tex_coord + vec2(-offx,  offy)) * 0.1667 + \n" \
+"       texture2D (tex, tex_coord + vec2( offx,  offy)) * 0.1667; \n" \
+"  gl_FragColor = color;\n" \
+"}\n"
+
+#endif
@@ -8,6 +8,8 @@
 #endif
 
 #include "tidy-mem-texture.h"
+#include "tidy-texture-accounting.h"
+#include "tidy-dirty-rects.h"
 #include <clutter/clutter-actor.h>
 
 #include <string.h>
@@ -29,7 +31,7 @@
 typedef struct _TidyMemTextureTile
 {
   ClutterGeometry pos; /* actual position in texture */
-  ClutterGeometry modified; /* geometry for the area modified */
+  TidyDirtyRects modified; /* areas modified, relative to pos */
   CoglHandle texture;
 } TidyMemTextureTile;
 
@@ -116,7 +118,7 @@ tidy_mem_texture_paint (ClutterActor *self)
       if (tidy_mem_texture_tile_visible(texture, tile, width, height))
         {
           /* we're visible, so update if modified, and render... */
-          if (tile->modified.width>0 && tile->modified.height>0)
+          if (tile->modified.n)
             tidy_mem_texture_update_modified(texture, tile);
         }
     }
@@ -217,6 +219,7 @@ tidy_mem_texture_free_data(TidyMemTexture *texture)
   while (priv->tiles)
     {
       TidyMemTextureTile *tile = priv->tiles->data;
+      tidy_texture_accounting_remove(tile->texture);
       cogl_texture_unref(tile->texture);
       g_free(tile);
       priv->tiles = priv->tiles->next;
@@ -269,56 +272,59 @@ tidy_mem_texture_tile_visible(TidyMemTexture *texture,
           y1 <= CLUTTER_INT_TO_FIXED(height));
 }
 
-/* Copies the pixels into a buffer with the correct row stride so
- * we can get the data into OpenGL quickly. */
+/* Uploads the modified areas of @tile one by one.  Copies the pixels
+ * into a buffer with the correct row stride if we have to, so we can
+ * get the data into OpenGL quickly. */
 static void
 tidy_mem_texture_update_modified(TidyMemTexture *texture,
                                   TidyMemTextureTile *tile)
 {
   TidyMemTexturePrivate *priv = texture->priv;
   gint rowstride = priv->texture_width * priv->texture_bpp;
+  guint i;
+
+  for (i = 0; i < tile->modified.n; i++)
+    {
+      const TidyDirtyRect *mod = &tile->modified.rects[i];
 #if EXACT_ROW_LENGTH
-  gint y;
-  gint rowlength = tile->modified.width * priv->texture_bpp;
-  guchar *ptr_dst = priv->tile_buffer;
+      gint y;
+      gint rowlength = mod->width * priv->texture_bpp;
+      guchar *ptr_dst = priv->tile_buffer;
 #endif
-  const guchar *ptr_src = &priv->texture_ptr[
-                 (tile->pos.x + tile->modified.x +
-                 (tile->pos.y + tile->modified.y)*priv->texture_width) *
-                 priv->texture_bpp];
+      const guchar *ptr_src = &priv->texture_ptr[
+                     (tile->pos.x + mod->x +
+                     (tile->pos.y + mod->y)*priv->texture_width) *
+                     priv->texture_bpp];
 
 #if EXACT_ROW_LENGTH
-  for (y=0;y<tile->modified.height;y++)
-    {
-      memcpy(ptr_dst, ptr_src, rowlength);
-      ptr_src += rowstride;
-      ptr_dst += rowlength;
-    }
+      for (y=0;y<mod->height;y++)
+        {
+          memcpy(ptr_dst, ptr_src, rowlength);
+          ptr_src += rowstride;
+          ptr_dst += rowlength;
+        }
 
-  cogl_texture_set_region(tile->texture,
-                          0, 0,
-                          tile->modified.x, tile->modified.y,
-                          tile->modified.width, tile->modified.height,
-                          tile->modified.width, tile->modified.height,
-                          priv->texture_format,
-                          tile->modified.width * priv->texture_bpp,
-                          priv->tile_buffer);
+      cogl_texture_set_region(tile->texture,
+                              0, 0,
+                              mod->x, mod->y,
+                              mod->width, mod->height,
+                              mod->width, mod->height,
+                              priv->texture_format,
+                              mod->width * priv->texture_bpp,
+                              priv->tile_buffer);
 #else
-  cogl_texture_set_region(tile->texture,
-                            0, 0,
-                            tile->modified.x, tile->modified.y,
-                            tile->modified.width, tile->modified.height,
-                            tile->modified.width, tile->modified.height,
-                            priv->texture_format,
-                            rowstride,
-                            ptr_src);
+      cogl_texture_set_region(tile->texture,
+                              0, 0,
+                              mod->x, mod->y,
+                              mod->width, mod->height,
+                              mod->width, mod->height,
+                              priv->texture_format,
+                              rowstride,
+                              ptr_src);
 #endif
+    }
 
-  /* set modified area to 0 */
-  tile->modified.x = 0;
-  tile->modified.y = 0;
-  tile->modified.width = 0;
-  tile->modified.height = 0;
+  tidy_dirty_rects_clear(&tile->modified);
 }
 
 void tidy_mem_texture_set_data(TidyMemTexture *texture,
@@ -384,11 +390,12 @@ void tidy_mem_texture_set_data(TidyMemTexture *texture,
             tile->texture = cogl_texture_new_with_size(
                 tile->pos.width, tile->pos.height, -1 /* no waste */,
                 FALSE, priv->texture_format);
+            tidy_texture_accounting_add(tile->texture, "mem-texture",
+                                        tile->texture);
             /* set whole area to be modified */
-            tile->modified.x = 0;
-            tile->modified.y = 0;
-            tile->modified.width = tile->pos.width;
-            tile->modified.height = tile->pos.height;
+            tidy_dirty_rects_clear(&tile->modified);
+            tidy_dirty_rects_add(&tile->modified, 0, 0,
+                                 tile->pos.width, tile->pos.height);
           }
     }
   else
@@ -401,6 +408,20 @@ void tidy_mem_texture_set_data(TidyMemTexture *texture,
     }
 }
 
+/* Switches to reading from @data, which has the same geometry as the
+ * buffer given to tidy_mem_texture_set_data().  Unlike set_data() this
+ * keeps the tiles and doesn't cause a full upload, so the caller must
+ * damage what differs between the old and the new buffer. */
+void tidy_mem_texture_set_buffer(TidyMemTexture *texture,
+                                 const guchar *data)
+{
+  if (!TIDY_IS_MEM_TEXTURE(texture))
+    return;
+  g_return_if_fail(texture->priv->texture_ptr && data);
+
+  texture->priv->texture_ptr = data;
+}
+
 void tidy_mem_texture_damage(TidyMemTexture *texture,
                              gint x, gint y,
                              gint width, gint height)
@@ -438,31 +459,9 @@ void tidy_mem_texture_damage(TidyMemTexture *texture,
           if (mod.height+mod.y > tile->pos.height)
             mod.height = tile->pos.height - mod.y;
 
-          if (tile->modified.width>0 && tile->modified.height>0)
-            {
-              /* if we already have damage, extend damaged area */
-              gint oldx2, oldy2, newx2, newy2;
-              oldx2 = tile->modified.x + tile->modified.width;
-              oldy2 = tile->modified.y + tile->modified.height;
-              newx2 = mod.x + mod.width;
-              newy2 = mod.y + mod.height;
-
-              if (mod.x < tile->modified.x)
-                tile->modified.x = mod.x;
-              if (mod.y < tile->modified.y)
-                tile->modified.y = mod.y;
-              if (newx2 > oldx2)
-                oldx2 = newx2;
-              if (newy2 > oldy2)
-                oldy2 = newy2;
-              tile->modified.width = oldx2 - tile->modified.x;
-              tile->modified.height = oldy2 - tile->modified.y;
-            }
-          else
-            {
-              /* else just set damaged area */
-              tile->modified = mod;
-            }
+          /* add it to the damaged areas, merging if it's worth it */
+          tidy_dirty_rects_add(&tile->modified,
+                               mod.x, mod.y, mod.width, mod.height);
 
           /* only redraw if the changed tile is visible */
           if (tidy_mem_texture_tile_visible(texture, tile,
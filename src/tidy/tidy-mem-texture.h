@@ -78,6 +78,8 @@ void tidy_mem_texture_set_data(TidyMemTexture *texture,
                                const guchar *data,
                                gint width, gint height,
                                gint bytes_per_pixel);
+void tidy_mem_texture_set_buffer(TidyMemTexture *texture,
+                                 const guchar *data);
 void tidy_mem_texture_damage(TidyMemTexture *texture,
                              gint x, gint y,
                              gint width, gint height);
@@ -0,0 +1,237 @@
+#include "tidy-texture-accounting.h"
+
+#include <string.h>
+
+/* The registry is only ever used from the main thread. */
+typedef struct {
+  gconstpointer  key;
+  const gchar   *tag;
+  gsize          bytes;
+  /* Whether @key is a watched #ClutterTexture. */
+  gboolean       is_actor;
+} TidyTextureAccount;
+
+/* key -> TidyTextureAccount */
+static GHashTable *accounts;
+static gsize total_bytes;
+
+/* Returns how much memory @texture probably takes in the GPU. */
+static gsize
+texture_bytes (CoglHandle texture)
+{
+  guint bpp;
+
+  if (!texture || texture == COGL_INVALID_HANDLE)
+    return 0;
+
+  switch (cogl_texture_get_format (texture))
+    {
+      case COGL_PIXEL_FORMAT_A_8:
+      case COGL_PIXEL_FORMAT_G_8:
+        bpp = 1;
+        break;
+      case COGL_PIXEL_FORMAT_RGB_565:
+      case COGL_PIXEL_FORMAT_RGBA_4444:
+      case COGL_PIXEL_FORMAT_RGBA_5551:
+        bpp = 2;
+        break;
+      case COGL_PIXEL_FORMAT_RGB_888:
+      case COGL_PIXEL_FORMAT_BGR_888:
+        bpp = 3;
+        break;
+      default:
+        bpp = 4;
+        break;
+    }
+
+  return (gsize)cogl_texture_get_width (texture)
+    * cogl_texture_get_height (texture) * bpp;
+}
+
+/*
+ * Records that the allocation identified by @key takes @bytes of texture
+ * memory on behalf of @tag.  Adding the same @key again replaces the
+ * previous record, and 0 @bytes removes it.
+ */
+void
+tidy_texture_accounting_add_bytes (gconstpointer key, const gchar *tag,
+                                   gsize bytes)
+{
+  TidyTextureAccount *account;
+
+  if (!bytes)
+    {
+      tidy_texture_accounting_remove (key);
+      return;
+    }
+
+  if (G_UNLIKELY (!accounts))
+    accounts = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  if (!(account = g_hash_table_lookup (accounts, key)))
+    {
+      account = g_slice_new (TidyTextureAccount);
+      account->key = key;
+      account->bytes = 0;
+      account->is_actor = FALSE;
+      g_hash_table_insert (accounts, (gpointer)key, account);
+    }
+
+  total_bytes -= account->bytes;
+  account->tag = tag;
+  account->bytes = bytes;
+  total_bytes += bytes;
+}
+
+/* Like tidy_texture_accounting_add_bytes() but works out the size
+ * from @texture. */
+void
+tidy_texture_accounting_add (gconstpointer key, const gchar *tag,
+                             CoglHandle texture)
+{
+  tidy_texture_accounting_add_bytes (key, tag, texture_bytes (texture));
+}
+
+/* Forgets about @key.  It's not an error if it wasn't recorded. */
+void
+tidy_texture_accounting_remove (gconstpointer key)
+{
+  TidyTextureAccount *account;
+
+  if (!accounts || !(account = g_hash_table_lookup (accounts, key)))
+    return;
+
+  total_bytes -= account->bytes;
+  g_hash_table_remove (accounts, key);
+  g_slice_free (TidyTextureAccount, account);
+}
+
+/* @texture's contents have been replaced, update its size. */
+static void
+watched_texture_changed (ClutterTexture *texture, const gchar *tag)
+{
+  TidyTextureAccount *account;
+
+  tidy_texture_accounting_add (texture, tag,
+                               clutter_texture_get_cogl_texture (texture));
+  if (accounts && (account = g_hash_table_lookup (accounts, texture)))
+    account->is_actor = TRUE;
+}
+
+/* @texture has been finalized. */
+static void
+watched_texture_gone (gpointer key, GObject *unused)
+{
+  tidy_texture_accounting_remove (key);
+}
+
+/* Accounts @texture, a #ClutterTexture, under @tag for as long as it
+ * lives, following the changes of its contents. */
+void
+tidy_texture_accounting_watch (ClutterActor *texture, const gchar *tag)
+{
+  g_return_if_fail (CLUTTER_IS_TEXTURE (texture));
+
+  if (!g_object_get_data (G_OBJECT (texture), "tidy-texture-accounting"))
+    {
+      g_object_set_data (G_OBJECT (texture), "tidy-texture-accounting",
+                         (gpointer)tag);
+      g_signal_connect (texture, "pixbuf-change",
+                        G_CALLBACK (watched_texture_changed), (gpointer)tag);
+      g_object_weak_ref (G_OBJECT (texture), watched_texture_gone, texture);
+    }
+
+  watched_texture_changed (CLUTTER_TEXTURE (texture), tag);
+}
+
+static void
+collect_account (gpointer key, TidyTextureAccount *account,
+                 GPtrArray *all)
+{
+  g_ptr_array_add (all, account);
+}
+
+static gint
+cmp_accounts_by_size (gconstpointer a, gconstpointer b)
+{
+  const TidyTextureAccount *lhs = *(const TidyTextureAccount **)a;
+  const TidyTextureAccount *rhs = *(const TidyTextureAccount **)b;
+
+  return lhs->bytes < rhs->bytes ? 1 : lhs->bytes > rhs->bytes ? -1 : 0;
+}
+
+/*
+ * Returns a human-readable summary of the texture memory use: the grand
+ * total, the total of each tag and the @top_n biggest allocations.
+ * The caller owns the string, which consists of '\n'-terminated lines.
+ */
+gchar *
+tidy_texture_accounting_report (guint top_n)
+{
+  GString *report;
+  GPtrArray *all, *tags;
+  guint i, j;
+
+  report = g_string_new (NULL);
+  g_string_append_printf (report, "texture memory: %" G_GSIZE_FORMAT
+                          " kB\n", total_bytes / 1024);
+  if (!accounts)
+    return g_string_free (report, FALSE);
+
+  all = g_ptr_array_new ();
+  g_hash_table_foreach (accounts, (GHFunc)collect_account, all);
+  g_ptr_array_sort (all, cmp_accounts_by_size);
+
+  /* Sum up per tag.  There are only a handful of them. */
+  tags = g_ptr_array_new ();
+  for (i = 0; i < all->len; i++)
+    {
+      const TidyTextureAccount *account = g_ptr_array_index (all, i);
+      TidyTextureAccount *sum = NULL;
+
+      for (j = 0; j < tags->len; j++)
+        if (!strcmp (((TidyTextureAccount *)g_ptr_array_index (tags, j))->tag,
+                     account->tag))
+          {
+            sum = g_ptr_array_index (tags, j);
+            break;
+          }
+      if (!sum)
+        {
+          sum = g_slice_new0 (TidyTextureAccount);
+          sum->tag = account->tag;
+          g_ptr_array_add (tags, sum);
+        }
+      sum->bytes += account->bytes;
+      /* Use the key to count the allocations. */
+      sum->key = GUINT_TO_POINTER (GPOINTER_TO_UINT (sum->key) + 1);
+    }
+
+  g_ptr_array_sort (tags, cmp_accounts_by_size);
+  for (j = 0; j < tags->len; j++)
+    {
+      TidyTextureAccount *sum = g_ptr_array_index (tags, j);
+
+      g_string_append_printf (report, " %s: %" G_GSIZE_FORMAT " kB in %u\n",
+                              sum->tag, sum->bytes / 1024,
+                              GPOINTER_TO_UINT (sum->key));
+      g_slice_free (TidyTextureAccount, sum);
+    }
+  g_ptr_array_free (tags, TRUE);
+
+  for (i = 0; i < all->len && i < top_n; i++)
+    {
+      const TidyTextureAccount *account = g_ptr_array_index (all, i);
+      const gchar *name;
+
+      name = account->is_actor
+        ? clutter_actor_get_name (CLUTTER_ACTOR (account->key)) : NULL;
+      g_string_append_printf (report, " #%u %p (%s%s%s): %" G_GSIZE_FORMAT
+                              " kB\n", i + 1, account->key, account->tag,
+                              name ? ", " : "", name ? name : "",
+                              account->bytes / 1024);
+    }
+  g_ptr_array_free (all, TRUE);
+
+  return g_string_free (report, FALSE);
+}
@@ -0,0 +1,20 @@
+#ifndef _TIDY_TEXTURE_ACCOUNTING
+#define _TIDY_TEXTURE_ACCOUNTING
+
+#include <clutter/clutter.h>
+#include <cogl/cogl.h>
+
+/* Keeping track of who holds how much texture memory.  Allocations are
+ * identified by an arbitrary @key (usually the texture handle or actor)
+ * and grouped by an owner @tag, which must be a static string. */
+void  tidy_texture_accounting_add_bytes (gconstpointer key, const gchar *tag,
+                                         gsize bytes);
+void  tidy_texture_accounting_add       (gconstpointer key, const gchar *tag,
+                                         CoglHandle texture);
+void  tidy_texture_accounting_remove    (gconstpointer key);
+void  tidy_texture_accounting_watch     (ClutterActor *texture,
+                                         const gchar *tag);
+
+gchar *tidy_texture_accounting_report    (guint top_n);
+
+#endif
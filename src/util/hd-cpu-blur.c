@@ -0,0 +1,293 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Gaussian-like blur on the CPU, for when we can't blur with shaders.
+ * Three box blurs in a row are close to a gaussian, and a box blur is
+ * cheap: keep a running sum of the window and add the sample entering
+ * and subtract the one leaving it.
+ *
+ * We only ever blur vertically, where neighbouring bytes in a row are
+ * independent, so the SIMD variants simply do 16 bytes at a time with
+ * 16 bit sums.  Horizontal blur is done by transposing the image,
+ * blurring vertically and transposing back.  The threads each do a band
+ * of columns, or of rows when transposing.
+ */
+
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+# define HD_CPU_BLUR_NEON
+# include <arm_neon.h>
+#elif defined(__SSE2__)
+# define HD_CPU_BLUR_SSE2
+# include <emmintrin.h>
+#endif
+
+#include "hd-cpu-blur.h"
+
+/* Don't split the work more than this. */
+#define MAX_THREADS 8
+
+/* What a thread does on its band of the image. */
+typedef struct
+{
+  guchar  *a, *b;
+  gint     width, height; /* pixels */
+  gint     start, end;    /* bytes of a row or rows */
+  gint     radius;
+} Band;
+
+/* One vertical box blur on the bytes @start..@end of the rows,
+ * from @src to @dst, with @acc as the running sums. */
+static void
+box_v (const guchar *src, guchar *dst, gint stride, gint height,
+       gint start, gint end, gint radius, guint16 *acc)
+{
+  guint16 mul;
+  gint x, y;
+#if defined(HD_CPU_BLUR_SSE2)
+  __m128i vmul, zero;
+#endif
+
+  /* (acc*mul) >> 16 is acc / (2*radius+1), not overflowing 255. */
+  mul = (0x10000 + 2*radius) / (2*radius + 1);
+#if defined(HD_CPU_BLUR_SSE2)
+  vmul = _mm_set1_epi16 ((gint16)mul);
+  zero = _mm_setzero_si128 ();
+#endif
+
+  /* The edge rows are repeated. */
+  for (x = start; x < end; x++)
+    {
+      acc[x-start] = src[x] * (radius+1);
+      for (y = 1; y <= radius; y++)
+        acc[x-start] += src[MIN(y, height-1)*stride + x];
+    }
+
+  for (y = 0; y < height; y++)
+    {
+      const guchar *add = src + MIN(y+radius+1, height-1)*stride;
+      const guchar *sub = src + MAX(y-radius, 0)*stride;
+      guchar *out = dst + y*stride;
+
+      x = start;
+#if defined(HD_CPU_BLUR_NEON)
+      for (; x + 16 <= end; x += 16)
+        {
+          guint16 *s = acc + x - start;
+          uint16x8_t lo = vld1q_u16 (s), hi = vld1q_u16 (s + 8);
+          uint8x16_t in = vld1q_u8 (add + x), old = vld1q_u8 (sub + x);
+          uint16x4_t l0, l1, h0, h1;
+
+          l0 = vshrn_n_u32 (vmull_n_u16 (vget_low_u16 (lo), mul), 16);
+          l1 = vshrn_n_u32 (vmull_n_u16 (vget_high_u16 (lo), mul), 16);
+          h0 = vshrn_n_u32 (vmull_n_u16 (vget_low_u16 (hi), mul), 16);
+          h1 = vshrn_n_u32 (vmull_n_u16 (vget_high_u16 (hi), mul), 16);
+          vst1q_u8 (out + x, vcombine_u8 (vmovn_u16 (vcombine_u16 (l0, l1)),
+                                          vmovn_u16 (vcombine_u16 (h0, h1))));
+
+          lo = vsubw_u8 (vaddw_u8 (lo, vget_low_u8 (in)), vget_low_u8 (old));
+          hi = vsubw_u8 (vaddw_u8 (hi, vget_high_u8 (in)), vget_high_u8 (old));
+          vst1q_u16 (s, lo);
+          vst1q_u16 (s + 8, hi);
+        }
+#elif defined(HD_CPU_BLUR_SSE2)
+      for (; x + 16 <= end; x += 16)
+        {
+          guint16 *s = acc + x - start;
+          __m128i lo = _mm_loadu_si128 ((const __m128i *)s);
+          __m128i hi = _mm_loadu_si128 ((const __m128i *)(s + 8));
+          __m128i in = _mm_loadu_si128 ((const __m128i *)(add + x));
+          __m128i old = _mm_loadu_si128 ((const __m128i *)(sub + x));
+
+          _mm_storeu_si128 ((__m128i *)(out + x),
+                            _mm_packus_epi16 (_mm_mulhi_epu16 (lo, vmul),
+                                              _mm_mulhi_epu16 (hi, vmul)));
+
+          lo = _mm_add_epi16 (lo, _mm_unpacklo_epi8 (in, zero));
+          lo = _mm_sub_epi16 (lo, _mm_unpacklo_epi8 (old, zero));
+          hi = _mm_add_epi16 (hi, _mm_unpackhi_epi8 (in, zero));
+          hi = _mm_sub_epi16 (hi, _mm_unpackhi_epi8 (old, zero));
+          _mm_storeu_si128 ((__m128i *)s, lo);
+          _mm_storeu_si128 ((__m128i *)(s + 8), hi);
+        }
+#endif
+      for (; x < end; x++)
+        {
+          guint16 *s = acc + x - start;
+
+          out[x] = (*s * mul) >> 16;
+          *s += add[x] - sub[x];
+        }
+    }
+}
+
+/* Three vertical box blurs on a band of columns, from a to b. */
+static gpointer
+blur_band (Band *band)
+{
+  gint stride = band->width * 4;
+  guint16 *acc;
+
+  acc = g_new (guint16, band->end - band->start);
+  box_v (band->a, band->b, stride, band->height,
+         band->start, band->end, band->radius, acc);
+  box_v (band->b, band->a, stride, band->height,
+         band->start, band->end, band->radius, acc);
+  box_v (band->a, band->b, stride, band->height,
+         band->start, band->end, band->radius, acc);
+  g_free (acc);
+
+  return NULL;
+}
+
+/* Transposes the rows @start..@end of a to the columns of b. */
+static gpointer
+transpose_band (Band *band)
+{
+  const guint32 *src = (const guint32 *)band->a;
+  guint32 *dst = (guint32 *)band->b;
+  gint x, y, xx, yy;
+
+  /* In blocks so that we don't walk all over the cache. */
+  for (y = band->start; y < band->end; y += 16)
+    for (x = 0; x < band->width; x += 16)
+      for (yy = y; yy < MIN(y+16, band->end); yy++)
+        for (xx = x; xx < MIN(x+16, band->width); xx++)
+          dst[xx*band->height + yy] = src[yy*band->width + xx];
+
+  return NULL;
+}
+
+/* Runs @func on @n_threads bands of @n (rows or bytes of a row),
+ * a multiple of @align each except the last one. */
+static void
+run_bands (GThreadFunc func, const Band *proto, gint n, gint align,
+           gint n_threads)
+{
+  Band bands[MAX_THREADS];
+  GThread *threads[MAX_THREADS];
+  gint i, size;
+
+  size = ((n + n_threads - 1) / n_threads + align - 1) / align * align;
+  for (i = 0; i < n_threads; i++)
+    {
+      bands[i] = *proto;
+      bands[i].start = MIN(i * size, n);
+      bands[i].end = MIN((i+1) * size, n);
+    }
+
+  for (i = 1; i < n_threads; i++)
+    threads[i] = g_thread_new ("hd-cpu-blur", func, &bands[i]);
+  func (&bands[0]);
+  for (i = 1; i < n_threads; i++)
+    g_thread_join (threads[i]);
+}
+
+void
+hd_cpu_blur (guchar *pixels, gint width, gint height,
+             gint radius, gint n_threads)
+{
+  Band band;
+  guchar *tmp;
+
+  radius = CLAMP (radius, 0, HD_CPU_BLUR_MAX_RADIUS);
+  n_threads = CLAMP (n_threads, 1, MAX_THREADS);
+  if (!radius || width <= 0 || height <= 0)
+    return;
+
+  tmp = g_malloc (width * height * 4);
+  band.radius = radius;
+
+  /* Vertically: pixels -> tmp, then tmp transposed to pixels. */
+  band.a = pixels;
+  band.b = tmp;
+  band.width = width;
+  band.height = height;
+  run_bands ((GThreadFunc)blur_band, &band, width * 4, 16, n_threads);
+  band.a = tmp;
+  band.b = pixels;
+  run_bands ((GThreadFunc)transpose_band, &band, height, 1, n_threads);
+
+  /* Horizontally the same way, the image is @height wide now. */
+  band.a = pixels;
+  band.b = tmp;
+  band.width = height;
+  band.height = width;
+  run_bands ((GThreadFunc)blur_band, &band, height * 4, 16, n_threads);
+  band.a = tmp;
+  band.b = pixels;
+  run_bands ((GThreadFunc)transpose_band, &band, width, 1, n_threads);
+
+  g_free (tmp);
+}
+
+void
+hd_cpu_blur_shrink (const guchar *src, gint width, gint height,
+                    gint rowstride, gint factor, guchar *dst)
+{
+  gint x, y, i, j, c, w, h;
+
+  g_return_if_fail (factor > 0);
+
+  w = width / factor;
+  h = height / factor;
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++)
+      for (c = 0; c < 4; c++)
+        {
+          guint sum = 0;
+
+          for (j = 0; j < factor; j++)
+            for (i = 0; i < factor; i++)
+              sum += src[(y*factor+j)*rowstride + (x*factor+i)*4 + c];
+          *dst++ = sum / (factor*factor);
+        }
+}
+
+gint
+hd_cpu_blur_radius (gfloat sigma)
+{
+  gint r;
+
+  /* The largest radius with r*(r+1) <= sigma^2, or the next one
+   * if that's closer. */
+  for (r = 0; r < HD_CPU_BLUR_MAX_RADIUS && (r+1)*(r+2) <= sigma*sigma; r++)
+    ;
+  if (r < HD_CPU_BLUR_MAX_RADIUS
+      && (r+1)*(r+2) - sigma*sigma < sigma*sigma - r*(r+1))
+    r++;
+
+  return r;
+}
+
+const gchar *
+hd_cpu_blur_impl (void)
+{
+#if defined(HD_CPU_BLUR_NEON)
+  return "neon";
+#elif defined(HD_CPU_BLUR_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_CPU_BLUR_H__
+#define __HD_CPU_BLUR_H__
+
+#include <glib.h>
+
+/* The largest radius hd_cpu_blur() takes. */
+#define HD_CPU_BLUR_MAX_RADIUS 127
+
+/*
+ * Shrinks @src of 4 bytes per pixel by @factor in both directions,
+ * averaging @factor x @factor blocks.  @dst must have room for
+ * (@width/@factor)*(@height/@factor) pixels, it is written without
+ * padding.
+ */
+void hd_cpu_blur_shrink (const guchar *src, gint width, gint height,
+                         gint rowstride, gint factor, guchar *dst);
+
+/*
+ * Blurs @pixels of 4 bytes per pixel without padding in place, with
+ * three box passes of @radius both horizontally and vertically.  That's
+ * close to a gaussian with a sigma of sqrt(@radius*(@radius+1)).
+ * The work is split between @n_threads threads.  The result doesn't
+ * depend on which implementation is used.
+ */
+void hd_cpu_blur (guchar *pixels, gint width, gint height,
+                  gint radius, gint n_threads);
+
+/* The radius to give hd_cpu_blur() for about @sigma. */
+gint hd_cpu_blur_radius (gfloat sigma);
+
+/* The name of the implementation hd_cpu_blur() uses. */
+const gchar *hd_cpu_blur_impl (void);
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hd-curve.h"
+
+struct _HdCurve
+{
+  guint  ref_count;
+  guint  n_samples;
+  float  samples[1];
+};
+
+HdCurve *
+hd_curve_new_from_samples (const float *samples, guint n_samples)
+{
+  HdCurve *curve;
+
+  g_assert (n_samples >= 2);
+  curve = g_malloc (G_STRUCT_OFFSET (HdCurve, samples)
+                    + sizeof (curve->samples[0]) * n_samples);
+  curve->ref_count = 1;
+  curve->n_samples = n_samples;
+  memcpy (curve->samples, samples, sizeof (samples[0]) * n_samples);
+  return curve;
+}
+
+HdCurve *
+hd_curve_new_from_func (float (*func)(float x))
+{
+  float samples[HD_CURVE_RESOLUTION+1];
+  guint i;
+
+  for (i = 0; i <= HD_CURVE_RESOLUTION; i++)
+    samples[i] = func ((float)i / HD_CURVE_RESOLUTION);
+  return hd_curve_new_from_samples (samples, G_N_ELEMENTS (samples));
+}
+
+HdCurve *
+hd_curve_new_from_string (const char *keys)
+{
+  static const float ramp[] = { 0, 1 };
+  gchar **values;
+  float *samples;
+  HdCurve *curve;
+  guint i, n;
+
+  /* Trailing commas are allowed and ignored. */
+  if (!keys || strlen (keys) <= 1)
+    return hd_curve_new_from_samples (ramp, G_N_ELEMENTS (ramp));
+  values = g_strsplit (keys, ",", -1);
+  n = g_strv_length (values);
+  if (n > 0 && !*values[n-1])
+    n--;
+  if (n < 2)
+    {
+      g_strfreev (values);
+      return hd_curve_new_from_samples (ramp, G_N_ELEMENTS (ramp));
+    }
+
+  samples = g_new (float, n);
+  for (i = 0; i < n; i++)
+    samples[i] = atof (values[i]);
+  curve = hd_curve_new_from_samples (samples, n);
+  g_free (samples);
+  g_strfreev (values);
+
+  return curve;
+}
+
+HdCurve *
+hd_curve_ref (HdCurve *curve)
+{
+  curve->ref_count++;
+  return curve;
+}
+
+void
+hd_curve_unref (HdCurve *curve)
+{
+  if (curve && !--curve->ref_count)
+    g_free (curve);
+}
+
+float
+hd_curve_get (const HdCurve *curve, float x)
+{
+  float v;
+  guint i;
+
+  if (!curve)
+    return x;
+
+  /* Also catches NaN:s. */
+  if (!(x > 0))
+    return curve->samples[0];
+  if (x >= 1)
+    return curve->samples[curve->n_samples-1];
+
+  v = x * (curve->n_samples-1);
+  if ((i = (guint)v) >= curve->n_samples-1)
+    /* Rounded up. */
+    return curve->samples[curve->n_samples-1];
+  return curve->samples[i] + (curve->samples[i+1] - curve->samples[i]) * (v-i);
+}
@@ -0,0 +1,56 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef __HD_CURVE_H__
+#define __HD_CURVE_H__
+
+#include <glib.h>
+
+/*
+ * Easing curves for animations, mapping 0..1 to whatever.  They are
+ * sampled into a table once when they're made, so getting a value is a
+ * lookup and a linear interpolation between the two nearest samples,
+ * with no trigonometry every frame.  Curves are reference counted so
+ * that they can be shared between the animations using them.
+ */
+typedef struct _HdCurve HdCurve;
+
+/* How many intervals the curves made of functions are sampled at. */
+#define HD_CURVE_RESOLUTION 256
+
+/* Makes a curve of @n_samples values at evenly spaced points between
+ * 0 and 1, including both ends.  @n_samples must be at least 2. */
+HdCurve *hd_curve_new_from_samples (const float *samples, guint n_samples);
+/* Makes a curve of @func sampled at HD_CURVE_RESOLUTION intervals. */
+HdCurve *hd_curve_new_from_func    (float (*func)(float x));
+/* Makes a curve from a comma-separated list of floating point values
+ * like in transitions.ini, or a straight 0..1 ramp if it's invalid. */
+HdCurve *hd_curve_new_from_string  (const char *keys);
+
+HdCurve *hd_curve_ref              (HdCurve *curve);
+void     hd_curve_unref            (HdCurve *curve);
+
+/* Returns @curve at @x, which is clamped to 0..1.  With a %NULL @curve
+ * it's @x itself. */
+float    hd_curve_get              (const HdCurve *curve, float x);
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * RGB(A) to RGB565 conversion with dithering.  We add a little random
+ * noise to every sample then truncate it, which hides the banding of
+ * wallpaper gradients on the 16 bit display.  The noise comes from
+ * a linear feedback shift register (LFSR), see
+ * http://en.wikipedia.org/wiki/Linear_feedback_shift_register
+ *
+ * The LFSR is inherently serial, so it's run in plain C for a row
+ * at a time, producing the per-sample noise into a buffer laid out
+ * like RGBA pixels.  The adding, saturating and packing is what the
+ * SIMD variants do, 16 (NEON) or 8 (SSE2) pixels at a time.
+ */
+
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+# define HD_DITHER_NEON
+# include <arm_neon.h>
+#elif defined(__SSE2__)
+# define HD_DITHER_SSE2
+# include <emmintrin.h>
+#endif
+
+#include "hd-dither.h"
+
+/* Advance the LFSR by one step. */
+#define LFSR_NEXT(lfsr) \
+  (((lfsr) >> 1) ^ (guint32)((0 - ((lfsr) & 1u)) & 0xd0000001u))
+
+/* Dither and pack a single pixel @p with @noise. */
+static inline guint16
+dither_pixel (const guchar *p, const guchar *noise)
+{
+  guint r, g, b;
+
+  /* (r>>8)*0xFF makes sure our bottom 8 bits are 0xFF if we overflow. */
+  r = p[0] + noise[0];
+  r |= (r>>8)*0xFF;
+  g = p[1] + noise[1];
+  g |= (g>>8)*0xFF;
+  b = p[2] + noise[2];
+  b |= (b>>8)*0xFF;
+  return ((r<<8)&0xF800) | ((g<<3)&0x07E0) | ((b>>3)&0x001F);
+}
+
+/* Fill @noise with the noise of the next @width pixels: 0..7 for red
+ * and blue, 0..3 for green, 0 for the fourth byte.  Returns the new
+ * state of the LFSR. */
+static guint32
+make_noise (guint32 lfsr, guchar *noise, gint width)
+{
+  gint x;
+
+  for (x = 0; x < width; x++, noise += 4)
+    {
+      lfsr = LFSR_NEXT (lfsr);
+      noise[0] =  lfsr       & 7;
+      noise[1] = (lfsr >> 3) & 3;
+      noise[2] = (lfsr >> 5) & 7;
+      noise[3] = 0;
+    }
+
+  return lfsr;
+}
+
+/* Dither a row of @width pixels.  The SIMD variants do as much as they
+ * can and leave the rest to this.  Returns the number of pixels done. */
+static gint
+dither_row_scalar (const guchar *pixels, const guchar *noise, gint width,
+                   gint n_channels, guint16 *out)
+{
+  gint x;
+
+  for (x = 0; x < width; x++)
+    {
+      *out++ = dither_pixel (pixels, noise);
+      pixels += n_channels;
+      noise += 4;
+    }
+
+  return width;
+}
+
+#if defined(HD_DITHER_NEON)
+static gint
+dither_row_simd (const guchar *pixels, const guchar *noise, gint width,
+                 gint n_channels, guint16 *out)
+{
+  gint x;
+
+  for (x = 0; x + 16 <= width; x += 16)
+    {
+      uint8x16x4_t n;
+      uint8x16_t r, g, b;
+      uint16x8_t lo, hi;
+
+      n = vld4q_u8 (noise + 4*x);
+      if (n_channels == 4)
+        {
+          uint8x16x4_t p = vld4q_u8 (pixels + 4*x);
+          r = p.val[0]; g = p.val[1]; b = p.val[2];
+        }
+      else
+        {
+          uint8x16x3_t p = vld3q_u8 (pixels + 3*x);
+          r = p.val[0]; g = p.val[1]; b = p.val[2];
+        }
+
+      /* Saturation is equivalent to |= (r>>8)*0xFF. */
+      r = vqaddq_u8 (r, n.val[0]);
+      g = vqaddq_u8 (g, n.val[1]);
+      b = vqaddq_u8 (b, n.val[2]);
+
+      /* Pack: shift the top 5-6-5 bits of the samples in place. */
+      lo = vshll_n_u8 (vget_low_u8 (r), 8);
+      lo = vsriq_n_u16 (lo, vshll_n_u8 (vget_low_u8 (g), 8), 5);
+      lo = vsriq_n_u16 (lo, vshll_n_u8 (vget_low_u8 (b), 8), 11);
+      hi = vshll_n_u8 (vget_high_u8 (r), 8);
+      hi = vsriq_n_u16 (hi, vshll_n_u8 (vget_high_u8 (g), 8), 5);
+      hi = vsriq_n_u16 (hi, vshll_n_u8 (vget_high_u8 (b), 8), 11);
+      vst1q_u16 (out + x,     lo);
+      vst1q_u16 (out + x + 8, hi);
+    }
+
+  return x;
+}
+#elif defined(HD_DITHER_SSE2)
+/* Pack four 0x00BBGGRR lanes of @v to 565 in the low 16 bits. */
+static inline __m128i
+pack_565_sse2 (__m128i v)
+{
+  __m128i r, g, b;
+
+  r = _mm_slli_epi32 (_mm_and_si128 (v, _mm_set1_epi32 (0x0000F8)), 8);
+  g = _mm_srli_epi32 (_mm_and_si128 (v, _mm_set1_epi32 (0x00FC00)), 5);
+  b = _mm_srli_epi32 (_mm_and_si128 (v, _mm_set1_epi32 (0xF80000)), 19);
+  return _mm_or_si128 (r, _mm_or_si128 (g, b));
+}
+
+static gint
+dither_row_simd (const guchar *pixels, const guchar *noise, gint width,
+                 gint n_channels, guint16 *out)
+{
+  gint x;
+  const __m128i bias = _mm_set1_epi32 (0x8000);
+
+  /* With RGB we read 4 bytes for every 3 byte pixel, so leave
+   * the last pixel of the row to the scalar code. */
+  for (x = 0; x + 8 + (n_channels == 3) <= width; x += 8)
+    {
+      __m128i p0, p1, n0, n1;
+
+      if (n_channels == 4)
+        {
+          p0 = _mm_loadu_si128 ((const __m128i *)(pixels + 4*x));
+          p1 = _mm_loadu_si128 ((const __m128i *)(pixels + 4*x + 16));
+        }
+      else
+        {
+          guint32 w[8];
+          gint i;
+
+          for (i = 0; i < 8; i++)
+            memcpy (&w[i], pixels + 3*(x+i), sizeof (w[i]));
+          p0 = _mm_loadu_si128 ((const __m128i *)&w[0]);
+          p1 = _mm_loadu_si128 ((const __m128i *)&w[4]);
+        }
+
+      /* The fourth byte of @noise is 0, whatever is in the fourth byte
+       * of the pixels is masked out by pack_565_sse2(). */
+      n0 = _mm_loadu_si128 ((const __m128i *)(noise + 4*x));
+      n1 = _mm_loadu_si128 ((const __m128i *)(noise + 4*x + 16));
+      p0 = pack_565_sse2 (_mm_adds_epu8 (p0, n0));
+      p1 = pack_565_sse2 (_mm_adds_epu8 (p1, n1));
+
+      /* There's no unsigned 32->16 bit pack in SSE2, so shift the values
+       * to the signed range and back. */
+      p0 = _mm_sub_epi32 (p0, bias);
+      p1 = _mm_sub_epi32 (p1, bias);
+      p0 = _mm_add_epi16 (_mm_packs_epi32 (p0, p1), _mm_set1_epi16 (-0x8000));
+      _mm_storeu_si128 ((__m128i *)(out + x), p0);
+    }
+
+  return x;
+}
+#endif
+
+/* Dithers the image with @dither_row, which may leave the end
+ * of the rows to dither_row_scalar(). */
+static void
+dither_565 (gint (*dither_row)(const guchar *, const guchar *, gint,
+                               gint, guint16 *),
+            const guchar *pixels, gint width, gint height,
+            gint rowstride, gint n_channels, guint16 *out)
+{
+  gint y, done;
+  guchar *noise;
+  guint32 lfsr;
+
+  g_return_if_fail (n_channels == 3 || n_channels == 4);
+
+  lfsr = 1;
+  noise = g_malloc (width * 4);
+  for (y = 0; y < height; y++)
+    {
+      lfsr = make_noise (lfsr, noise, width);
+      done = dither_row (pixels, noise, width, n_channels, out);
+      dither_row_scalar (pixels + done*n_channels, noise + done*4,
+                         width - done, n_channels, out + done);
+      pixels += rowstride;
+      out += width;
+    }
+  g_free (noise);
+}
+
+void
+hd_dither_565_scalar (const guchar *pixels, gint width, gint height,
+                      gint rowstride, gint n_channels, guint16 *out)
+{
+  dither_565 (dither_row_scalar, pixels, width, height,
+              rowstride, n_channels, out);
+}
+
+void
+hd_dither_565 (const guchar *pixels, gint width, gint height,
+               gint rowstride, gint n_channels, guint16 *out)
+{
+#if defined(HD_DITHER_NEON) || defined(HD_DITHER_SSE2)
+  dither_565 (dither_row_simd, pixels, width, height,
+              rowstride, n_channels, out);
+#else
+  hd_dither_565_scalar (pixels, width, height, rowstride, n_channels, out);
+#endif
+}
+
+const gchar *
+hd_dither_565_impl (void)
+{
+#if defined(HD_DITHER_NEON)
+  return "neon";
+#elif defined(HD_DITHER_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
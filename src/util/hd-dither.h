@@ -0,0 +1,44 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_DITHER_H__
+#define __HD_DITHER_H__
+
+#include <glib.h>
+
+/*
+ * Converts 8 bits per sample RGB (@n_channels == 3) or RGBA
+ * (@n_channels == 4) @pixels to RGB565, dithering with LFSR noise.
+ * @out must have room for @width*@height pixels, it is written
+ * without padding.  The result doesn't depend on which implementation
+ * is used.
+ */
+void hd_dither_565 (const guchar *pixels, gint width, gint height,
+                    gint rowstride, gint n_channels, guint16 *out);
+
+/* The same, always using the plain C implementation. */
+void hd_dither_565_scalar (const guchar *pixels, gint width, gint height,
+                           gint rowstride, gint n_channels, guint16 *out);
+
+/* The name of the implementation hd_dither_565() uses. */
+const gchar *hd_dither_565_impl (void);
+
+#endif
@@ -0,0 +1,364 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include "hd-hptimer.h"
+
+#define NSEC_PER_MSEC 1000000
+#define NSEC_PER_SEC  1000000000
+
+struct _HdHPTimer
+{
+  /* When it expires next, in nanoseconds of CLOCK_MONOTONIC. */
+  gint64          deadline;
+  guint           interval;
+
+  GSourceFunc     func;
+  gpointer        data;
+  GDestroyNotify  notify;
+
+  /* Where it is in the heap, or -1 while its @func is being called. */
+  gint            index;
+  /* Destroyed from its own @func. */
+  gboolean        destroyed;
+};
+
+/* The %GSource of all the timers, only used from the main thread. */
+typedef struct
+{
+  GSource         source;
+  /* The timerfd, or -1 if we don't have one. */
+  GPollFD         pollfd;
+  /* A binary min-heap of the timers by @deadline. */
+  GPtrArray      *heap;
+  /* The deadline the timerfd is set to, or 0 if it's not. */
+  gint64          armed;
+} HdHPTimerSource;
+
+static HdHPTimerSource *timer_source;
+
+static gint64
+hd_hptimer_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/* Heap ---------------------------------------------------------------- */
+
+static void
+heap_set (GPtrArray *heap, guint i, HdHPTimer *timer)
+{
+  heap->pdata[i] = timer;
+  timer->index = i;
+}
+
+static void
+heap_sift_up (GPtrArray *heap, guint i)
+{
+  HdHPTimer *timer = heap->pdata[i];
+
+  while (i > 0)
+    {
+      HdHPTimer *parent = heap->pdata[(i-1) / 2];
+
+      if (parent->deadline <= timer->deadline)
+        break;
+      heap_set (heap, i, parent);
+      i = (i-1) / 2;
+    }
+  heap_set (heap, i, timer);
+}
+
+static void
+heap_sift_down (GPtrArray *heap, guint i)
+{
+  HdHPTimer *timer = heap->pdata[i];
+
+  for (;;)
+    {
+      HdHPTimer *child;
+      guint c;
+
+      c = 2*i + 1;
+      if (c >= heap->len)
+        break;
+      if (c+1 < heap->len && ((HdHPTimer *)heap->pdata[c+1])->deadline
+                             < ((HdHPTimer *)heap->pdata[c])->deadline)
+        c++;
+      child = heap->pdata[c];
+      if (timer->deadline <= child->deadline)
+        break;
+      heap_set (heap, i, child);
+      i = c;
+    }
+  heap_set (heap, i, timer);
+}
+
+static void
+heap_push (GPtrArray *heap, HdHPTimer *timer)
+{
+  g_ptr_array_add (heap, timer);
+  heap_sift_up (heap, heap->len-1);
+}
+
+static void
+heap_remove (GPtrArray *heap, HdHPTimer *timer)
+{
+  guint i = timer->index;
+  HdHPTimer *last;
+
+  last = g_ptr_array_remove_index (heap, heap->len-1);
+  if (last != timer)
+    {
+      heap_set (heap, i, last);
+      heap_sift_up (heap, i);
+      heap_sift_down (heap, last->index);
+    }
+  timer->index = -1;
+}
+
+/* Source -------------------------------------------------------------- */
+
+/* Set the timerfd to the earliest deadline. */
+static void
+hd_hptimer_rearm (HdHPTimerSource *src)
+{
+  struct itimerspec its;
+  gint64 deadline;
+
+  if (src->pollfd.fd < 0)
+    return;
+
+  deadline = src->heap->len
+    ? ((HdHPTimer *)src->heap->pdata[0])->deadline : 0;
+  if (deadline == src->armed)
+    return;
+
+  /* Zero disarms it. */
+  memset (&its, 0, sizeof (its));
+  its.it_value.tv_sec  = deadline / NSEC_PER_SEC;
+  its.it_value.tv_nsec = deadline % NSEC_PER_SEC;
+  if (timerfd_settime (src->pollfd.fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+    g_warning ("timerfd_settime: %s", strerror (errno));
+  src->armed = deadline;
+}
+
+static gboolean
+hd_hptimer_source_prepare (GSource *source, gint *timeout)
+{
+  HdHPTimerSource *src = (HdHPTimerSource *)source;
+  gint64 left;
+
+  *timeout = -1;
+  if (!src->heap->len)
+    return FALSE;
+
+  left = ((HdHPTimer *)src->heap->pdata[0])->deadline - hd_hptimer_now ();
+  if (left <= 0)
+    {
+      *timeout = 0;
+      return TRUE;
+    }
+
+  /* Without the timerfd wake up not earlier than the deadline. */
+  if (src->pollfd.fd < 0)
+    *timeout = (left + NSEC_PER_MSEC-1) / NSEC_PER_MSEC;
+  return FALSE;
+}
+
+static gboolean
+hd_hptimer_source_check (GSource *source)
+{
+  HdHPTimerSource *src = (HdHPTimerSource *)source;
+
+  if (src->pollfd.revents & G_IO_IN)
+    {
+      guint64 expirations;
+
+      /* Drain it so that it doesn't stay readable.  It's disarmed now. */
+      if (read (src->pollfd.fd, &expirations, sizeof (expirations)) < 0
+          && errno != EAGAIN)
+        g_warning ("timerfd read: %s", strerror (errno));
+      src->armed = 0;
+    }
+
+  return src->heap->len
+    && ((HdHPTimer *)src->heap->pdata[0])->deadline <= hd_hptimer_now ();
+}
+
+static void
+hd_hptimer_free (HdHPTimer *timer)
+{
+  if (timer->notify)
+    timer->notify (timer->data);
+  g_slice_free (HdHPTimer, timer);
+}
+
+static gboolean
+hd_hptimer_source_dispatch (GSource *source, GSourceFunc unused1,
+                            gpointer unused2)
+{
+  HdHPTimerSource *src = (HdHPTimerSource *)source;
+  HdHPTimer *timer;
+  gint64 now;
+
+  now = hd_hptimer_now ();
+  while (src->heap->len
+         && (timer = src->heap->pdata[0])->deadline <= now)
+    {
+      gboolean again;
+
+      heap_remove (src->heap, timer);
+
+      /* Next time is @interval after when it should have been this time,
+       * so that we don't drift, unless we've fallen behind that much.
+       * @func is free to change it. */
+      timer->deadline += (gint64)timer->interval * NSEC_PER_MSEC;
+      if (timer->deadline <= now)
+        timer->deadline = now + MAX ((gint64)timer->interval * NSEC_PER_MSEC,
+                                     1);
+
+      again = timer->func (timer->data);
+      if (again && !timer->destroyed)
+        heap_push (src->heap, timer);
+      else
+        hd_hptimer_free (timer);
+    }
+
+  hd_hptimer_rearm (src);
+  return TRUE;
+}
+
+static HdHPTimerSource *
+hd_hptimer_get_source (void)
+{
+  static GSourceFuncs funcs =
+  {
+    hd_hptimer_source_prepare,
+    hd_hptimer_source_check,
+    hd_hptimer_source_dispatch,
+    NULL
+  };
+  HdHPTimerSource *src;
+  gint fd;
+
+  if (timer_source)
+    return timer_source;
+
+  src = (HdHPTimerSource *)g_source_new (&funcs, sizeof (*src));
+  src->heap = g_ptr_array_new ();
+  src->armed = 0;
+
+  if ((fd = timerfd_create (CLOCK_MONOTONIC, 0)) >= 0)
+    {
+      fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+      fcntl (fd, F_SETFD, FD_CLOEXEC);
+      src->pollfd.fd = fd;
+      src->pollfd.events = G_IO_IN | G_IO_ERR;
+      g_source_add_poll (&src->source, &src->pollfd);
+    }
+  else
+    {
+      g_warning ("timerfd_create: %s, timers will be less precise",
+                 strerror (errno));
+      src->pollfd.fd = -1;
+    }
+
+  g_source_set_priority (&src->source, G_PRIORITY_HIGH);
+  g_source_attach (&src->source, NULL);
+  return timer_source = src;
+}
+
+/* API ----------------------------------------------------------------- */
+
+HdHPTimer *
+hd_hptimer_new (guint interval, GSourceFunc func,
+                gpointer data, GDestroyNotify notify)
+{
+  HdHPTimerSource *src = hd_hptimer_get_source ();
+  HdHPTimer *timer;
+
+  timer = g_slice_new0 (HdHPTimer);
+  timer->deadline = hd_hptimer_now () + (gint64)interval * NSEC_PER_MSEC;
+  timer->interval = interval;
+  timer->func = func;
+  timer->data = data;
+  timer->notify = notify;
+
+  heap_push (src->heap, timer);
+  hd_hptimer_rearm (src);
+  return timer;
+}
+
+void
+hd_hptimer_destroy (HdHPTimer *timer)
+{
+  HdHPTimerSource *src = timer_source;
+
+  if (timer->index < 0)
+    { /* It's being dispatched, it'll be freed afterwards. */
+      timer->destroyed = TRUE;
+      return;
+    }
+
+  heap_remove (src->heap, timer);
+  hd_hptimer_free (timer);
+  hd_hptimer_rearm (src);
+}
+
+guint
+hd_hptimer_get_remaining (HdHPTimer *timer)
+{
+  gint64 left;
+
+  left = timer->deadline - hd_hptimer_now ();
+  return left > 0 ? (left + NSEC_PER_MSEC-1) / NSEC_PER_MSEC : 0;
+}
+
+void
+hd_hptimer_set_remaining (HdHPTimer *timer, guint remaining)
+{
+  HdHPTimerSource *src = timer_source;
+
+  timer->deadline = hd_hptimer_now () + (gint64)remaining * NSEC_PER_MSEC;
+  if (timer->index < 0)
+    /* It's being dispatched and will be put back. */
+    return;
+
+  heap_sift_up (src->heap, timer->index);
+  heap_sift_down (src->heap, timer->index);
+  hd_hptimer_rearm (src);
+}
+
+gboolean
+hd_hptimer_is_precise (void)
+{
+  return hd_hptimer_get_source ()->pollfd.fd >= 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_HPTIMER_H__
+#define __HD_HPTIMER_H__
+
+#include <glib.h>
+
+/*
+ * "High performance" timers in the default main context, which are
+ * like g_timeout_add() but are suited for short intervals in the
+ * sub-100th-second range.  They expire at absolute CLOCK_MONOTONIC
+ * deadlines and are woken up by a timerfd armed for the earliest of
+ * them, instead of relying on the milisecond poll() timeout measured
+ * from whenever the main loop prepared.  All of them share one timerfd
+ * and source.  If there are no timerfds they fall back to the poll()
+ * timeout.
+ *
+ * Like with a #GTimeoutSource @func is called every @interval
+ * miliseconds until it returns %FALSE, then the timer is destroyed
+ * and @notify is called with @data.
+ */
+typedef struct _HdHPTimer HdHPTimer;
+
+HdHPTimer *hd_hptimer_new           (guint interval, GSourceFunc func,
+                                     gpointer data, GDestroyNotify notify);
+void       hd_hptimer_destroy       (HdHPTimer *timer);
+
+/* The miliseconds until the timer expires next, which can be changed,
+ * even from its @func. */
+guint      hd_hptimer_get_remaining (HdHPTimer *timer);
+void       hd_hptimer_set_remaining (HdHPTimer *timer, guint remaining);
+
+/* Whether timerfds are used. */
+gboolean   hd_hptimer_is_precise    (void);
+
+#endif
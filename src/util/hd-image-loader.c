@@ -0,0 +1,149 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include <clutter/clutter.h>
+
+#include "hildon-desktop.h"
+#include "hd-image-loader.h"
+
+/* How many images can be decoded at the same time.  Decoding is
+ * memory-hungry, so don't overdo it. */
+#define HD_IMAGE_LOADER_THREADS 2
+
+/*
+ * A pending load.  It's owned by the loader until its done() is called
+ * in the main loop or is dropped there after it's been cancelled.
+ * @cancelled is the only field shared between the threads.
+ */
+struct _HdImageRequest
+{
+  gchar             *fname;
+  gint               width, height;
+  HdImageScaleFunc   scale;
+  HdImageLoadedFunc  done;
+  gpointer           data;
+
+  GdkPixbuf         *pixbuf;
+  volatile gint      cancelled;
+};
+
+static GThreadPool *loader_pool;
+
+static void
+hd_image_request_free (HdImageRequest *request)
+{
+  if (request->pixbuf)
+    g_object_unref (request->pixbuf);
+  g_free (request->fname);
+  g_slice_free (HdImageRequest, request);
+}
+
+/* Delivers the result of @request in the main loop. */
+static gboolean
+hd_image_loader_deliver (HdImageRequest *request)
+{
+  if (!g_atomic_int_get (&request->cancelled))
+    {
+      request->done (request->pixbuf, request->data);
+      request->pixbuf = NULL;
+    }
+
+  hd_image_request_free (request);
+  return FALSE;
+}
+
+/* @loader_pool's worker. */
+static void
+hd_image_loader_work (HdImageRequest *request, gpointer unused)
+{
+  GError *error;
+  GdkPixbuf *pixbuf;
+
+  /* Don't bother if nobody wants it anymore. */
+  if (g_atomic_int_get (&request->cancelled))
+    goto out;
+
+  error = NULL;
+  if (!(pixbuf = gdk_pixbuf_new_from_file (request->fname, &error)))
+    {
+      g_warning ("%s: %s", request->fname, error->message);
+      g_error_free (error);
+      goto out;
+    }
+
+  if (request->scale && !g_atomic_int_get (&request->cancelled))
+    pixbuf = request->scale (pixbuf, request->width, request->height,
+                             request->data);
+  request->pixbuf = pixbuf;
+
+out:
+  clutter_threads_add_idle ((GSourceFunc)hd_image_loader_deliver, request);
+}
+
+/*
+ * Loads @fname in a worker thread and transforms it with @scale
+ * to @width x @height, if @scale isn't %NULL.
+ * When it's done @done is called in the main loop with the result.
+ * @data is passed to both functions.  Returns a handle which can be
+ * used to hd_image_loader_cancel() the request until @done is called.
+ */
+HdImageRequest *
+hd_image_loader_load (const gchar       *fname,
+                      gint               width,
+                      gint               height,
+                      HdImageScaleFunc   scale,
+                      HdImageLoadedFunc  done,
+                      gpointer           data)
+{
+  HdImageRequest *request;
+
+  g_return_val_if_fail (fname && done, NULL);
+
+  request = g_slice_new0 (HdImageRequest);
+  request->fname  = g_strdup (fname);
+  request->width  = width;
+  request->height = height;
+  request->scale  = scale;
+  request->done   = done;
+  request->data   = data;
+
+  if (hd_disable_threads ())
+    hd_image_loader_work (request, NULL);
+  else
+    {
+      if (G_UNLIKELY (!loader_pool))
+        loader_pool = g_thread_pool_new ((GFunc)hd_image_loader_work, NULL,
+                                         HD_IMAGE_LOADER_THREADS, FALSE,
+                                         NULL);
+      g_thread_pool_push (loader_pool, request, NULL);
+    }
+
+  return request;
+}
+
+/* Makes sure @request's done() won't be called.  It must be called
+ * in the main thread, before done() is called. */
+void
+hd_image_loader_cancel (HdImageRequest *request)
+{
+  g_return_if_fail (request != NULL);
+  g_atomic_int_set (&request->cancelled, TRUE);
+}
@@ -0,0 +1,49 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_IMAGE_LOADER_H__
+#define __HD_IMAGE_LOADER_H__
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/* Loading and scaling images in worker threads, so that only the texture
+ * upload needs to be done in the compositor thread. */
+typedef struct _HdImageRequest HdImageRequest;
+
+/* Transforms the decoded @pixbuf in the worker thread, consuming it.
+ * Must not touch Clutter or anything else that isn't thread-safe. */
+typedef GdkPixbuf *(*HdImageScaleFunc) (GdkPixbuf *pixbuf, gint width,
+                                        gint height, gpointer data);
+
+/* Called in the main loop with the final image or %NULL on error.
+ * The callee owns @pixbuf. */
+typedef void (*HdImageLoadedFunc) (GdkPixbuf *pixbuf, gpointer data);
+
+HdImageRequest *hd_image_loader_load (const gchar       *fname,
+                                      gint               width,
+                                      gint               height,
+                                      HdImageScaleFunc   scale,
+                                      HdImageLoadedFunc  done,
+                                      gpointer           data);
+void hd_image_loader_cancel (HdImageRequest *request);
+
+#endif
@@ -0,0 +1,72 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * The recent pointer motion, kept in a ring so that those who only see
+ * the motion events left after compression can still tell how the
+ * pointer has got there.
+ */
+
+#include <glib.h>
+
+#include "hd-motion-history.h"
+
+/* @motion_history_count is the number of samples ever added, so the
+ * latest one is at (count-1) % LEN. */
+static HdMotionSample motion_history[HD_MOTION_HISTORY_LEN];
+static unsigned motion_history_count;
+
+void hd_motion_history_add(int x, int y, Time time)
+{
+	HdMotionSample *sample;
+
+	sample = &motion_history[motion_history_count++ % HD_MOTION_HISTORY_LEN];
+	sample->x = x;
+	sample->y = y;
+	sample->time = time;
+}
+
+unsigned hd_motion_history_get(Time since, Time until,
+			       HdMotionSample *samples, unsigned n)
+{
+	unsigned first, last, i;
+
+	/* Find the samples in the ring which are newer than @since
+	 * and older than @until.  Times are compared modulo 2^32. */
+	first = last = motion_history_count;
+	while (first > 0
+	       && motion_history_count - first < HD_MOTION_HISTORY_LEN) {
+		const HdMotionSample *sample =
+			&motion_history[(first - 1) % HD_MOTION_HISTORY_LEN];
+
+		if ((gint32)(sample->time - since) <= 0)
+			break;
+		if ((gint32)(sample->time - until) >= 0)
+			last = first - 1;
+		first--;
+	}
+
+	if (last - first > n)
+		first = last - n;
+	for (i = first; i < last; i++)
+		*samples++ = motion_history[i % HD_MOTION_HISTORY_LEN];
+	return last - first;
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_MOTION_HISTORY_H__
+#define __HD_MOTION_HISTORY_H__
+
+#include <X11/X.h>
+
+/* A pointer position in root window coordinates, which are the stage's. */
+typedef struct {
+	int x, y;
+	Time time;
+} HdMotionSample;
+
+/* The number of samples kept, the latest ones. */
+#define HD_MOTION_HISTORY_LEN 64
+
+/* Records the pointer at @x, @y at @time. */
+void hd_motion_history_add(int x, int y, Time time);
+
+/* Copies the recorded samples which came after @since and before @until
+ * into @samples, oldest first.  Returns the number of samples copied,
+ * at most the latest @n. */
+unsigned hd_motion_history_get(Time since, Time until,
+			       HdMotionSample *samples, unsigned n);
+
+#endif
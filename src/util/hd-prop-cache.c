@@ -0,0 +1,242 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#include <string.h>
+#include <X11/Xatom.h>
+
+#include "hd-prop-cache.h"
+
+/* A property of a window, either being requested or received. */
+typedef struct
+{
+  Atom           atom;
+
+  /* The request, while @pending. */
+  MBWMCookie     cookie;
+  gboolean       pending;
+  /* Whether the property has changed since it was requested,
+   * so the reply should be thrown away. */
+  gboolean       stale;
+
+  /* The reply.  @type is %None if the window doesn't have it or
+   * it couldn't be fetched. */
+  Atom           type;
+  gint           format;
+  unsigned long  n_items;
+  unsigned char *data;
+} HdPropCacheEntry;
+
+/* Window -> #GArray of #HdPropCacheEntry:s.  They're few per window,
+ * so they're looked up linearly. */
+static GHashTable *windows;
+
+static GArray *
+hd_prop_cache_lookup_window (Window xwin, gboolean create)
+{
+  GArray *entries;
+
+  if (!windows)
+    {
+      if (!create)
+        return NULL;
+      windows = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
+
+  entries = g_hash_table_lookup (windows, GUINT_TO_POINTER (xwin));
+  if (!entries && create)
+    {
+      entries = g_array_new (FALSE, FALSE, sizeof (HdPropCacheEntry));
+      g_hash_table_insert (windows, GUINT_TO_POINTER (xwin), entries);
+    }
+  return entries;
+}
+
+static HdPropCacheEntry *
+hd_prop_cache_lookup (GArray *entries, Atom atom)
+{
+  guint i;
+
+  for (i = 0; i < entries->len; i++)
+    if (g_array_index (entries, HdPropCacheEntry, i).atom == atom)
+      return &g_array_index (entries, HdPropCacheEntry, i);
+  return NULL;
+}
+
+static void
+hd_prop_cache_request (MBWindowManager *wm, Window xwin,
+                       HdPropCacheEntry *entry)
+{
+  entry->cookie = mb_wm_property_req (wm, xwin, entry->atom,
+                                      0, G_MAXLONG, False, AnyPropertyType);
+  entry->pending = TRUE;
+  entry->stale = FALSE;
+}
+
+/* Waits for the reply of @entry if it's pending. */
+static void
+hd_prop_cache_collect (MBWindowManager *wm, HdPropCacheEntry *entry)
+{
+  unsigned long bytes_after;
+  int x_error;
+
+  if (!entry->pending)
+    return;
+
+  entry->type = None;
+  entry->data = NULL;
+  x_error = 0;
+  mb_wm_property_reply (wm, entry->cookie, &entry->type, &entry->format,
+                        &entry->n_items, &bytes_after, &entry->data,
+                        &x_error);
+  entry->pending = FALSE;
+
+  if (x_error || !entry->data)
+    {
+      if (entry->data)
+        XFree (entry->data);
+      entry->type = None;
+      entry->data = NULL;
+    }
+}
+
+static void
+hd_prop_cache_clear (MBWindowManager *wm, HdPropCacheEntry *entry)
+{
+  /* The reply has to be taken off the queue either way. */
+  hd_prop_cache_collect (wm, entry);
+  if (entry->data)
+    XFree (entry->data);
+  entry->type = None;
+  entry->data = NULL;
+}
+
+void
+hd_prop_cache_prefetch (MBWindowManager *wm, Window xwin,
+                        const Atom *atoms, guint n_atoms)
+{
+  GArray *entries;
+  guint i;
+
+  entries = hd_prop_cache_lookup_window (xwin, TRUE);
+  for (i = 0; i < n_atoms; i++)
+    {
+      HdPropCacheEntry entry;
+
+      if (hd_prop_cache_lookup (entries, atoms[i]))
+        continue;
+
+      memset (&entry, 0, sizeof (entry));
+      entry.atom = atoms[i];
+      hd_prop_cache_request (wm, xwin, &entry);
+      g_array_append_val (entries, entry);
+    }
+}
+
+const void *
+hd_prop_cache_get (MBWindowManager *wm, Window xwin, Atom atom, Atom type,
+                   gint expected_format, gint expected_n_items,
+                   gint *n_items_ret)
+{
+  HdPropCacheEntry *entry;
+  GArray *entries;
+
+  entries = hd_prop_cache_lookup_window (xwin, TRUE);
+  if (!(entry = hd_prop_cache_lookup (entries, atom)))
+    {
+      hd_prop_cache_prefetch (wm, xwin, &atom, 1);
+      entry = hd_prop_cache_lookup (entries, atom);
+    }
+  else if (entry->stale)
+    {
+      hd_prop_cache_clear (wm, entry);
+      hd_prop_cache_request (wm, xwin, entry);
+    }
+  hd_prop_cache_collect (wm, entry);
+
+  if (!entry->data)
+    return NULL;
+  if (type != AnyPropertyType && entry->type != type)
+    return NULL;
+  if (expected_format && entry->format != expected_format)
+    return NULL;
+  if (expected_n_items && entry->n_items != expected_n_items)
+    return NULL;
+
+  if (n_items_ret)
+    *n_items_ret = entry->n_items;
+  return entry->data;
+}
+
+const char *
+hd_prop_cache_get_string (MBWindowManager *wm, Window xwin, Atom atom)
+{
+  return hd_prop_cache_get (wm, xwin, atom, XA_STRING, 8, 0, NULL);
+}
+
+gboolean
+hd_prop_cache_get_class_hint (MBWindowManager *wm, Window xwin,
+                              const char **res_name, const char **res_class)
+{
+  const char *hint;
+  gint len, name_len;
+
+  *res_name = *res_class = NULL;
+  if (!(hint = hd_prop_cache_get (wm, xwin, XA_WM_CLASS, XA_STRING, 8, 0,
+                                  &len)))
+    return FALSE;
+
+  /* "res_name\0res_class\0", although the class may be missing.
+   * There's always a terminating zero after the data. */
+  *res_name = hint;
+  name_len = strlen (hint);
+  if (name_len + 1 < len)
+    *res_class = hint + name_len + 1;
+  return TRUE;
+}
+
+void
+hd_prop_cache_invalidate (Window xwin, Atom atom)
+{
+  HdPropCacheEntry *entry;
+  GArray *entries;
+
+  /* Leave it to the next hd_prop_cache_get() to clear, because we
+   * may need to wait for a pending reply. */
+  if ((entries = hd_prop_cache_lookup_window (xwin, FALSE)) != NULL
+      && (entry = hd_prop_cache_lookup (entries, atom)) != NULL)
+    entry->stale = TRUE;
+}
+
+void
+hd_prop_cache_forget (MBWindowManager *wm, Window xwin)
+{
+  GArray *entries;
+  guint i;
+
+  if (!(entries = hd_prop_cache_lookup_window (xwin, FALSE)))
+    return;
+
+  for (i = 0; i < entries->len; i++)
+    hd_prop_cache_clear (wm, &g_array_index (entries, HdPropCacheEntry, i));
+  g_array_free (entries, TRUE);
+  g_hash_table_remove (windows, GUINT_TO_POINTER (xwin));
+}
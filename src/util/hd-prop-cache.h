@@ -0,0 +1,69 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef __HD_PROP_CACHE_H__
+#define __HD_PROP_CACHE_H__
+
+#include <X11/Xlib.h>
+#include <glib.h>
+#include <matchbox/core/mb-wm.h>
+
+/*
+ * A cache of the X properties of client windows.  When a window is first
+ * seen all the properties we're going to look at are requested at once,
+ * without waiting for the replies, which are only collected when one of
+ * them is needed.  After that the values are kept until a #PropertyNotify
+ * says they have changed.  Only use it for windows which are or are
+ * going to be managed clients: their #PropertyNotify:s are selected by
+ * matchbox, and the cache is dropped when the client is destroyed.
+ */
+
+/* Requests the @n_atoms @atoms of @xwin asynchronously, unless they're
+ * already cached or requested. */
+void         hd_prop_cache_prefetch   (MBWindowManager *wm, Window xwin,
+                                       const Atom *atoms, guint n_atoms);
+
+/* Returns the @atom property of @xwin like
+ * hd_util_get_win_prop_data_and_validate(), fetching it if it's not
+ * cached.  The data belongs to the cache and remains valid until the
+ * property changes. */
+const void  *hd_prop_cache_get        (MBWindowManager *wm, Window xwin,
+                                       Atom atom, Atom type,
+                                       gint expected_format,
+                                       gint expected_n_items,
+                                       gint *n_items_ret);
+/* Returns the @atom string property of @xwin or %NULL. */
+const char  *hd_prop_cache_get_string (MBWindowManager *wm, Window xwin,
+                                       Atom atom);
+
+/* Returns the two halves of the WM_CLASS of @xwin like XGetClassHint(),
+ * but they belong to the cache.  Returns whether it has got one. */
+gboolean     hd_prop_cache_get_class_hint (MBWindowManager *wm, Window xwin,
+                                           const char **res_name,
+                                           const char **res_class);
+
+/* Called on #PropertyNotify. */
+void         hd_prop_cache_invalidate (Window xwin, Atom atom);
+/* Drops everything cached for @xwin. */
+void         hd_prop_cache_forget     (MBWindowManager *wm, Window xwin);
+
+#endif
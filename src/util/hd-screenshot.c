@@ -0,0 +1,360 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <clutter/clutter.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <matchbox/core/mb-wm.h>
+#include <libhildondesktop/hd-pvr-texture.h>
+
+#include "hildon-desktop.h"
+#include "hd-screenshot.h"
+
+/*
+ * A screenshot on its way to the disk.  The main thread fills in
+ * everything but @isok, then it belongs to the worker until it's
+ * handed back in the main loop.  @pixels is either an XShm segment
+ * or memory from Xlib, as @is_shm tells.
+ */
+typedef struct
+{
+  gchar                 *fname;
+  guchar                *pixels;
+  gboolean               is_shm, swap;
+  guint                  width, height, stride, bpp;
+  gulong                 masks[3];
+
+  HdScreenshotSavedFunc  done;
+  gpointer               data;
+  gboolean               isok;
+} HdScreenshot;
+
+/* The worker writing the files.  One is enough, they don't come often. */
+static GThreadPool *saver_pool;
+
+/* The target file names being worked on, to refuse duplicates. */
+static GHashTable *pending;
+
+static void
+hd_screenshot_free (HdScreenshot *shot)
+{
+  if (shot->pixels)
+    {
+      if (shot->is_shm)
+        shmdt (shot->pixels);
+      else
+        XFree (shot->pixels);
+    }
+  g_free (shot->fname);
+  g_slice_free (HdScreenshot, shot);
+}
+
+/* Takes the pixel data of @img for @shot. */
+static void
+steal_image (HdScreenshot *shot, XImage *img)
+{
+  shot->pixels = (guchar *)img->data;
+  img->data = NULL;
+
+  shot->width  = img->width;
+  shot->height = img->height;
+  shot->stride = img->bytes_per_line;
+  shot->bpp    = img->bits_per_pixel;
+  shot->swap   = (img->byte_order == MSBFirst)
+    != (G_BYTE_ORDER == G_BIG_ENDIAN);
+
+  /* The visual may not be the pixmap's, but the layout is the usual. */
+  if (img->red_mask && img->depth <= 24)
+    {
+      shot->masks[0] = img->red_mask;
+      shot->masks[1] = img->green_mask;
+      shot->masks[2] = img->blue_mask;
+    }
+  else if (img->depth == 16)
+    {
+      shot->masks[0] = 0xf800;
+      shot->masks[1] = 0x07e0;
+      shot->masks[2] = 0x001f;
+    }
+  else
+    {
+      shot->masks[0] = 0xff0000;
+      shot->masks[1] = 0x00ff00;
+      shot->masks[2] = 0x0000ff;
+    }
+}
+
+/* Reads @pixmap into a fresh shared memory segment, which only needs
+ * a single request and no copying through the socket. */
+static gboolean
+capture_shm (Display *dpy, Pixmap pixmap, guint width, guint height,
+             guint depth, HdScreenshot *shot)
+{
+  XShmSegmentInfo shminfo;
+  XImage *img;
+  gboolean isok;
+
+  img = XShmCreateImage (dpy, DefaultVisual (dpy, DefaultScreen (dpy)),
+                         depth, ZPixmap, NULL, &shminfo, width, height);
+  if (!img)
+    return FALSE;
+
+  shminfo.shmid = shmget (IPC_PRIVATE, img->bytes_per_line * img->height,
+                          IPC_CREAT | 0600);
+  if (shminfo.shmid < 0)
+    {
+      XDestroyImage (img);
+      return FALSE;
+    }
+
+  shminfo.shmaddr = img->data = shmat (shminfo.shmid, NULL, 0);
+  if (shminfo.shmaddr == (void *)-1)
+    {
+      shmctl (shminfo.shmid, IPC_RMID, NULL);
+      img->data = NULL;
+      XDestroyImage (img);
+      return FALSE;
+    }
+  shminfo.readOnly = False;
+
+  mb_wm_util_async_trap_x_errors (dpy);
+  isok = XShmAttach (dpy, &shminfo)
+    && XShmGetImage (dpy, pixmap, img, 0, 0, AllPlanes);
+  XShmDetach (dpy, &shminfo);
+  XSync (dpy, False);
+  if (mb_wm_util_async_untrap_x_errors ())
+    isok = FALSE;
+
+  /* The server has let go of it, so it'll be gone when we shmdt(). */
+  shmctl (shminfo.shmid, IPC_RMID, NULL);
+
+  if (isok)
+    {
+      steal_image (shot, img);
+      shot->is_shm = TRUE;
+    }
+  else
+    {
+      shmdt (shminfo.shmaddr);
+      img->data = NULL;
+    }
+
+  XDestroyImage (img);
+  return isok;
+}
+
+/* The fallback if the server can't do XShm. */
+static gboolean
+capture_plain (Display *dpy, Pixmap pixmap, guint width, guint height,
+               HdScreenshot *shot)
+{
+  XImage *img;
+
+  mb_wm_util_async_trap_x_errors (dpy);
+  img = XGetImage (dpy, pixmap, 0, 0, width, height, AllPlanes, ZPixmap);
+  mb_wm_util_async_untrap_x_errors ();
+  if (!img)
+    return FALSE;
+
+  steal_image (shot, img);
+  shot->is_shm = FALSE;
+  XDestroyImage (img);
+  return TRUE;
+}
+
+/* Returns how much to shift a pixel right to get @mask's channel
+ * to the bottom and how wide it is. */
+static void
+mask_shift (gulong mask, guint *shift, guint *bits)
+{
+  for (*shift = 0; mask && !(mask & 1); mask >>= 1)
+    (*shift)++;
+  for (*bits = 0; mask & 1; mask >>= 1)
+    (*bits)++;
+}
+
+/* Converts @shot to an RGB pixbuf, or returns %NULL if it's in
+ * a format we don't understand. */
+static GdkPixbuf *
+screenshot_to_pixbuf (const HdScreenshot *shot)
+{
+  GdkPixbuf *pixbuf;
+  guint shift[3], bits[3];
+  guint x, y, c, rowstride;
+  guchar *dst;
+
+  if (shot->bpp != 16 && shot->bpp != 32)
+    return NULL;
+  for (c = 0; c < 3; c++)
+    {
+      mask_shift (shot->masks[c], &shift[c], &bits[c]);
+      if (bits[c] < 4 || bits[c] > 8)
+        return NULL;
+    }
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8,
+                           shot->width, shot->height);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  dst = gdk_pixbuf_get_pixels (pixbuf);
+
+  for (y = 0; y < shot->height; y++)
+    {
+      const guchar *src = shot->pixels + y * shot->stride;
+      guchar *out = dst + y * rowstride;
+
+      for (x = 0; x < shot->width; x++)
+        {
+          guint32 pixel;
+
+          if (shot->bpp == 16)
+            {
+              pixel = ((const guint16 *)src)[x];
+              if (shot->swap)
+                pixel = GUINT16_SWAP_LE_BE (pixel);
+            }
+          else
+            {
+              pixel = ((const guint32 *)src)[x];
+              if (shot->swap)
+                pixel = GUINT32_SWAP_LE_BE (pixel);
+            }
+
+          /* Widen each channel to 8 bits by replicating its top bits. */
+          for (c = 0; c < 3; c++)
+            {
+              guint v = (pixel & shot->masks[c]) >> shift[c];
+              *out++ = (v << (8 - bits[c])) | (v >> (2 * bits[c] - 8));
+            }
+        }
+    }
+
+  return pixbuf;
+}
+
+/* Hands @shot back to its owner in the main loop. */
+static gboolean
+hd_screenshot_deliver (HdScreenshot *shot)
+{
+  g_hash_table_remove (pending, shot->fname);
+  shot->done (shot->isok, shot->data);
+  hd_screenshot_free (shot);
+  return FALSE;
+}
+
+/* @saver_pool's worker.  The file is written under a temporary name
+ * and renamed in place, so a half-written one is never picked up. */
+static void
+hd_screenshot_work (HdScreenshot *shot, gpointer unused)
+{
+  GdkPixbuf *pixbuf;
+  gchar *tmpname;
+
+  if (!(pixbuf = screenshot_to_pixbuf (shot)))
+    {
+      g_warning ("%s: unsupported %ubpp pixmap format", shot->fname,
+                 shot->bpp);
+      goto out;
+    }
+
+  /* We're done with the pixels, let them go as soon as possible. */
+  if (shot->is_shm)
+    shmdt (shot->pixels);
+  else
+    XFree (shot->pixels);
+  shot->pixels = NULL;
+
+  tmpname = g_strconcat (shot->fname, ".tmp", NULL);
+  if (hd_pvr_texture_save (tmpname, pixbuf, NULL))
+    {
+      if (!(shot->isok = rename (tmpname, shot->fname) == 0))
+        unlink (tmpname);
+    }
+  else
+    unlink (tmpname);
+  g_free (tmpname);
+  g_object_unref (pixbuf);
+
+out:
+  clutter_threads_add_idle ((GSourceFunc)hd_screenshot_deliver, shot);
+}
+
+/*
+ * Reads the @width x @height contents of @pixmap of @depth and saves it
+ * as a PVR texture to @fname.  Only the readback (with XShm if possible)
+ * is done here, the rest happens in a worker thread, then @done is called
+ * with @data in the main loop.  Returns %FALSE without calling @done if
+ * @pixmap couldn't be read or @fname is already being written.
+ */
+gboolean
+hd_screenshot_save_pixmap (Display               *dpy,
+                           Pixmap                 pixmap,
+                           guint                  width,
+                           guint                  height,
+                           guint                  depth,
+                           const gchar           *fname,
+                           HdScreenshotSavedFunc  done,
+                           gpointer               data)
+{
+  static gint has_shm = -1;
+  HdScreenshot *shot;
+
+  g_return_val_if_fail (fname && done, FALSE);
+
+  if (G_UNLIKELY (!pending))
+    pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  if (g_hash_table_lookup (pending, fname))
+    return FALSE;
+
+  if (has_shm < 0)
+    has_shm = XShmQueryExtension (dpy);
+
+  shot = g_slice_new0 (HdScreenshot);
+  if (!(has_shm && capture_shm (dpy, pixmap, width, height, depth, shot))
+      && !capture_plain (dpy, pixmap, width, height, shot))
+    {
+      g_warning ("%s: couldn't read pixmap 0x%lx", fname, pixmap);
+      hd_screenshot_free (shot);
+      return FALSE;
+    }
+
+  shot->fname = g_strdup (fname);
+  shot->done  = done;
+  shot->data  = data;
+  g_hash_table_insert (pending, g_strdup (fname), GINT_TO_POINTER (TRUE));
+
+  if (hd_disable_threads ())
+    hd_screenshot_work (shot, NULL);
+  else
+    {
+      if (G_UNLIKELY (!saver_pool))
+        saver_pool = g_thread_pool_new ((GFunc)hd_screenshot_work, NULL,
+                                        1, FALSE, NULL);
+      g_thread_pool_push (saver_pool, shot, NULL);
+    }
+
+  return TRUE;
+}
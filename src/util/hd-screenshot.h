@@ -0,0 +1,44 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_SCREENSHOT_H__
+#define __HD_SCREENSHOT_H__
+
+#include <glib.h>
+#include <X11/Xlib.h>
+
+/* Saving the contents of pixmaps as PVR textures.  Only grabbing the
+ * pixels is done in the main thread, converting and writing them out
+ * is left to a worker. */
+
+/* Called in the main loop when the file is in place or failed to be. */
+typedef void (*HdScreenshotSavedFunc) (gboolean isok, gpointer data);
+
+gboolean hd_screenshot_save_pixmap (Display               *dpy,
+                                    Pixmap                 pixmap,
+                                    guint                  width,
+                                    guint                  height,
+                                    guint                  depth,
+                                    const gchar           *fname,
+                                    HdScreenshotSavedFunc  done,
+                                    gpointer               data);
+
+#endif
@@ -47,16 +47,31 @@
 #include "hd-app.h"
 #include "hd-volume-profile.h"
 #include "hd-util.h"
+#include "hd-hptimer.h"
+#include "hd-curve.h"
 #include "hd-dbus.h"
 
 /* The master of puppets */
 #define TRANSITIONS_INI             "/usr/share/hildon-desktop/transitions.ini"
 #define TRANSITIONS_INI_FROM_THEME  "/etc/hildon/theme/transitions.ini"
 
-typedef struct _HDEffectData
+typedef struct _HDEffectData HDEffectData;
+
+/* An effect's frame function, called every tick of the scheduler while
+ * the effect is running with its @progress from 0 to 1.  The last call
+ * is with exactly 1. */
+typedef void (*HdTransitionFrameFunc)(HDEffectData *data, float progress);
+
+struct _HDEffectData
 {
   MBWMCompMgrClientEvent   event;
-  ClutterTimeline          *timeline;
+  /* Set by hd_transition_schedule(). */
+  HdTransitionFrameFunc     frame_func;
+  guint                     duration;
+  gdouble                   start;
+  /* Called with @finished_callback_data after the effect completed. */
+  GCallback                 finished_callback;
+  gpointer                  finished_callback_data;
   MBWMCompMgrClutterClient *cclient;
   ClutterActor             *cclient_actor;
   /* In subview transitions, this is the ORIGINAL (non-subview) view */
@@ -74,24 +89,7 @@ typedef struct _HDEffectData
   /* In Fade effects, final_alpha specifies the alpha value when the
    * window/note if fully faded in. */
   float                     final_alpha;
-} HDEffectData;
-
-/* %HPTimer %GSource state. */
-typedef struct
-{
-  /*
-   * @id:         the %GSource id of the source
-   * @last:       the last time the source was evaluated
-   * @remaining:  at the last evaluation of the source how many
-   *              milisecons were until @expiry
-   * @expiry:     the expiration time in miliseconds this %HPTimer
-   *              was created with
-   */
-  GSource parent;
-  guint id;
-  GTimeVal last;
-  unsigned remaining, expiry;
-} HPTimer;
+};
 
 /* Describes the state of hd_transition_rotating_fsm(). */
 static struct
@@ -161,7 +159,7 @@ static struct
   /* In the WAITING state we have a timer that calls us back a few ms
    * after the last damage event. This is the id, as we need to restart
    * it whenever we get another damage event. */
-  HPTimer *timeout_id;
+  HdHPTimer *timeout_id;
 
   /* This timer counts from when we first entered the WAITING state,
    * so if we are continually getting damage we don't just hang there. */
@@ -186,118 +184,100 @@ static guint Transitions_running;
  * and we can watch it. */
 static gboolean transitions_ini_is_dirty;
 
+/* A value in transitions.ini, parsed as everything it can be. */
+typedef struct
+{
+  gchar    *string;
+  gint      int_val;
+  gdouble   double_val;
+  gboolean  is_int, is_double;
+  /* @string as a curve once somebody has asked for it. */
+  HdCurve  *curve;
+} HdTransitionValue;
+
+/* transitions.ini as it was last loaded: a hash table of the groups,
+ * each a hash table of its keys' HdTransitionValue:s. */
+static GHashTable *transitions_ini;
+
+/* Called after transitions.ini has been reloaded. */
+static GHookList transitions_ini_hooks;
+
+/* The idle reloading transitions.ini after it's changed. */
+static guint transitions_ini_reload_id;
+
 /* ------------------------------------------------------------------------- */
 /* ------------------------------------------------------------------------- */
 /* ------------------------------------------------------------------------- */
 
-/* Seeing the time elapsed since @hptimer's @last evaluation update
- * the @remaining number of miliseconds until expiry. */
-static void
-hptimer_calc_remaining(HPTimer *hptimer)
+/* The easing curves below, sampled into @curves by
+ * hd_transition_init_curves(), so that they needn't be calculated
+ * every frame for every actor. */
+enum
 {
-  guint diff;
-  GTimeVal now;
+  CURVE_OVERSHOOT,
+  CURVE_SMOOTH_RAMP,
+  CURVE_EASE_IN,
+  CURVE_EASE_OUT,
+  N_CURVES,
+};
 
-  /* Don't use g_source_get_current_time()s cached clock,
-   * it may be inaccurate by now. */
-  g_get_current_time (&now);
+static HdCurve *curves[N_CURVES];
 
-  /* Yes we don't handle time going back. */
-  diff = (now.tv_sec - hptimer->last.tv_sec) * 1000;
-  if (now.tv_usec < hptimer->last.tv_usec)
-    {
-      diff -= 1000;
-      diff += ((1000000 - hptimer->last.tv_usec) + now.tv_usec) / 1000;
-    } else
-      diff += (now.tv_usec - hptimer->last.tv_usec) / 1000;
-
-  if (hptimer->remaining > diff)
-    hptimer->remaining -= diff;
-  else
-    hptimer->remaining  = 0;
-
-  hptimer->last = now;
+/* amt goes from 0->1, and the result goes mostly from 0->1 with a bit of
+ * overshoot at the end */
+static float
+curve_overshoot(float amt)
+{
+  float smooth_ramp, converge;
+  smooth_ramp = 1.0f - cos(amt*3.141592); // 0 <= smooth_ramp <= 2
+  converge = sin(0.5*3.141592*(1-amt)); // 0 <= converve <= 1
+  return (smooth_ramp*0.675)*converge + (1-converge);
 }
 
-static gboolean
-hptimer_source_prepare(GSource *src, gint *timeout)
+/* amt goes from 0->1, and the result goes from 0->1 smoothly */
+static float
+curve_smooth_ramp(float amt)
 {
-  HPTimer *hptimer = (HPTimer *)src;
-
-  hptimer_calc_remaining (hptimer);
-  return (*timeout = hptimer->remaining) == 0;
+  return (1.0f - cos(amt*3.141592)) * 0.5f;
 }
 
-static gboolean
-hptimer_source_check(GSource *src)
+static float
+curve_ease_in(float amt)
 {
-  HPTimer *hptimer = (HPTimer *)src;
-
-  hptimer_calc_remaining (hptimer);
-  return hptimer->remaining == 0;
+  return (1.0f - cos(amt*3.141592*0.5));
 }
 
-static gboolean
-hptimer_source_dispatch(GSource *src, GSourceFunc cb, gpointer cbarg)
+static float
+curve_ease_out(float amt)
 {
-  HPTimer *hptimer = (HPTimer *)src;
-
-  hptimer->remaining = hptimer->expiry;
-  return cb (cbarg);
+  return cos((1-amt)*3.141592*0.5);
 }
 
-/*
- * Returns a "high performance" timer, which is similar to an ordinary
- * %GTimeoutSource but may be better suited for short @expiry:s in
- * the sub-100th-second range.  You're free to change the %HPTimer's
- * @remaining and @expiry states.
- */
-static HPTimer *
-hptimer_new(unsigned expiry,
-            GSourceFunc cb, gpointer cbarg, GDestroyNotify dtor)
+static void
+hd_transition_init_curves(void)
 {
-  static GSourceFuncs hptimer_funcs =
-  {
-    hptimer_source_prepare,
-    hptimer_source_check,
-    hptimer_source_dispatch
-  };
-
-  HPTimer *hptimer;
-  GSource *src;
-  guint id;
-
-  src = g_source_new (&hptimer_funcs, sizeof (*hptimer));
-  g_source_set_callback (src, cb, cbarg, dtor);
-  g_source_set_priority (src, G_PRIORITY_HIGH);
-  id = g_source_attach (src, NULL);
-  g_source_unref (src);
-
-  hptimer = (HPTimer *)src;
-  hptimer->id = id;
-  g_get_current_time (&hptimer->last);
-  hptimer->remaining = hptimer->expiry = expiry;
-
-  return hptimer;
+  curves[CURVE_OVERSHOOT]   = hd_curve_new_from_func(curve_overshoot);
+  curves[CURVE_SMOOTH_RAMP] = hd_curve_new_from_func(curve_smooth_ramp);
+  curves[CURVE_EASE_IN]     = hd_curve_new_from_func(curve_ease_in);
+  curves[CURVE_EASE_OUT]    = hd_curve_new_from_func(curve_ease_out);
 }
 
-/* ------------------------------------------------------------------------- */
-/* ------------------------------------------------------------------------- */
-/* ------------------------------------------------------------------------- */
+static inline float
+hd_transition_curve(guint which, float amt)
+{
+  if (G_UNLIKELY(!curves[which]))
+    hd_transition_init_curves();
+  return hd_curve_get(curves[which], amt);
+}
 
 /* amt goes from 0->1, and the result goes mostly from 0->1 with a bit of
- * overshoot at the end */
+ * overshoot at the end.  Every whole @x adds one to it. */
 float
 hd_transition_overshoot(float x)
 {
-  float smooth_ramp, converge;
-  float amt;
   int offset;
   offset = (int)x;
-  amt = x-offset;
-  smooth_ramp = 1.0f - cos(amt*3.141592); // 0 <= smooth_ramp <= 2
-  converge = sin(0.5*3.141592*(1-amt)); // 0 <= converve <= 1
-  return offset + (smooth_ramp*0.675)*converge + (1-converge);
+  return offset + hd_transition_curve(CURVE_OVERSHOOT, x-offset);
 }
 
 /* amt goes from 0->1, and the result goes from 0->1 smoothly */
@@ -305,7 +285,7 @@ float
 hd_transition_smooth_ramp(float amt)
 {
   if (amt>0 && amt<1)
-    return (1.0f - cos(amt*3.141592)) * 0.5f;
+    return hd_transition_curve(CURVE_SMOOTH_RAMP, amt);
   return amt;
 }
 
@@ -313,7 +293,7 @@ float
 hd_transition_ease_in(float amt)
 {
   if (amt>0 && amt<1)
-    return (1.0f - cos(amt*3.141592*0.5));
+    return hd_transition_curve(CURVE_EASE_IN, amt);
   return amt;
 }
 
@@ -321,7 +301,7 @@ float
 hd_transition_ease_out(float amt)
 {
   if (amt>0 && amt<1)
-    return cos((1-amt)*3.141592*0.5);
+    return hd_transition_curve(CURVE_EASE_OUT, amt);
   return amt;
 }
 
@@ -329,15 +309,14 @@ hd_transition_ease_out(float amt)
 /* ------------------------------------------------------------------------- */
 /* ------------------------------------------------------------------------- */
 
-static ClutterTimeline *
-hd_transition_timeline_new(const gchar *transition,
+static gint
+hd_transition_get_duration(const gchar *transition,
                            MBWMCompMgrClientEvent event,
                            gint default_length)
 {
   const char *key =
     event==MBWMCompMgrClientEventMap ?"duration_in":"duration_out";
-  return clutter_timeline_new_for_duration (
-      hd_transition_get_int(transition, key, default_length) );
+  return hd_transition_get_int(transition, key, default_length);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -374,8 +353,7 @@ on_decor_progress_timeline_new_frame(ClutterTimeline *timeline,
 }
 
 static void
-on_popup_timeline_new_frame(ClutterTimeline *timeline,
-                            gint frame_num, HDEffectData *data)
+on_popup_frame(HDEffectData *data, float progress)
 {
   float amt;
   ClutterActor *actor, *filler;
@@ -399,7 +377,7 @@ on_popup_timeline_new_frame(ClutterTimeline *timeline,
   pop_bottom = geo.y+geo.height==hd_comp_mgr_get_current_screen_height();
   if (pop_top && pop_bottom)
     pop_top = FALSE;
-  amt =  (float)clutter_timeline_get_progress(timeline);
+  amt = progress;
   /* reverse if we're removing this */
   if (data->event == MBWMCompMgrClientEventUnmap)
     amt = 1-amt;
@@ -457,8 +435,7 @@ on_popup_timeline_new_frame(ClutterTimeline *timeline,
 }
 
 static void
-on_fade_timeline_new_frame(ClutterTimeline *timeline,
-                            gint frame_num, HDEffectData *data)
+on_fade_frame(HDEffectData *data, float progress)
 {
   float amt, ramt;
   gint alpha;
@@ -478,7 +455,7 @@ on_fade_timeline_new_frame(ClutterTimeline *timeline,
       return;
     }
 
-  amt =  (float)clutter_timeline_get_progress(timeline);
+  amt = progress;
   /* reverse if we're removing this */
   if (data->event == MBWMCompMgrClientEventUnmap)
     amt = 1-amt;
@@ -495,8 +472,7 @@ on_fade_timeline_new_frame(ClutterTimeline *timeline,
 }
 
 static void
-on_close_timeline_new_frame(ClutterTimeline *timeline,
-                            gint frame_num, HDEffectData *data)
+on_close_frame(HDEffectData *data, float progress)
 {
   float amt;
   ClutterActor *actor;
@@ -518,7 +494,7 @@ on_close_timeline_new_frame(ClutterTimeline *timeline,
       return;
     }
 
-  amt = (float)clutter_timeline_get_progress(timeline);
+  amt = progress;
 
   amtx = 1.6 - amt*2.5; // shrink in x
   amty = 1 - amt*2.5; // shrink in y
@@ -580,8 +556,7 @@ bezier(float t, float p0, float p1, float p2, float p3)
 }
 
 static void
-on_notification_timeline_new_frame(ClutterTimeline *timeline,
-                                   gint frame_num, HDEffectData *data)
+on_notification_frame(HDEffectData *data, float progress)
 {
   float now;
   ClutterActor *actor;
@@ -596,7 +571,7 @@ on_notification_timeline_new_frame(ClutterTimeline *timeline,
                         HD_TITLE_BAR(hd_render_manager_get_title_bar()));
   clutter_actor_get_size(actor, &width, &height);
   clutter_actor_get_position(actor, &px, &py);
-  now = frame_num / (float)clutter_timeline_get_n_frames(timeline);
+  now = progress;
 
   if (hd_comp_mgr_is_portrait()
       && hd_transition_get_int("notification", "is_cool", 0))
@@ -622,15 +597,36 @@ on_notification_timeline_new_frame(ClutterTimeline *timeline,
         { -478, -32 },
         { -478, -88 },
       }, *curve;
+      /* The x and y of the curves along the smooth ramp, opening and
+       * closing, sampled once. */
+      static HdCurve *path[2][2];
+      guint i;
+
+      if (G_UNLIKELY(!path[0][0]))
+        for (i = 0; i < 2; i++)
+          {
+            float xs[HD_CURVE_RESOLUTION+1], ys[HD_CURVE_RESOLUTION+1];
+            guint j;
+
+            curve = i ? cpout : cpin;
+            for (j = 0; j <= HD_CURVE_RESOLUTION; j++)
+              {
+                float t = curve_smooth_ramp((float)j / HD_CURVE_RESOLUTION);
 
-      /* Set the position to @curve(@now). */
-      now = hd_transition_smooth_ramp(now);
-      curve = data->event == MBWMCompMgrClientEventUnmap ? cpout : cpin;
+                xs[j] = bezier(t,
+                        curve[0].x, curve[1].x, curve[2].x, curve[3].x);
+                ys[j] = bezier(t,
+                        curve[0].y, curve[1].y, curve[2].y, curve[3].y);
+              }
+            path[i][0] = hd_curve_new_from_samples(xs, G_N_ELEMENTS(xs));
+            path[i][1] = hd_curve_new_from_samples(ys, G_N_ELEMENTS(ys));
+          }
+
+      /* Set the position to @curve(smooth_ramp(@now)) from @path. */
+      i = data->event == MBWMCompMgrClientEventUnmap;
       clutter_actor_set_anchor_pointu(actor,
-               CLUTTER_FLOAT_TO_FIXED(-bezier(now,
-                        curve[0].x, curve[1].x, curve[2].x, curve[3].x)),
-               CLUTTER_FLOAT_TO_FIXED(-bezier(now,
-                        curve[0].y, curve[1].y, curve[2].y, curve[3].y)));
+               CLUTTER_FLOAT_TO_FIXED(-hd_curve_get(path[i][0], now)),
+               CLUTTER_FLOAT_TO_FIXED(-hd_curve_get(path[i][1], now)));
 
       /* We should restore the opacity and scaling of @actor in case
        * we were switched orientation during the transition somehow
@@ -710,11 +706,9 @@ on_notification_timeline_new_frame(ClutterTimeline *timeline,
 }
 
 static void
-on_subview_timeline_new_frame(ClutterTimeline *timeline,
-                              gint frame_num, HDEffectData *data)
+on_subview_frame(HDEffectData *data, float progress)
 {
   float amt;
-  gint n_frames;
   ClutterActor *subview_actor = 0, *main_actor = 0;
 
   if (data->cclient)
@@ -722,9 +716,7 @@ on_subview_timeline_new_frame(ClutterTimeline *timeline,
   if (data->cclient2)
     main_actor = data->cclient2_actor;
 
-  n_frames = clutter_timeline_get_n_frames(timeline);
-  amt = frame_num / (float)n_frames;
-  amt = hd_transition_smooth_ramp( amt );
+  amt = hd_transition_smooth_ramp( progress );
   if (data->event == MBWMCompMgrClientEventUnmap)
     amt = 1-amt;
 
@@ -752,7 +744,7 @@ on_subview_timeline_new_frame(ClutterTimeline *timeline,
   }
 
   /* if we're at the last frame, return our actors to the correct places) */
-  if (frame_num == n_frames)
+  if (progress >= 1)
     {
       if (subview_actor)
         {
@@ -771,16 +763,13 @@ on_subview_timeline_new_frame(ClutterTimeline *timeline,
 }
 
 static void
-on_rotate_screen_timeline_new_frame(ClutterTimeline *timeline,
-                                    gint frame_num, HDEffectData *data)
+on_rotate_screen_frame(HDEffectData *data, float progress)
 {
   float amt, dim_amt, angle;
-  gint n_frames;
   gint use_zaxis = hd_transition_get_int ("thp_tweaks", "zaxisrotation", 0);
   ClutterActor *actor;
 
-  n_frames = clutter_timeline_get_n_frames(timeline);
-  amt = frame_num / (float)n_frames;
+  amt = progress;
   // we want to ease in, but speed up as we go - X^3 does this nicely
   amt = amt*amt;
   if (data->event == MBWMCompMgrClientEventUnmap)
@@ -796,7 +785,7 @@ on_rotate_screen_timeline_new_frame(ClutterTimeline *timeline,
   actor = CLUTTER_ACTOR(hd_render_manager_get());
   clutter_actor_set_rotation(actor, use_zaxis ? CLUTTER_Z_AXIS :
       (hd_comp_mgr_is_portrait () ? CLUTTER_Y_AXIS : CLUTTER_X_AXIS),
-      frame_num < n_frames ? angle : 0,
+      progress < 1 ? angle : 0,
       hd_comp_mgr_get_current_screen_width()/2,
       hd_comp_mgr_get_current_screen_height()/2, 0);
 
@@ -838,7 +827,7 @@ on_screen_size_changed (ClutterActor *stage, GParamSpec *unused,
 }
 
 static void
-hd_transition_completed (ClutterTimeline* timeline, HDEffectData *data)
+hd_transition_completed (HDEffectData *data)
 {
   gint i;
   HdCompMgr *hmgr = HD_COMP_MGR (data->hmgr);
@@ -877,9 +866,6 @@ hd_transition_completed (ClutterTimeline* timeline, HDEffectData *data)
 
 /*   dump_clutter_tree (CLUTTER_CONTAINER (clutter_stage_get_default()), 0); */
 
-  if (timeline)
-    g_object_unref ( timeline );
-
   if (hmgr)
     hd_comp_mgr_set_effect_running(hmgr, FALSE);
 
@@ -914,6 +900,172 @@ hd_transition_completed (ClutterTimeline* timeline, HDEffectData *data)
     hd_comp_mgr_reconsider_compositing (MB_WM_COMP_MGR (hmgr));
 }
 
+/* ------------------------------------------------------------------------- */
+/* ------------------------------------------------------------------------- */
+/* ------------------------------------------------------------------------- */
+
+/* Runs all the effects from a single clock, so that they're advanced
+ * at the same time with the same timestamp in one go. */
+static struct
+{
+  /* The running effects in the order they were started. */
+  GList *effects;
+  /* Ticks every frame while there are @effects. */
+  HdHPTimer *clock;
+  /* The time of the ticks. */
+  GTimer *timer;
+
+  /* See hd_transition_set_frame_budget(). */
+  guint budget_us;
+  HdTransitionBudgetFunc budget_func;
+  gpointer budget_data;
+  gboolean skip_tick;
+} Scheduler;
+
+static gboolean
+hd_transition_tick(gpointer unused)
+{
+  GList *effects, *li;
+  GPtrArray *actors;
+  gdouble now;
+  guint i, n_effects;
+
+  now = g_timer_elapsed(Scheduler.timer, NULL) * 1000;
+  if (Scheduler.skip_tick)
+    { /* The last one took too long, give the rest of the frame time. */
+      Scheduler.skip_tick = FALSE;
+      return TRUE;
+    }
+
+  /* Effects may complete, stop and start others from their callbacks,
+   * so only touch the ones still on the list. */
+  effects = g_list_copy(Scheduler.effects);
+  n_effects = g_list_length(effects);
+
+  /* Hold back property notifications until all effects have had their
+   * frame, so everyone watching an actor hears about it once a tick
+   * however many properties and effects it's got. */
+  actors = g_ptr_array_new();
+  for (li = effects; li; li = li->next)
+    {
+      HDEffectData *data = li->data;
+      ClutterActor *effect_actors[2+HDCM_UNMAP_PARTICLES];
+      guint n;
+
+      n = 0;
+      effect_actors[n++] = data->cclient_actor;
+      effect_actors[n++] = data->cclient2_actor;
+      for (i = 0; i < HDCM_UNMAP_PARTICLES; i++)
+        effect_actors[n++] = data->particles[i];
+      for (i = 0; i < n; i++)
+        if (effect_actors[i])
+          {
+            g_object_freeze_notify(G_OBJECT(effect_actors[i]));
+            g_ptr_array_add(actors, g_object_ref(effect_actors[i]));
+          }
+    }
+
+  for (li = effects; li; li = li->next)
+    {
+      HDEffectData *data = li->data;
+      float progress;
+
+      if (!g_list_find(Scheduler.effects, data))
+        continue;
+      progress = data->duration > 0
+        ? (now - data->start) / data->duration : 1;
+      data->frame_func(data, MIN(progress, 1));
+    }
+
+  for (i = 0; i < actors->len; i++)
+    {
+      g_object_thaw_notify(actors->pdata[i]);
+      g_object_unref(actors->pdata[i]);
+    }
+  g_ptr_array_free(actors, TRUE);
+
+  for (li = effects; li; li = li->next)
+    {
+      HDEffectData *data = li->data;
+      GCallback finished_callback;
+      gpointer finished_callback_data;
+
+      if (!g_list_find(Scheduler.effects, data)
+          || now - data->start < data->duration)
+        continue;
+
+      Scheduler.effects = g_list_remove(Scheduler.effects, data);
+      finished_callback = data->finished_callback;
+      finished_callback_data = data->finished_callback_data;
+      hd_transition_completed(data);
+      if (finished_callback)
+        ((void (*)(gpointer))finished_callback)(finished_callback_data);
+    }
+  g_list_free(effects);
+
+  if (Scheduler.budget_func || Scheduler.budget_us)
+    {
+      guint used_us;
+
+      used_us = g_timer_elapsed(Scheduler.timer, NULL) * 1000000
+        - now * 1000;
+      if (Scheduler.budget_func)
+        Scheduler.budget_func(used_us, n_effects, Scheduler.budget_data);
+      if (Scheduler.budget_us && used_us > Scheduler.budget_us)
+        Scheduler.skip_tick = TRUE;
+    }
+
+  if (Scheduler.effects)
+    return TRUE;
+  Scheduler.clock = NULL;
+  return FALSE;
+}
+
+/* Start running @data's effect for @duration miliseconds, calling
+ * @frame_func every tick. */
+static void
+hd_transition_schedule(HDEffectData *data, HdTransitionFrameFunc frame_func,
+                       gint duration)
+{
+  if (!Scheduler.timer)
+    Scheduler.timer = g_timer_new();
+
+  data->frame_func = frame_func;
+  data->duration = MAX(duration, 0);
+  data->start = g_timer_elapsed(Scheduler.timer, NULL) * 1000;
+  Scheduler.effects = g_list_append(Scheduler.effects, data);
+
+  if (!Scheduler.clock)
+    Scheduler.clock = hd_hptimer_new(1000 / clutter_get_default_frame_rate(),
+                                     hd_transition_tick, NULL, NULL);
+}
+
+/* Take @data off the scheduler without completing it. */
+static void
+hd_transition_unschedule(HDEffectData *data)
+{
+  Scheduler.effects = g_list_remove(Scheduler.effects, data);
+  if (!Scheduler.effects && Scheduler.clock)
+    {
+      hd_hptimer_destroy(Scheduler.clock);
+      Scheduler.clock = NULL;
+    }
+}
+
+/* Have @func called after every tick of the effects with the number of
+ * microseconds it took and the number of effects it ran.  If @budget_us
+ * is not 0 and a tick takes longer the next one is skipped, leaving the
+ * time for other things; as the effects are timed they only get choppier,
+ * not slower. */
+void
+hd_transition_set_frame_budget(guint budget_us, HdTransitionBudgetFunc func,
+                               gpointer data)
+{
+  Scheduler.budget_us = budget_us;
+  Scheduler.budget_func = func;
+  Scheduler.budget_data = data;
+}
+
 void
 hd_transition_popup(HdCompMgr                  *mgr,
                     MBWindowManagerClient      *c,
@@ -940,11 +1092,6 @@ hd_transition_popup(HdCompMgr                  *mgr,
   data->cclient = mb_wm_object_ref (MB_WM_OBJECT (cclient));
   data->cclient_actor = g_object_ref (actor);
   data->hmgr = HD_COMP_MGR (mgr);
-  data->timeline = hd_transition_timeline_new("popup", event, 250);
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_popup_timeline_new_frame), data);
-  g_signal_connect (data->timeline, "completed",
-                        G_CALLBACK (hd_transition_completed), data);
   data->geo = geo;
   Transitions_running += data->fixup_visibilities = TRUE;
 
@@ -976,8 +1123,9 @@ hd_transition_popup(HdCompMgr                  *mgr,
                               &col);
 
   /* first call to stop flicker */
-  on_popup_timeline_new_frame(data->timeline, 0, data);
-  clutter_timeline_start (data->timeline);
+  on_popup_frame(data, 0);
+  hd_transition_schedule(data, on_popup_frame,
+                         hd_transition_get_duration("popup", event, 250));
 }
 
 /* For banners, information notes and confirmation notes. */
@@ -997,7 +1145,6 @@ hd_transition_fade(HdCompMgr                  *mgr,
   data->cclient_actor = g_object_ref (
       mb_wm_comp_mgr_clutter_client_get_actor( data->cclient ) );
   data->hmgr = HD_COMP_MGR (mgr);
-  data->timeline = hd_transition_timeline_new("fade", event, 250);
   Transitions_running += data->fixup_visibilities = TRUE;
 
   if (HD_IS_BANNER_NOTE(c))
@@ -1016,19 +1163,15 @@ hd_transition_fade(HdCompMgr                  *mgr,
     /* Leave @data->geo 0, we needn't move the actor around. */
     data->final_alpha = 1;
 
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_fade_timeline_new_frame), data);
-  g_signal_connect (data->timeline, "completed",
-                        G_CALLBACK (hd_transition_completed), data);
-
   mb_wm_comp_mgr_clutter_client_set_flags (cclient,
                               MBWMCompMgrClutterClientDontUpdate |
                               MBWMCompMgrClutterClientEffectRunning);
   hd_comp_mgr_set_effect_running(mgr, TRUE);
 
   /* first call to stop flicker */
-  on_fade_timeline_new_frame(data->timeline, 0, data);
-  clutter_timeline_start (data->timeline);
+  on_fade_frame(data, 0);
+  hd_transition_schedule(data, on_fade_frame,
+                         hd_transition_get_duration("fade", event, 250));
 }
 void
 hd_transition_fade_out_loading_screen(ClutterActor *loading_image)
@@ -1046,14 +1189,12 @@ hd_transition_fade_out_loading_screen(ClutterActor *loading_image)
     data->event = MBWMCompMgrClientEventUnmap;
     data->cclient_actor = g_object_ref ( loading_image );
     data->hmgr = 0;
-    data->timeline = clutter_timeline_new_for_duration ( duration );
     data->final_alpha = 1;
     /* the delay before we start to fade out. We implement this by setting
      * the final_alpha value to something *past* opaque */
     fade_delay = hd_transition_get_int("launcher_launch", "delay", 150);
     if (fade_delay>0)
       {
-        gint duration = clutter_timeline_get_duration(data->timeline);
         if (fade_delay < duration) {
           data->final_alpha = 1 + fade_delay/(float)(duration-fade_delay);
           // safety in case strange values get put in
@@ -1062,16 +1203,12 @@ hd_transition_fade_out_loading_screen(ClutterActor *loading_image)
         }
       }
 
-    g_signal_connect (data->timeline, "new-frame",
-                          G_CALLBACK (on_fade_timeline_new_frame), data);
-    g_signal_connect (data->timeline, "completed",
-                          G_CALLBACK (hd_transition_completed), data);
     clutter_container_add_actor (
                  hd_render_manager_get_front_group(),
                  loading_image);
     /* first call to stop flicker */
-    on_fade_timeline_new_frame(data->timeline, 0, data);
-    clutter_timeline_start (data->timeline);
+    on_fade_frame(data, 0);
+    hd_transition_schedule(data, on_fade_frame, duration);
 }
 
 void
@@ -1128,14 +1265,8 @@ hd_transition_close_app (HdCompMgr                  *mgr,
   data->cclient = mb_wm_object_ref (MB_WM_OBJECT (cclient));
   data->cclient_actor = g_object_ref (actor);
   data->hmgr = HD_COMP_MGR (mgr);
-  data->timeline = clutter_timeline_new_for_duration (
-                    hd_transition_get_int("app_close", "duration", 500));
-  g_signal_connect (data->timeline, "new-frame",
-                    G_CALLBACK (on_close_timeline_new_frame), data);
   g_signal_connect (clutter_stage_get_default (), "notify::allocation",
                     G_CALLBACK (on_screen_size_changed), data);
-  g_signal_connect (data->timeline, "completed",
-                    G_CALLBACK (hd_transition_completed), data);
   data->geo = geo;
 
   mb_wm_comp_mgr_clutter_client_set_flags (cclient,
@@ -1163,7 +1294,8 @@ hd_transition_close_app (HdCompMgr                  *mgr,
     }
 
   hd_comp_mgr_set_effect_running(mgr, TRUE);
-  clutter_timeline_start (data->timeline);
+  hd_transition_schedule(data, on_close_frame,
+                         hd_transition_get_int("app_close", "duration", 500));
 
   hd_transition_play_sound (HDCM_WINDOW_CLOSED_SOUND);
 }
@@ -1188,25 +1320,19 @@ hd_transition_notification(HdCompMgr                  *mgr,
   data->cclient_actor = g_object_ref (
       mb_wm_comp_mgr_clutter_client_get_actor( data->cclient ) );
   data->hmgr = HD_COMP_MGR (mgr);
-  data->timeline = hd_transition_timeline_new("notification", event, 500);
-
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_notification_timeline_new_frame), data);
-  g_signal_connect (data->timeline, "completed",
-                        G_CALLBACK (hd_transition_completed), data);
-
   mb_wm_comp_mgr_clutter_client_set_flags (cclient,
                               MBWMCompMgrClutterClientDontUpdate |
                               MBWMCompMgrClutterClientEffectRunning);
   hd_comp_mgr_set_effect_running(mgr, TRUE);
 
   /* first call to stop flicker */
-  on_notification_timeline_new_frame(data->timeline, 0, data);
+  on_notification_frame(data, 0);
   /* Show the actor and add it to the front group */
   clutter_actor_show(data->cclient_actor);
   hd_render_manager_add_to_front_group(data->cclient_actor);
-  /* Finally start the timeline... */
-  clutter_timeline_start (data->timeline);
+  /* Finally start the effect... */
+  hd_transition_schedule(data, on_notification_frame,
+                    hd_transition_get_duration("notification", event, 500));
 }
 
 void
@@ -1325,12 +1451,6 @@ hd_transition_subview(HdCompMgr                  *mgr,
       mb_wm_comp_mgr_clutter_client_get_actor( data->cclient2 ) );
   data->hmgr = HD_COMP_MGR (mgr);
   Transitions_running += data->fixup_visibilities = TRUE;
-  data->timeline = hd_transition_timeline_new("subview", event, 250);
-
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_subview_timeline_new_frame), data);
-  g_signal_connect (data->timeline, "completed",
-                        G_CALLBACK (hd_transition_completed), data);
 
   mb_wm_comp_mgr_clutter_client_set_flags (cclient_subview,
                               MBWMCompMgrClutterClientDontUpdate |
@@ -1344,8 +1464,9 @@ hd_transition_subview(HdCompMgr                  *mgr,
   HD_COMP_MGR_CLIENT (cclient_subview)->effect  = data;
 
   /* first call to stop flicker */
-  on_subview_timeline_new_frame(data->timeline, 0, data);
-  clutter_timeline_start (data->timeline);
+  on_subview_frame(data, 0);
+  hd_transition_schedule(data, on_subview_frame,
+                         hd_transition_get_duration("subview", event, 250));
 }
 
 /* Stop any currently active transition on the given client (assuming the
@@ -1362,13 +1483,11 @@ hd_transition_stop(HdCompMgr                  *mgr,
 
   if ((data = HD_COMP_MGR_CLIENT (cclient)->effect))
     {
-      gint n_frames = clutter_timeline_get_n_frames(data->timeline);
-      clutter_timeline_stop(data->timeline);
+      hd_transition_unschedule(data);
       /* Make sure we update to the final state for this transition */
-      g_signal_emit_by_name (data->timeline, "new-frame",
-                             n_frames, NULL);
+      data->frame_func(data, 1);
       /* Call end-of-transition handler */
-      hd_transition_completed(data->timeline, data);
+      hd_transition_completed(data);
     }
 }
 
@@ -1386,15 +1505,8 @@ hd_transition_fade_and_rotate(gboolean first_part,
   HDEffectData *data = g_new0 (HDEffectData, 1);
   data->event = first_part ? MBWMCompMgrClientEventMap :
                              MBWMCompMgrClientEventUnmap;
-  data->timeline = hd_transition_timeline_new("rotate", data->event, 300);
-
-  g_signal_connect (data->timeline, "new-frame",
-                        G_CALLBACK (on_rotate_screen_timeline_new_frame), data);
-  g_signal_connect (data->timeline, "completed",
-                         G_CALLBACK (hd_transition_completed), data);
-  if (finished_callback)
-    g_signal_connect_swapped (data->timeline, "completed",
-                          G_CALLBACK (finished_callback), finished_callback_data);
+  data->finished_callback = finished_callback;
+  data->finished_callback_data = finished_callback_data;
 
   data->angle = hd_transition_get_double("rotate", "angle", 40);
   /* Set the direction of movement - we want to rotate backwards if we
@@ -1435,8 +1547,9 @@ hd_transition_fade_and_rotate(gboolean first_part,
     }
 
   /* stop flicker by calling the first frame directly */
-  on_rotate_screen_timeline_new_frame(data->timeline, 0, data);
-  clutter_timeline_start (data->timeline);
+  on_rotate_screen_frame(data, 0);
+  hd_transition_schedule(data, on_rotate_screen_frame,
+                         hd_transition_get_duration("rotate", data->event, 300));
 }
 
 /* Process %_MAEMO_ROTATION_PATIENCE requests. */
@@ -1459,7 +1572,7 @@ patience (XClientMessageEvent *event, void *unused)
           max  = hd_transition_get_int("rotate", "damage_timeout_max", 1000);
           max -= g_timer_elapsed(Orientation_change.timer, NULL) * 1000.0;
           if (max > 0)
-            Orientation_change.timeout_id->remaining = max;
+            hd_hptimer_set_remaining(Orientation_change.timeout_id, max);
         }
       if (Orientation_change.phase <= WAIT_FOR_DAMAGES)
         Orientation_change.patience_requests++;
@@ -1470,7 +1583,7 @@ patience (XClientMessageEvent *event, void *unused)
         Orientation_change.patience_requests--;
       if (!Orientation_change.patience_requests
           && Orientation_change.timeout_id)
-        Orientation_change.timeout_id->remaining = 0;
+        hd_hptimer_set_remaining(Orientation_change.timeout_id, 0);
     }
 }
 
@@ -1636,7 +1749,7 @@ trans_start_error:
             hd_util_root_window_configured(Orientation_change.wm);
 
             g_assert(!Orientation_change.timeout_id);
-            Orientation_change.timeout_id = hptimer_new(
+            Orientation_change.timeout_id = hd_hptimer_new(
                   Orientation_change.patience_requests
                     ? hd_transition_get_int("rotate", "damage_timeout_max",
                                             1000)
@@ -1842,13 +1955,13 @@ hd_transition_rotate_ignore_damage()
 
           remaining = hd_transition_get_int("rotate", "damage_timeout_plus",
                                             50);
-          if (Orientation_change.timeout_id->remaining < remaining)
-            Orientation_change.timeout_id->remaining = remaining;
-          if (Orientation_change.timeout_id->remaining > max)
-            Orientation_change.timeout_id->remaining = max;
+          remaining = MAX(remaining,
+             (gint)hd_hptimer_get_remaining(Orientation_change.timeout_id));
+          hd_hptimer_set_remaining(Orientation_change.timeout_id,
+                                   MIN(remaining, max));
         }
       else
-        Orientation_change.timeout_id->remaining = 0;
+        hd_hptimer_set_remaining(Orientation_change.timeout_id, 0);
 
       return TRUE;
     }
@@ -1928,12 +2041,79 @@ hd_transition_play_sound (const gchar * fname)
 
 }
 
+static void
+hd_transition_free_value(HdTransitionValue *value)
+{
+  g_free(value->string);
+  hd_curve_unref(value->curve);
+  g_slice_free(HdTransitionValue, value);
+}
+
+/* Parse all of @ini into a new @transitions_ini, so that readers needn't
+ * go through the #GKeyFile every time. */
+static GHashTable *
+hd_transition_parse_ini(GKeyFile *ini)
+{
+  GHashTable *groups;
+  gchar **group_names, **key_names;
+  guint i, j;
+
+  groups = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                 (GDestroyNotify)g_hash_table_destroy);
+  group_names = g_key_file_get_groups(ini, NULL);
+  for (i = 0; group_names[i]; i++)
+    {
+      GHashTable *keys;
+
+      keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                          (GDestroyNotify)hd_transition_free_value);
+      key_names = g_key_file_get_keys(ini, group_names[i], NULL, NULL);
+      for (j = 0; key_names && key_names[j]; j++)
+        {
+          HdTransitionValue *value;
+          GError *error;
+
+          value = g_slice_new0(HdTransitionValue);
+          value->string = g_key_file_get_string(ini, group_names[i],
+                                                key_names[j], NULL);
+
+          error = NULL;
+          value->int_val = g_key_file_get_integer(ini, group_names[i],
+                                                  key_names[j], &error);
+          if (!(value->is_int = !error))
+            g_error_free(error);
+
+          error = NULL;
+          value->double_val = g_key_file_get_double(ini, group_names[i],
+                                                    key_names[j], &error);
+          if (!(value->is_double = !error))
+            g_error_free(error);
+
+          g_hash_table_insert(keys, g_strdup(key_names[j]), value);
+        }
+      g_strfreev(key_names);
+
+      g_hash_table_insert(groups, g_strdup(group_names[i]), keys);
+    }
+  g_strfreev(group_names);
+
+  return groups;
+}
+
+static GHashTable *
+hd_transition_get_ini(void);
+static gboolean
+hd_transition_reload_ini(gpointer unused);
+
 /* We want to call this when the theme changes, as transitions.ini *could*
  * be loaded from the theme. */
 void
 hd_transition_set_file_changed(void) {
   g_debug("%s: setting transitions.ini modified", __FUNCTION__);
   transitions_ini_is_dirty = 2*TRUE;
+  if (transitions_ini)
+    /* What's read next should come from the new file already. */
+    hd_transition_get_ini();
 }
 
 static gboolean
@@ -1957,20 +2137,29 @@ transitions_ini_changed(GIOChannel *chnl, GIOCondition cond, gpointer unused)
           g_debug("watching no more");
           transitions_ini_is_dirty++;
         }
+
+      /* Reload once the writer is likely to be done, rather than
+       * on every event of a write. */
+      if (!transitions_ini_reload_id)
+        transitions_ini_reload_id = g_idle_add(hd_transition_reload_ini,
+                                               NULL);
     }
   return TRUE;
 }
 
-static GKeyFile *
-hd_transition_get_keyfile(void)
+static GHashTable *
+hd_transition_get_ini(void)
 {
-  static GKeyFile *transitions_ini;
   static GIOChannel *transitions_ini_watcher;
   GError *error;
   GKeyFile *ini;
   const char *fname;
+  gboolean reloading;
 
-  if (transitions_ini && !transitions_ini_is_dirty)
+  /* If we're watching it, it will be reloaded when it's changed.
+   * Otherwise keep trying. */
+  if (transitions_ini
+      && (!transitions_ini_is_dirty || transitions_ini_reload_id))
     return transitions_ini;
 
   /* Check for a file in the theme directory first, otherwise
@@ -1995,9 +2184,11 @@ hd_transition_get_keyfile(void)
     }
 
   /* Use the new @transitions_ini. */
+  reloading = transitions_ini != NULL;
   if (transitions_ini)
-    g_key_file_free(transitions_ini);
-  transitions_ini = ini;
+    g_hash_table_destroy(transitions_ini);
+  transitions_ini = hd_transition_parse_ini(ini);
+  g_key_file_free(ini);
 
   if (!transitions_ini_watcher || transitions_ini_is_dirty > TRUE)
     {
@@ -2038,55 +2229,93 @@ hd_transition_get_keyfile(void)
   transitions_ini_is_dirty = FALSE;
 
 out:
+  if (reloading && transitions_ini_hooks.is_setup)
+    g_hook_list_invoke(&transitions_ini_hooks, FALSE);
   return transitions_ini;
 }
 
+static gboolean
+hd_transition_reload_ini(gpointer unused)
+{
+  transitions_ini_reload_id = 0;
+  if (transitions_ini_is_dirty)
+    hd_transition_get_ini();
+  return FALSE;
+}
+
+/* Returns @transition::@key in transitions.ini or %NULL. */
+static HdTransitionValue *
+hd_transition_get_value(const gchar *transition, const char *key)
+{
+  GHashTable *ini, *group;
+
+  if (!(ini = hd_transition_get_ini()))
+    return NULL;
+  if (!(group = g_hash_table_lookup(ini, transition)))
+    return NULL;
+  return g_hash_table_lookup(group, key);
+}
+
+/* Have @func called with @data whenever transitions.ini has changed
+ * and been reloaded, so those who keep something derived from it
+ * can update it. */
+void
+hd_transition_ini_changed_connect(GHookFunc func, gpointer data)
+{
+  GHook *hook;
+
+  if (!transitions_ini_hooks.is_setup)
+    g_hook_list_init(&transitions_ini_hooks, sizeof(GHook));
+
+  hook = g_hook_alloc(&transitions_ini_hooks);
+  hook->func = func;
+  hook->data = data;
+  g_hook_append(&transitions_ini_hooks, hook);
+}
+
+void
+hd_transition_ini_changed_disconnect(GHookFunc func, gpointer data)
+{
+  GHook *hook;
+
+  if (!transitions_ini_hooks.is_setup)
+    return;
+  if ((hook = g_hook_find_func_data(&transitions_ini_hooks, TRUE,
+                                    func, data)) != NULL)
+    g_hook_destroy_link(&transitions_ini_hooks, hook);
+}
+
 gint
 hd_transition_get_int(const gchar *transition, const char *key,
                       gint default_val)
 {
-  gint value;
-  GError *error;
-  GKeyFile *ini;
-
-  if (!(ini = hd_transition_get_keyfile()))
-    return default_val;
+  const HdTransitionValue *value;
 
-  error = NULL;
-  value = g_key_file_get_integer(ini, transition, key, &error);
-  if (error)
+  if (!(value = hd_transition_get_value(transition, key)) || !value->is_int)
     {
-      g_debug("couldn't read int %s::%s from transitions.ini: %s",
-                transition, key, error->message);
-      g_error_free(error);
+      g_debug("couldn't read int %s::%s from transitions.ini",
+                transition, key);
       return default_val;
     }
 
-  return value;
+  return value->int_val;
 }
 
 gdouble
 hd_transition_get_double(const gchar *transition,
                          const char *key, gdouble default_val)
 {
-  gdouble value;
-  GError *error;
-  GKeyFile *ini;
-
-  if (!(ini = hd_transition_get_keyfile()))
-    return default_val;
+  const HdTransitionValue *value;
 
-  error = NULL;
-  value = g_key_file_get_double (ini, transition, key, &error);
-  if (error)
+  if (!(value = hd_transition_get_value(transition, key))
+      || !value->is_double)
     {
-      g_debug("couldn't read double %s::%s from transitions.ini: %s",
-                transition, key, error->message);
-      g_error_free(error);
+      g_debug("couldn't read double %s::%s from transitions.ini",
+                transition, key);
       return default_val;
     }
 
-  return value;
+  return value->double_val;
 }
 
 /* Returns a newly-allocated string that must *always* be freed by the caller */
@@ -2094,39 +2323,42 @@ gchar *
 hd_transition_get_string(const gchar *transition, const char *key,
                       gchar *default_val)
 {
-  gchar *value;
-  GError *error;
-  GKeyFile *ini;
-
-  if (!(ini = hd_transition_get_keyfile())) {
-    /* It sould be a newly allocated string.
-     * Fixes BMO #12722: hildon-desktop crashes on malformed transitions.ini.
-     */
-    gchar *new_val = g_strdup(default_val);
-    return new_val;
-  }
+  const HdTransitionValue *value;
 
-  error = NULL;
-  value = g_key_file_get_string (ini, transition, key, &error);
-  if (error)
+  /* It sould be a newly allocated string even if we haven't got it.
+   * Fixes BMO #12722: hildon-desktop crashes on malformed transitions.ini.
+   */
+  if (!(value = hd_transition_get_value(transition, key)) || !value->string)
     {
-      g_debug("couldn't read string %s::%s from transitions.ini: %s",
-                transition, key, error->message);
-      g_error_free(error);
+      g_debug("couldn't read string %s::%s from transitions.ini",
+                transition, key);
       return g_strdup(default_val);
     }
 
-  return value;
+  return g_strdup(value->string);
 }
 
-HdKeyFrameList *
-hd_transition_get_keyframes(const gchar *transition, const char *key,
-                            gchar *default_val)
+/* Returns the curve of the comma-separated values of @transition::@key,
+ * or @default_val if it's not there.  It's made when it's first asked
+ * for after transitions.ini has been (re)loaded, after that it's shared.
+ * Unref it when you're done. */
+HdCurve *
+hd_transition_get_curve(const gchar *transition, const char *key,
+                        const gchar *default_val)
 {
-  char *keyframetext = hd_transition_get_string(transition, key, default_val);
-  HdKeyFrameList *keyframes = hd_key_frame_list_create(keyframetext);
-  g_free(keyframetext);
-  return keyframes;
+  HdTransitionValue *value;
+
+  if (!(value = hd_transition_get_value(transition, key))
+      || !value->string)
+    {
+      g_debug("couldn't read curve %s::%s from transitions.ini",
+                transition, key);
+      return hd_curve_new_from_string(default_val);
+    }
+
+  if (!value->curve)
+    value->curve = hd_curve_new_from_string(value->string);
+  return hd_curve_ref(value->curve);
 }
 
 void
@@ -28,6 +28,7 @@
 #include "mb/hd-wm.h"
 #include "home/hd-render-manager.h"
 #include "util/hd-util.h"
+#include "util/hd-curve.h"
 
 /* The file name of the particle image used in close-app transitions
  * and the number of them to show in the transition. */
@@ -83,6 +84,13 @@ void
 hd_transition_stop(HdCompMgr                  *mgr,
                    MBWindowManagerClient      *client);
 
+/* See hd_transition_set_frame_budget(). */
+typedef void (*HdTransitionBudgetFunc)(guint used_us, guint n_effects,
+                                       gpointer data);
+void
+hd_transition_set_frame_budget(guint budget_us, HdTransitionBudgetFunc func,
+                               gpointer data);
+
 gboolean
 hd_transition_rotate_screen(MBWindowManager *wm, gboolean goto_portrait);
 void
@@ -115,13 +123,18 @@ gchar *
 hd_transition_get_string(const gchar *transition, const char *key,
                       gchar *default_val);
 
-HdKeyFrameList *
-hd_transition_get_keyframes(const gchar *transition, const char *key,
-                            gchar *default_val);
+HdCurve *
+hd_transition_get_curve(const gchar *transition, const char *key,
+                        const gchar *default_val);
 
 void
 hd_transition_set_file_changed(void);
 
+void
+hd_transition_ini_changed_connect(GHookFunc func, gpointer data);
+void
+hd_transition_ini_changed_disconnect(GHookFunc func, gpointer data);
+
 void
 hd_transition_play_tactile(gboolean is_map, MBWMClientType c_type);
 
@@ -40,13 +40,11 @@ void hd_util_click (const MBWindowManagerClient *c);
 void
 hd_util_partial_redraw_if_possible(ClutterActor *actor, ClutterGeometry *bounds);
 
-gboolean hd_util_client_obscured(MBWindowManagerClient *client);
+gboolean
+hd_util_get_actor_bounds(ClutterActor *actor, ClutterGeometry *geo,
+                         gboolean *is_visible);
 
-/* Functions for loading and interpolating from a list of keyframes */
-typedef struct _HdKeyFrameList HdKeyFrameList;
-HdKeyFrameList *hd_key_frame_list_create(const char *keys);
-void hd_key_frame_list_free(HdKeyFrameList *k);
-float hd_key_frame_interpolate(HdKeyFrameList *k, float x);
+gboolean hd_util_client_obscured(MBWindowManagerClient *client);
 
 void hd_util_display_portraitness_init(MBWindowManager *wm);
 
@@ -9,6 +9,7 @@
 #include <clutter/x11/clutter-x11.h>
 #include <matchbox/core/mb-wm.h>
 #include "home/hd-render-manager.h"
+#include "hd-motion-history.h"
 
 #define RR_Reflect_All	(RR_Reflect_X|RR_Reflect_Y)
 
@@ -25,6 +26,12 @@ typedef struct Matrix {
 	float m[9];
 } Matrix;
 
+/* State of motion_superseded_predicate() while it walks the queue. */
+typedef struct {
+	XEvent *xev;
+	bool done, superseded;
+} MotionScan;
+
 void hd_init_xinput(Display *dpy)
 {
 	static XEventClass class_presence;
@@ -338,10 +345,71 @@ int hd_rotate_input_devices(Display *dpy)
 	return ret;
 }
 
+/* XCheckIfEvent() predicate which never takes an event, but scans the
+ * queue for a motion of the same device as @scan->xev.  Motion of other
+ * devices doesn't stop the scan, but any other input does, so that we
+ * never drop a motion which leads to a button press or a crossing. */
+static Bool motion_superseded_predicate(Display *dpy, XEvent *next, XPointer arg)
+{
+	MotionScan *scan = (MotionScan *) arg;
+
+	if (scan->done)
+		return False;
+
+	if (next->type == scan->xev->type) {
+		if (next->type == MotionNotify)
+			scan->superseded = next->xmotion.window == scan->xev->xmotion.window;
+		else
+			scan->superseded = ((XDeviceMotionEvent *) next)->deviceid
+				== ((XDeviceMotionEvent *) scan->xev)->deviceid;
+		scan->done = scan->superseded;
+	} else if (next->type != MotionNotify && next->type != xi_motion_ev_type) {
+		switch (next->type) {
+		case ButtonPress:
+		case ButtonRelease:
+		case KeyPress:
+		case KeyRelease:
+		case EnterNotify:
+		case LeaveNotify:
+		case FocusIn:
+		case FocusOut:
+			scan->done = true;
+			break;
+		}
+	}
+
+	return False;
+}
+
+/* Returns whether a newer motion of the same device is already queued,
+ * in which case @xev needn't be processed.  This leaves at most one
+ * motion per device in each batch of events we process before the next
+ * frame is painted. */
+static bool motion_is_superseded(XEvent *xev)
+{
+	MotionScan scan = { xev, false, false };
+	XEvent unused;
+
+	XCheckIfEvent(xev->xany.display, &unused,
+		      motion_superseded_predicate, (XPointer) &scan);
+	return scan.superseded;
+}
+
 ClutterX11FilterReturn hd_clutter_x11_event_filter(XEvent *xev, ClutterEvent *cev, gpointer data)
 {
 	MBWindowManager *wm = data;
 
+	if (xev->type == MotionNotify) {
+		/* Every core pointer motion, delivered or compressed away,
+		 * in root coordinates whichever window it was for. */
+		hd_motion_history_add(xev->xmotion.x_root, xev->xmotion.y_root,
+				      xev->xmotion.time);
+		if (motion_is_superseded(xev))
+			return CLUTTER_X11_FILTER_REMOVE;
+	} else if (xev->type == xi_motion_ev_type && motion_is_superseded(xev)) {
+		return CLUTTER_X11_FILTER_REMOVE;
+	}
+
 	if (xev->type == ButtonPress) {
 		hd_render_manager_press_effect();
 	} else if (xev->type == xi_motion_ev_type) {
@@ -0,0 +1,135 @@
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hd-cpu-blur.h"
+
+/* Checks hd_cpu_blur() against a straightforward box blur with random
+ * images of various shapes, radii and numbers of threads, then measures
+ * how fast it is on what TidyBlurGroup would give it. */
+
+#define BLUR_WIDTH   400
+#define BLUR_HEIGHT  240
+#define BENCH_ROUNDS 50
+
+/* One box blur of @radius along @step (4 for rows, the rowstride
+ * for columns), @n samples long, @count times with @skip between. */
+static void
+reference_box (const guchar *src, guchar *dst, gint n, gint step,
+               gint count, gint skip, gint radius)
+{
+  guint mul = (0x10000 + 2*radius) / (2*radius + 1);
+  gint i, j, k;
+
+  for (k = 0; k < count; k++)
+    for (i = 0; i < n; i++)
+      {
+        guint sum = 0;
+
+        for (j = i - radius; j <= i + radius; j++)
+          sum += src[k*skip + CLAMP (j, 0, n-1)*step];
+        dst[k*skip + i*step] = (sum * mul) >> 16;
+      }
+}
+
+static void
+reference_blur (guchar *pixels, gint width, gint height, gint radius)
+{
+  guchar *tmp;
+  gint pass;
+
+  tmp = g_malloc (width * height * 4);
+  for (pass = 0; pass < 3; pass++)
+    {
+      reference_box (pixels, tmp, height, width*4, width*4, 1, radius);
+      memcpy (pixels, tmp, width * height * 4);
+    }
+  for (pass = 0; pass < 3; pass++)
+    {
+      gint c;
+
+      for (c = 0; c < 4; c++)
+        reference_box (pixels + c, tmp + c, width, 4, height, width*4, radius);
+      memcpy (pixels, tmp, width * height * 4);
+    }
+  g_free (tmp);
+}
+
+static guchar *
+random_image (gint width, gint height)
+{
+  guchar *pixels;
+  gint i;
+
+  pixels = g_malloc (width * height * 4);
+  for (i = 0; i < width * height * 4; i++)
+    pixels[i] = rand ();
+  return pixels;
+}
+
+static gboolean
+check (gint width, gint height, gint radius, gint n_threads)
+{
+  guchar *expected, *got;
+  gboolean ok;
+
+  expected = random_image (width, height);
+  got = g_memdup (expected, width * height * 4);
+
+  reference_blur (expected, width, height, radius);
+  hd_cpu_blur (got, width, height, radius, n_threads);
+  ok = !memcmp (expected, got, width * height * 4);
+  if (!ok)
+    printf ("FAIL: %dx%d, radius %d, %d threads\n",
+            width, height, radius, n_threads);
+
+  g_free (expected);
+  g_free (got);
+  return ok;
+}
+
+static gdouble
+bench (gint radius, gint n_threads)
+{
+  guchar *pixels;
+  struct timespec t0, t1;
+  gint i;
+
+  pixels = random_image (BLUR_WIDTH, BLUR_HEIGHT);
+  clock_gettime (CLOCK_MONOTONIC, &t0);
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    hd_cpu_blur (pixels, BLUR_WIDTH, BLUR_HEIGHT, radius, n_threads);
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  g_free (pixels);
+
+  /* Wall clock time, as the threads run in parallel. */
+  return ((t1.tv_sec - t0.tv_sec) * 1000.0
+          + (t1.tv_nsec - t0.tv_nsec) / 1000000.0) / BENCH_ROUNDS;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const gint sizes[][2] =
+    { { 1, 1 }, { 3, 2 }, { 17, 5 }, { 33, 31 }, { 64, 48 }, { 101, 37 } };
+  static const gint radii[] = { 1, 2, 5, 20, HD_CPU_BLUR_MAX_RADIUS };
+  guint i, j;
+  gint failures, threads;
+
+  failures = 0;
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    for (j = 0; j < G_N_ELEMENTS (radii); j++)
+      for (threads = 1; threads <= 3; threads++)
+        failures += !check (sizes[i][0], sizes[i][1], radii[j], threads);
+  printf ("%d failures\n", failures);
+
+  printf ("implementation: %s\n", hd_cpu_blur_impl ());
+  for (j = 0; j < 3; j++)
+    printf ("%dx%d, radius %d: %.2f ms with 1 thread, %.2f ms with 2\n",
+            BLUR_WIDTH, BLUR_HEIGHT, radii[j],
+            bench (radii[j], 1), bench (radii[j], 2));
+
+  return failures ? 1 : 0;
+}
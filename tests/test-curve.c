@@ -0,0 +1,169 @@
+#include <glib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#include "hd-curve.h"
+
+/* Checks that HdCurve:s sampled from the easing functions of
+ * hd-transition.c stay close to them and that curves of keyframes
+ * interpolate like hd_key_frame_interpolate() did, then measures what
+ * evaluating them costs compared with calculating the functions. */
+
+#define BENCH_ROUNDS 2000000
+#define MAX_ERROR    1e-4
+
+/* The easing functions as hd-transition.c used to calculate them
+ * every frame. */
+static float
+overshoot (float amt)
+{
+  float smooth_ramp, converge;
+
+  smooth_ramp = 1.0f - cos (amt*3.141592);
+  converge = sin (0.5*3.141592*(1-amt));
+  return (smooth_ramp*0.675)*converge + (1-converge);
+}
+
+static float
+smooth_ramp (float amt)
+{
+  return (1.0f - cos (amt*3.141592)) * 0.5f;
+}
+
+static float
+ease_in (float amt)
+{
+  return (1.0f - cos (amt*3.141592*0.5));
+}
+
+static float
+ease_out (float amt)
+{
+  return cos ((1-amt)*3.141592*0.5);
+}
+
+static const struct
+{
+  const gchar *name;
+  float (*func)(float);
+} funcs[] =
+{
+  { "overshoot",   overshoot   },
+  { "smooth_ramp", smooth_ramp },
+  { "ease_in",     ease_in     },
+  { "ease_out",    ease_out    },
+};
+
+static gboolean
+check_func (const gchar *name, float (*func)(float))
+{
+  HdCurve *curve;
+  gdouble worst;
+  gint i;
+
+  curve = hd_curve_new_from_func (func);
+  worst = 0;
+  for (i = 0; i <= 100000; i++)
+    {
+      float x = i / 100000.0f;
+
+      worst = MAX (worst, fabs (hd_curve_get (curve, x) - func (x)));
+    }
+  hd_curve_unref (curve);
+
+  if (worst > MAX_ERROR)
+    {
+      printf ("FAIL: %s is off by %g\n", name, worst);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+check_string (const char *keys, float x, float expected)
+{
+  HdCurve *curve;
+  float got;
+
+  curve = hd_curve_new_from_string (keys);
+  got = hd_curve_get (curve, x);
+  hd_curve_unref (curve);
+
+  if (fabs (got - expected) > 1e-6)
+    {
+      printf ("FAIL: \"%s\" at %g is %g instead of %g\n",
+              keys ? keys : "(null)", x, got, expected);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static gdouble
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Evaluates @func or @curve at BENCH_ROUNDS points and returns how long
+ * one took in nanoseconds. */
+static gdouble
+bench (float (*func)(float), const HdCurve *curve)
+{
+  volatile float sink;
+  gdouble start;
+  float sum;
+  gint i;
+
+  sum = 0;
+  start = now ();
+  if (func)
+    for (i = 0; i < BENCH_ROUNDS; i++)
+      sum += func ((float)i / BENCH_ROUNDS);
+  else
+    for (i = 0; i < BENCH_ROUNDS; i++)
+      sum += hd_curve_get (curve, (float)i / BENCH_ROUNDS);
+  sink = sum;
+  (void)sink;
+
+  return (now () - start) * 1e9 / BENCH_ROUNDS;
+}
+
+int
+main (int argc, char **argv)
+{
+  gint i, failures;
+
+  failures = 0;
+  for (i = 0; i < G_N_ELEMENTS (funcs); i++)
+    failures += !check_func (funcs[i].name, funcs[i].func);
+
+  failures += !check_string ("0,0.5,1",  0.25, 0.25);
+  failures += !check_string ("0,1,0",    0.75, 0.5);
+  failures += !check_string ("0,1,0",    0.5,  1);
+  failures += !check_string ("0,2,",     0.5,  1);
+  failures += !check_string ("0.5,1",   -1,    0.5);
+  failures += !check_string ("0.5,1",    2,    1);
+  failures += !check_string ("0,1,0",    NAN,  0);
+  /* Invalid ones are a straight ramp. */
+  failures += !check_string (NULL,       0.3,  0.3);
+  failures += !check_string ("",         0.3,  0.3);
+  failures += !check_string ("7",        0.3,  0.3);
+  failures += !check_string ("7,",       0.3,  0.3);
+  printf ("%d failures\n", failures);
+
+  for (i = 0; i < G_N_ELEMENTS (funcs); i++)
+    {
+      HdCurve *curve;
+
+      curve = hd_curve_new_from_func (funcs[i].func);
+      printf ("%-12s calculated %6.2f ns, curve %6.2f ns\n", funcs[i].name,
+              bench (funcs[i].func, NULL), bench (NULL, curve));
+      hd_curve_unref (curve);
+    }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tidy-dirty-rects.h"
+
+/* Feeds synthetic damage patterns to a TidyMemTexture-sized tile and
+ * compares how many bytes tidy_dirty_rects would upload with the single
+ * bounding box TidyMemTexture used to upload.  Also checks that every
+ * damaged pixel is covered by some rectangle. */
+
+#define TILE_SIZE     480
+#define BPP           2
+#define FRAMES        200
+
+typedef struct
+{
+  const gchar *name;
+  /* Appends the damage of @frame to @rects. */
+  void (*generate) (gint frame, gint *nrects, TidyDirtyRect *rects);
+} Pattern;
+
+/* The blinking cursor and the clock in opposite corners. */
+static void
+corners (gint frame, gint *nrects, TidyDirtyRect *rects)
+{
+  TidyDirtyRect cursor = { 8, 8, 2, 16 };
+  TidyDirtyRect clock = { TILE_SIZE - 60, TILE_SIZE - 20, 52, 16 };
+
+  rects[(*nrects)++] = cursor;
+  rects[(*nrects)++] = clock;
+}
+
+/* Glyphs appearing along a line of text. */
+static void
+typing (gint frame, gint *nrects, TidyDirtyRect *rects)
+{
+  TidyDirtyRect glyph = { 10 + (frame % 40) * 11, 100 + (frame / 40) * 20,
+                          10, 18 };
+  TidyDirtyRect cursor = { glyph.x + 11, glyph.y, 2, 18 };
+
+  rects[(*nrects)++] = glyph;
+  rects[(*nrects)++] = cursor;
+}
+
+/* A handful of small random updates all over. */
+static void
+scattered (gint frame, gint *nrects, TidyDirtyRect *rects)
+{
+  gint i, n;
+
+  n = 2 + rand () % 6;
+  for (i = 0; i < n; i++)
+    {
+      rects[*nrects].width  = 4 + rand () % 28;
+      rects[*nrects].height = 4 + rand () % 28;
+      rects[*nrects].x = rand () % (TILE_SIZE - rects[*nrects].width);
+      rects[*nrects].y = rand () % (TILE_SIZE - rects[*nrects].height);
+      (*nrects)++;
+    }
+}
+
+/* Many overlapping updates in the same area, like a spinner. */
+static void
+clustered (gint frame, gint *nrects, TidyDirtyRect *rects)
+{
+  gint i;
+
+  for (i = 0; i < 6; i++)
+    {
+      rects[*nrects].x = 200 + rand () % 40;
+      rects[*nrects].y = 200 + rand () % 40;
+      rects[*nrects].width = rects[*nrects].height = 24;
+      (*nrects)++;
+    }
+}
+
+/* Scrolling: the whole tile. */
+static void
+full (gint frame, gint *nrects, TidyDirtyRect *rects)
+{
+  TidyDirtyRect all = { 0, 0, TILE_SIZE, TILE_SIZE };
+
+  rects[(*nrects)++] = all;
+}
+
+static const Pattern patterns[] =
+{
+  { "corners",   corners   },
+  { "typing",    typing    },
+  { "scattered", scattered },
+  { "clustered", clustered },
+  { "full",      full      },
+};
+
+static void
+bounding_box (TidyDirtyRect *bbox, const TidyDirtyRect *r)
+{
+  gint x2, y2;
+
+  if (!bbox->width)
+    {
+      *bbox = *r;
+      return;
+    }
+
+  x2 = MAX (bbox->x + bbox->width,  r->x + r->width);
+  y2 = MAX (bbox->y + bbox->height, r->y + r->height);
+  bbox->x = MIN (bbox->x, r->x);
+  bbox->y = MIN (bbox->y, r->y);
+  bbox->width  = x2 - bbox->x;
+  bbox->height = y2 - bbox->y;
+}
+
+/* Returns whether @dirty covers all of @rects. */
+static gboolean
+covers (const TidyDirtyRects *dirty, const TidyDirtyRect *rects, gint n)
+{
+  static guchar map[TILE_SIZE][TILE_SIZE];
+  gint i, x, y;
+  guint j;
+
+  memset (map, 0, sizeof (map));
+  for (j = 0; j < dirty->n; j++)
+    {
+      const TidyDirtyRect *r = &dirty->rects[j];
+
+      if (r->x < 0 || r->y < 0
+          || r->x + r->width > TILE_SIZE || r->y + r->height > TILE_SIZE)
+        return FALSE;
+      for (y = r->y; y < r->y + r->height; y++)
+        memset (&map[y][r->x], 1, r->width);
+    }
+
+  for (i = 0; i < n; i++)
+    for (y = rects[i].y; y < rects[i].y + rects[i].height; y++)
+      for (x = rects[i].x; x < rects[i].x + rects[i].width; x++)
+        if (!map[y][x])
+          return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+run (const Pattern *pattern)
+{
+  TidyDirtyRect rects[16];
+  guint64 old_bytes, new_bytes, uploads;
+  gint frame, n, i;
+  gboolean ok;
+
+  ok = TRUE;
+  old_bytes = new_bytes = uploads = 0;
+  srand (1);
+  for (frame = 0; frame < FRAMES; frame++)
+    {
+      TidyDirtyRects dirty;
+      TidyDirtyRect bbox = { 0, 0, 0, 0 };
+
+      n = 0;
+      pattern->generate (frame, &n, rects);
+
+      tidy_dirty_rects_clear (&dirty);
+      for (i = 0; i < n; i++)
+        {
+          tidy_dirty_rects_add (&dirty, rects[i].x, rects[i].y,
+                                rects[i].width, rects[i].height);
+          bounding_box (&bbox, &rects[i]);
+        }
+
+      if (!covers (&dirty, rects, n))
+        {
+          printf ("FAIL: %s frame %d isn't covered\n", pattern->name, frame);
+          ok = FALSE;
+        }
+
+      old_bytes += (guint64)bbox.width * bbox.height * BPP;
+      new_bytes += tidy_dirty_rects_area (&dirty) * BPP;
+      uploads += dirty.n;
+    }
+
+  printf ("%-10s bounding box: %8" G_GUINT64_FORMAT " kB, "
+          "dirty rects: %8" G_GUINT64_FORMAT " kB in %.1f uploads/frame\n",
+          pattern->name, old_bytes / 1024, new_bytes / 1024,
+          (gdouble)uploads / FRAMES);
+  return ok;
+}
+
+int
+main (int argc, char **argv)
+{
+  guint i;
+  gint failures;
+
+  failures = 0;
+  for (i = 0; i < G_N_ELEMENTS (patterns); i++)
+    failures += !run (&patterns[i]);
+  printf ("%d failures\n", failures);
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hd-dither.h"
+
+/* Checks hd_dither_565() against the original wallpaper dithering loop
+ * of hd-home-view.c with random images of various shapes, then measures
+ * how fast it is on a wallpaper-sized image. */
+
+#define WALLPAPER_WIDTH  800
+#define WALLPAPER_HEIGHT 480
+#define BENCH_ROUNDS     50
+
+/* The dithering as load_background_idle() used to do it. */
+static void
+reference_dither (const guchar *pixels, gint width, gint height,
+                  gint rowstride, gint n_channels, guint16 *out)
+{
+  guint lfsr = 1;
+  gint x, y;
+
+  for (y = 0; y < height; y++)
+    {
+      for (x = 0; x < width; x++)
+        {
+          guint r, g, b;
+
+          lfsr = (lfsr >> 1) ^ (unsigned int)((0 - (lfsr & 1u)) & 0xd0000001u);
+          r = pixels[0] + (lfsr&7);
+          r |= (r>>8)*0xFF;
+          g = pixels[1] + ((lfsr>>3)&3);
+          g |= (g>>8)*0xFF;
+          b = pixels[2] + ((lfsr>>5)&7);
+          b |= (b>>8)*0xFF;
+          *out++ = ((r<<8)&0xF800) | ((g<<3)&0x07E0) | ((b>>3)&0x001F);
+          pixels += n_channels;
+        }
+      pixels += rowstride - width*n_channels;
+    }
+}
+
+/* Random image, biased towards saturated samples to exercise
+ * the overflow handling. */
+static guchar *
+random_image (gint width, gint height, gint rowstride)
+{
+  guchar *pixels;
+  gint i;
+
+  pixels = g_malloc (rowstride * height);
+  for (i = 0; i < rowstride * height; i++)
+    pixels[i] = rand () % 4 ? rand () : 0xFF - rand () % 8;
+  return pixels;
+}
+
+static gboolean
+check (gint width, gint height, gint n_channels, gint padding)
+{
+  gint rowstride;
+  guchar *pixels;
+  guint16 *expected, *got;
+  gboolean ok;
+
+  rowstride = width * n_channels + padding;
+  pixels = random_image (width, height, rowstride);
+  expected = g_new (guint16, width * height);
+  got = g_new (guint16, width * height);
+
+  reference_dither (pixels, width, height, rowstride, n_channels, expected);
+  hd_dither_565 (pixels, width, height, rowstride, n_channels, got);
+  ok = !memcmp (expected, got, width * height * sizeof (*got));
+  if (!ok)
+    printf ("FAIL: %dx%d, %d channels, %d bytes padding\n",
+            width, height, n_channels, padding);
+
+  g_free (pixels);
+  g_free (expected);
+  g_free (got);
+  return ok;
+}
+
+static gdouble
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+bench (const gchar *name,
+       void (*fun)(const guchar *, gint, gint, gint, gint, guint16 *),
+       gint n_channels)
+{
+  gint i, rowstride;
+  guchar *pixels;
+  guint16 *out;
+  gdouble start, secs;
+
+  rowstride = WALLPAPER_WIDTH * n_channels;
+  pixels = random_image (WALLPAPER_WIDTH, WALLPAPER_HEIGHT, rowstride);
+  out = g_new (guint16, WALLPAPER_WIDTH * WALLPAPER_HEIGHT);
+
+  start = now ();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    fun (pixels, WALLPAPER_WIDTH, WALLPAPER_HEIGHT,
+         rowstride, n_channels, out);
+  secs = now () - start;
+
+  printf ("%-10s %d channels: %7.1f MPix/s\n", name, n_channels,
+          (gdouble)WALLPAPER_WIDTH * WALLPAPER_HEIGHT * BENCH_ROUNDS
+            / secs / 1e6);
+
+  g_free (pixels);
+  g_free (out);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const gint widths[] = { 1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 33, 800 };
+  gint i, n_channels, failures;
+
+  failures = 0;
+  for (n_channels = 3; n_channels <= 4; n_channels++)
+    for (i = 0; i < G_N_ELEMENTS (widths); i++)
+      {
+        failures += !check (widths[i], 5, n_channels, 0);
+        failures += !check (widths[i], 5, n_channels, 3);
+      }
+  printf ("%s: %d failures\n", hd_dither_565_impl (), failures);
+
+  for (n_channels = 3; n_channels <= 4; n_channels++)
+    {
+      bench ("reference", reference_dither, n_channels);
+      bench ("scalar", hd_dither_565_scalar, n_channels);
+      bench (hd_dither_565_impl (), hd_dither_565, n_channels);
+    }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,254 @@
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "hd-hptimer.h"
+
+/* Checks that HdHPTimer:s expire in order, can be changed and destroyed
+ * from their callbacks, then measures how regularly a frame timer wakes
+ * up with it and with the poll() timeout based timer it replaced in
+ * hd-transition.c. */
+
+#define FRAME_INTERVAL 16
+#define FRAMES         150
+
+static GMainLoop *loop;
+
+static gint64
+now_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* The old timer ------------------------------------------------------- */
+
+typedef struct
+{
+  GSource parent;
+  GTimeVal last;
+  unsigned remaining, expiry;
+} LegacyTimer;
+
+static void
+legacy_calc_remaining (LegacyTimer *timer)
+{
+  guint diff;
+  GTimeVal now;
+
+  g_get_current_time (&now);
+  diff = (now.tv_sec - timer->last.tv_sec) * 1000;
+  if (now.tv_usec < timer->last.tv_usec)
+    {
+      diff -= 1000;
+      diff += ((1000000 - timer->last.tv_usec) + now.tv_usec) / 1000;
+    } else
+      diff += (now.tv_usec - timer->last.tv_usec) / 1000;
+
+  if (timer->remaining > diff)
+    timer->remaining -= diff;
+  else
+    timer->remaining  = 0;
+
+  timer->last = now;
+}
+
+static gboolean
+legacy_prepare (GSource *src, gint *timeout)
+{
+  LegacyTimer *timer = (LegacyTimer *)src;
+
+  legacy_calc_remaining (timer);
+  return (*timeout = timer->remaining) == 0;
+}
+
+static gboolean
+legacy_check (GSource *src)
+{
+  LegacyTimer *timer = (LegacyTimer *)src;
+
+  legacy_calc_remaining (timer);
+  return timer->remaining == 0;
+}
+
+static gboolean
+legacy_dispatch (GSource *src, GSourceFunc cb, gpointer cbarg)
+{
+  LegacyTimer *timer = (LegacyTimer *)src;
+
+  timer->remaining = timer->expiry;
+  return cb (cbarg);
+}
+
+static void
+legacy_timer_new (unsigned expiry, GSourceFunc cb, gpointer cbarg)
+{
+  static GSourceFuncs funcs =
+    { legacy_prepare, legacy_check, legacy_dispatch, NULL };
+  LegacyTimer *timer;
+  GSource *src;
+
+  src = g_source_new (&funcs, sizeof (*timer));
+  g_source_set_callback (src, cb, cbarg, NULL);
+  g_source_set_priority (src, G_PRIORITY_HIGH);
+  g_source_attach (src, NULL);
+  g_source_unref (src);
+
+  timer = (LegacyTimer *)src;
+  g_get_current_time (&timer->last);
+  timer->remaining = timer->expiry = expiry;
+}
+
+/* Correctness --------------------------------------------------------- */
+
+static GString *order;
+
+static gboolean
+record (gpointer data)
+{
+  g_string_append (order, data);
+  return FALSE;
+}
+
+static gboolean
+quit (gpointer unused)
+{
+  g_main_loop_quit (loop);
+  return FALSE;
+}
+
+static HdHPTimer *victim;
+static gint victim_destroyed;
+
+static void
+victim_notify (gpointer unused)
+{
+  victim_destroyed++;
+}
+
+static gboolean
+kill_victim (gpointer data)
+{
+  g_string_append (order, data);
+  hd_hptimer_destroy (victim);
+  return FALSE;
+}
+
+static HdHPTimer *rerunner;
+static gint reruns;
+
+static gboolean
+rerun (gpointer data)
+{
+  g_string_append (order, data);
+  if (++reruns == 1)
+    /* Again right away, rather than after its interval. */
+    hd_hptimer_set_remaining (rerunner, 0);
+  return reruns < 3;
+}
+
+static gboolean
+check_order (void)
+{
+  HdHPTimer *slow;
+  gboolean ok;
+
+  order = g_string_new ("");
+  hd_hptimer_new (30, record, "c", NULL);
+  hd_hptimer_new (10, record, "a", NULL);
+  hd_hptimer_new (20, record, "b", NULL);
+  /* Rescheduled to be before everyone. */
+  slow = hd_hptimer_new (1000, record, "0", NULL);
+  hd_hptimer_set_remaining (slow, 5);
+  /* Destroyed by another before it would expire. */
+  victim = hd_hptimer_new (50, record, "X", victim_notify);
+  hd_hptimer_new (40, kill_victim, "d", NULL);
+  /* Repeats. */
+  rerunner = hd_hptimer_new (60, rerun, "e", NULL);
+  hd_hptimer_new (250, quit, NULL, NULL);
+  g_main_loop_run (loop);
+
+  ok = !strcmp (order->str, "0abcdeee") && victim_destroyed == 1;
+  if (!ok)
+    printf ("FAIL: expired as \"%s\" instead of \"0abcdeee\", "
+            "destroyed %d times\n", order->str, victim_destroyed);
+  g_string_free (order, TRUE);
+  return ok;
+}
+
+/* Jitter -------------------------------------------------------------- */
+
+static gint64 wakeups[FRAMES+1];
+static gint n_wakeups;
+
+static gboolean
+frame (gpointer unused)
+{
+  wakeups[n_wakeups++] = now_us ();
+  if (n_wakeups <= FRAMES)
+    return TRUE;
+  g_main_loop_quit (loop);
+  return FALSE;
+}
+
+/* Reports the intervals between the @wakeups of a frame timer and
+ * how far the last one is from where it should be. */
+static void
+measure (const gchar *what)
+{
+  gdouble sum, sumsq, mean, sd, worst;
+  gint i;
+
+  sum = sumsq = worst = 0;
+  for (i = 1; i <= FRAMES; i++)
+    {
+      gdouble d = (wakeups[i] - wakeups[i-1]) / 1000.0;
+
+      sum += d;
+      sumsq += d * d;
+      if (fabs (d - FRAME_INTERVAL) > worst)
+        worst = fabs (d - FRAME_INTERVAL);
+    }
+  mean = sum / FRAMES;
+  sd = sqrt (MAX (sumsq / FRAMES - mean * mean, 0));
+  printf ("%-8s interval %.3f ms, stddev %.3f ms, worst %.3f ms off, "
+          "drift %.2f ms after %d frames\n", what, mean, sd, worst,
+          (wakeups[FRAMES] - wakeups[0]) / 1000.0
+            - FRAMES * FRAME_INTERVAL, FRAMES);
+}
+
+int
+main (int argc, char **argv)
+{
+  gint failures;
+
+  loop = g_main_loop_new (NULL, FALSE);
+  printf ("timerfd: %s\n", hd_hptimer_is_precise () ? "yes" : "no");
+
+  failures = !check_order ();
+
+  n_wakeups = 0;
+  legacy_timer_new (FRAME_INTERVAL, frame, NULL);
+  g_main_loop_run (loop);
+  measure ("legacy");
+
+  n_wakeups = 0;
+  hd_hptimer_new (FRAME_INTERVAL, frame, NULL, NULL);
+  g_main_loop_run (loop);
+  measure ("hptimer");
+
+  /* With absolute deadlines it mustn't fall behind much in any case. */
+  if (hd_hptimer_is_precise ()
+      && (wakeups[FRAMES] - wakeups[0]) / 1000 > FRAMES * FRAME_INTERVAL + 50)
+    {
+      printf ("FAIL: hptimer drifted\n");
+      failures++;
+    }
+
+  printf ("%d failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,369 @@
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tidy-kawase-shaders.h"
+
+/* Runs TidyBlurGroup's dual Kawase shaders through Mesa's software
+ * rasterizer the way tidy_blur_group_kawase_blur() chains them, and
+ * checks the result against the same passes done on the CPU with
+ * bilinear sampling.  Needs no display: it renders into textures of a
+ * surfaceless EGL context. */
+
+#define IMAGE_WIDTH   128
+#define IMAGE_HEIGHT  96
+/* As in tidy-blur-group.c */
+#define KAWASE_LEVELS   4
+#define KAWASE_MIN_SIZE 8
+/* Per channel, for the rounding of the 8-bit textures in between and
+ * the fixed point bilinear filtering of the rasterizer. */
+#define TOLERANCE 4
+
+static const char *vertex_shader =
+"attribute vec2 pos;\n"
+"varying mediump vec2 tex_coord;\n"
+"void main () {\n"
+"  tex_coord = pos * 0.5 + 0.5;\n"
+"  gl_Position = vec4 (pos, 0.0, 1.0);\n"
+"}\n";
+
+typedef struct
+{
+  int width, height;
+  float *pixels; /* RGBA, 0..1 */
+} Image;
+
+typedef struct
+{
+  GLuint program;
+  GLint offx, offy;
+} Shader;
+
+static Image
+image_new (int width, int height)
+{
+  Image img = { width, height, calloc (width * height * 4, sizeof (float)) };
+  return img;
+}
+
+/* What an RGBA8 texture would make of @img. */
+static void
+image_quantize (Image *img)
+{
+  int i;
+
+  for (i = 0; i < img->width * img->height * 4; i++)
+    img->pixels[i] = floorf (img->pixels[i] * 255 + 0.5f) / 255;
+}
+
+/* GL_LINEAR with GL_CLAMP_TO_EDGE at (@s, @t). */
+static void
+image_sample (const Image *img, float s, float t, float *out)
+{
+  float x = s * img->width - 0.5f, y = t * img->height - 0.5f;
+  int x0 = floorf (x), y0 = floorf (y), c, i, j;
+  float fx = x - x0, fy = y - y0;
+
+  for (c = 0; c < 4; c++)
+    out[c] = 0;
+  for (j = 0; j < 2; j++)
+    for (i = 0; i < 2; i++)
+      {
+        int xi = x0 + i, yj = y0 + j;
+        float w = (i ? fx : 1 - fx) * (j ? fy : 1 - fy);
+        const float *p;
+
+        xi = xi < 0 ? 0 : xi >= img->width  ? img->width-1  : xi;
+        yj = yj < 0 ? 0 : yj >= img->height ? img->height-1 : yj;
+        p = &img->pixels[(yj * img->width + xi) * 4];
+        for (c = 0; c < 4; c++)
+          out[c] += p[c] * w;
+      }
+}
+
+/* The CPU version of tidy_blur_group_kawase_pass(). */
+static void
+reference_pass (const Image *src, Image *dst, int up, float spread)
+{
+  static const float down[][3] =
+    { { 0, 0, 0.5 }, { -1, -1, 0.125 }, { 1, 1, 0.125 },
+      { 1, -1, 0.125 }, { -1, 1, 0.125 } };
+  static const float upw[][3] =
+    { { -2, 0, 0.0833 }, { 2, 0, 0.0833 }, { 0, -2, 0.0833 },
+      { 0, 2, 0.0833 }, { -1, -1, 0.1667 }, { 1, -1, 0.1667 },
+      { -1, 1, 0.1667 }, { 1, 1, 0.1667 } };
+  const float (*taps)[3] = up ? upw : down;
+  int n_taps = up ? 8 : 5;
+  float offx = 0.5f * spread / src->width;
+  float offy = 0.5f * spread / src->height;
+  int x, y, k, c;
+
+  for (y = 0; y < dst->height; y++)
+    for (x = 0; x < dst->width; x++)
+      {
+        float s = (x + 0.5f) / dst->width, t = (y + 0.5f) / dst->height;
+        float *p = &dst->pixels[(y * dst->width + x) * 4];
+
+        for (c = 0; c < 4; c++)
+          p[c] = 0;
+        for (k = 0; k < n_taps; k++)
+          {
+            float v[4];
+
+            image_sample (src, s + taps[k][0]*offx, t + taps[k][1]*offy, v);
+            for (c = 0; c < 4; c++)
+              p[c] += v[c] * taps[k][2];
+          }
+        for (c = 0; c < 4; c++)
+          p[c] = p[c] < 0 ? 0 : p[c] > 1 ? 1 : p[c];
+      }
+  image_quantize (dst);
+}
+
+static GLuint
+compile (GLenum type, const char *source)
+{
+  GLuint shader = glCreateShader (type);
+  GLint ok;
+
+  glShaderSource (shader, 1, &source, NULL);
+  glCompileShader (shader);
+  glGetShaderiv (shader, GL_COMPILE_STATUS, &ok);
+  if (!ok)
+    {
+      char log[1024];
+
+      glGetShaderInfoLog (shader, sizeof (log), NULL, log);
+      fprintf (stderr, "shader: %s\n", log);
+      exit (1);
+    }
+  return shader;
+}
+
+static Shader
+link_shader (const char *fragment_source)
+{
+  Shader shader;
+
+  shader.program = glCreateProgram ();
+  glAttachShader (shader.program, compile (GL_VERTEX_SHADER, vertex_shader));
+  glAttachShader (shader.program,
+                  compile (GL_FRAGMENT_SHADER, fragment_source));
+  glBindAttribLocation (shader.program, 0, "pos");
+  glLinkProgram (shader.program);
+  glUseProgram (shader.program);
+  glUniform1i (glGetUniformLocation (shader.program, "tex"), 0);
+  shader.offx = glGetUniformLocation (shader.program, "offx");
+  shader.offy = glGetUniformLocation (shader.program, "offy");
+  return shader;
+}
+
+static GLuint
+new_texture (int width, int height, const unsigned char *pixels)
+{
+  GLuint tex;
+
+  glGenTextures (1, &tex);
+  glBindTexture (GL_TEXTURE_2D, tex);
+  glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
+                GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  return tex;
+}
+
+static void
+gl_pass (const Shader *shader, GLuint src, int src_width, int src_height,
+         GLuint dst, int dst_width, int dst_height, float spread)
+{
+  static const GLfloat quad[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+  GLuint fbo;
+
+  glGenFramebuffers (1, &fbo);
+  glBindFramebuffer (GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                          GL_TEXTURE_2D, dst, 0);
+  glViewport (0, 0, dst_width, dst_height);
+
+  glUseProgram (shader->program);
+  glUniform1f (shader->offx, 0.5f * spread / src_width);
+  glUniform1f (shader->offy, 0.5f * spread / src_height);
+  glBindTexture (GL_TEXTURE_2D, src);
+  glVertexAttribPointer (0, 2, GL_FLOAT, GL_FALSE, 0, quad);
+  glEnableVertexAttribArray (0);
+  glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
+
+  glBindFramebuffer (GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers (1, &fbo);
+}
+
+static int
+init_egl (void)
+{
+  static const EGLint config_attribs[] =
+    { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+      EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+      EGL_NONE };
+  static const EGLint pbuffer_attribs[] =
+    { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+  static const EGLint context_attribs[] =
+    { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+  EGLDisplay dpy;
+  EGLConfig config;
+  EGLSurface surface;
+  EGLContext context;
+  EGLint n;
+
+  dpy = eglGetDisplay (EGL_DEFAULT_DISPLAY);
+  if (dpy == EGL_NO_DISPLAY || !eglInitialize (dpy, NULL, NULL)
+      || !eglChooseConfig (dpy, config_attribs, &config, 1, &n) || !n)
+    return 0;
+  surface = eglCreatePbufferSurface (dpy, config, pbuffer_attribs);
+  context = eglCreateContext (dpy, config, EGL_NO_CONTEXT, context_attribs);
+  return surface != EGL_NO_SURFACE && context != EGL_NO_CONTEXT
+    && eglMakeCurrent (dpy, surface, surface, context);
+}
+
+/* Blurs a pattern by @blur_step both ways and returns the number of
+ * channels that differ by more than TOLERANCE. */
+static int
+check (int blur_step, const Shader *down, const Shader *up)
+{
+  Image chain[KAWASE_LEVELS + 2];
+  GLuint tex[KAWASE_LEVELS + 2];
+  unsigned char *pixels;
+  double mean_in, mean_out;
+  float radius, spread;
+  int n_levels, levels, i, x, y, bad;
+
+  /* Stripes, a checkerboard and a gradient: something for every
+   * frequency, and hard edges at the borders. */
+  chain[0] = image_new (IMAGE_WIDTH, IMAGE_HEIGHT);
+  for (y = 0; y < IMAGE_HEIGHT; y++)
+    for (x = 0; x < IMAGE_WIDTH; x++)
+      {
+        float *p = &chain[0].pixels[(y * IMAGE_WIDTH + x) * 4];
+
+        p[0] = (x / 3) % 2;
+        p[1] = ((x / 8) + (y / 8)) % 2;
+        p[2] = (float) y / (IMAGE_HEIGHT - 1);
+        p[3] = 1;
+      }
+  image_quantize (&chain[0]);
+
+  /* The chain tidy_blur_group_get_textures() would get us. */
+  for (n_levels = 0; n_levels < KAWASE_LEVELS; n_levels++)
+    {
+      int w = chain[n_levels].width / 2, h = chain[n_levels].height / 2;
+
+      if (w < KAWASE_MIN_SIZE || h < KAWASE_MIN_SIZE)
+        break;
+      chain[n_levels+1] = image_new (w, h);
+    }
+  chain[n_levels+1] = image_new (IMAGE_WIDTH, IMAGE_HEIGHT);
+
+  /* The same sums as tidy_blur_group_kawase_blur(). */
+  radius = sqrtf (2 * blur_step);
+  for (levels = 1; levels < n_levels && (1 << levels) < radius; levels++)
+    /* find the shortest chain */;
+  spread = radius / (1 << (levels-1));
+  spread = spread < 1 ? 1 : spread > 3 ? 3 : spread;
+
+  pixels = malloc (IMAGE_WIDTH * IMAGE_HEIGHT * 4);
+  for (i = 0; i < IMAGE_WIDTH * IMAGE_HEIGHT * 4; i++)
+    pixels[i] = chain[0].pixels[i] * 255 + 0.5f;
+  tex[0] = new_texture (IMAGE_WIDTH, IMAGE_HEIGHT, pixels);
+  for (i = 1; i <= n_levels + 1; i++)
+    tex[i] = new_texture (chain[i].width, chain[i].height, NULL);
+
+  for (i = 0; i < levels; i++)
+    {
+      reference_pass (&chain[i], &chain[i+1], 0, spread);
+      gl_pass (down, tex[i], chain[i].width, chain[i].height,
+               tex[i+1], chain[i+1].width, chain[i+1].height, spread);
+    }
+  for (i = levels; i > 0; i--)
+    {
+      /* The last pass goes into tex_b, which is at the end here. */
+      int dst = i > 1 ? i-1 : n_levels+1;
+
+      reference_pass (&chain[i], &chain[dst], 1, spread);
+      gl_pass (up, tex[i], chain[i].width, chain[i].height,
+               tex[dst], chain[dst].width, chain[dst].height, spread);
+    }
+
+  {
+    GLuint fbo;
+
+    glGenFramebuffers (1, &fbo);
+    glBindFramebuffer (GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_TEXTURE_2D, tex[n_levels+1], 0);
+    glReadPixels (0, 0, IMAGE_WIDTH, IMAGE_HEIGHT,
+                  GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glBindFramebuffer (GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers (1, &fbo);
+  }
+
+  bad = 0;
+  mean_in = mean_out = 0;
+  for (i = 0; i < IMAGE_WIDTH * IMAGE_HEIGHT * 4; i++)
+    {
+      int expected = chain[n_levels+1].pixels[i] * 255 + 0.5f;
+
+      if (abs (expected - pixels[i]) > TOLERANCE)
+        bad++;
+      mean_in += chain[0].pixels[i] * 255;
+      mean_out += pixels[i];
+    }
+  mean_in /= IMAGE_WIDTH * IMAGE_HEIGHT * 4;
+  mean_out /= IMAGE_WIDTH * IMAGE_HEIGHT * 4;
+  /* Blurring should only move the light around. */
+  if (fabs (mean_in - mean_out) > 2)
+    bad++;
+
+  printf ("blur_step %2d: %d levels, spread %.2f, mean %.1f -> %.1f, %s\n",
+          blur_step, levels, spread, mean_in, mean_out,
+          bad ? "FAIL" : "ok");
+
+  glDeleteTextures (n_levels + 2, tex);
+  for (i = 0; i <= n_levels + 1; i++)
+    free (chain[i].pixels);
+  free (pixels);
+  return bad;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int blur_steps[] = { 1, 2, 5, 8, 12, 20, 40, 100 };
+  Shader down, up;
+  unsigned i;
+  int failures;
+
+  /* Whatever GPU there is, we want what Mesa makes of it in software. */
+  setenv ("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+  setenv ("EGL_PLATFORM", "surfaceless", 0);
+  if (!init_egl ())
+    {
+      printf ("no EGL/GLES2 context, skipped\n");
+      return 77;
+    }
+  printf ("renderer: %s\n", glGetString (GL_RENDERER));
+
+  down = link_shader (TIDY_KAWASE_DOWN_FRAGMENT_SHADER);
+  up = link_shader (TIDY_KAWASE_UP_FRAGMENT_SHADER);
+
+  failures = 0;
+  for (i = 0; i < sizeof (blur_steps) / sizeof (blur_steps[0]); i++)
+    failures += check (blur_steps[i], &down, &up) != 0;
+  printf ("%d failures\n", failures);
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hd-motion-history.h"
+
+/* Checks hd_motion_history_get() against the samples we've added:
+ * that only those strictly between @since and @until come back, oldest
+ * first, at most the latest @n of them, only the last
+ * HD_MOTION_HISTORY_LEN are remembered, and that the X time wrapping
+ * around doesn't confuse it. */
+
+#define MAX_SAMPLES (3 * HD_MOTION_HISTORY_LEN)
+
+/* Everything we've added, in order. */
+static HdMotionSample added[MAX_SAMPLES];
+static guint n_added;
+
+static void
+add (Time time)
+{
+  g_assert (n_added < MAX_SAMPLES);
+  added[n_added].x = n_added;
+  added[n_added].y = -(gint)n_added;
+  added[n_added].time = time;
+  hd_motion_history_add (added[n_added].x, added[n_added].y, time);
+  n_added++;
+}
+
+static gboolean
+check (const gchar *what, Time since, Time until, guint n)
+{
+  HdMotionSample expected[MAX_SAMPLES], got[MAX_SAMPLES];
+  guint i, n_expected, n_got;
+  gboolean ok;
+
+  /* The remembered samples in the range, then the latest @n of them. */
+  n_expected = 0;
+  for (i = n_added > HD_MOTION_HISTORY_LEN
+         ? n_added - HD_MOTION_HISTORY_LEN : 0; i < n_added; i++)
+    if ((gint32)(added[i].time - since) > 0
+        && (gint32)(added[i].time - until) < 0)
+      expected[n_expected++] = added[i];
+  if (n_expected > n)
+    {
+      memmove (expected, &expected[n_expected - n], n * sizeof (expected[0]));
+      n_expected = n;
+    }
+
+  n_got = hd_motion_history_get (since, until, got, n);
+  ok = n_got == n_expected;
+  for (i = 0; ok && i < n_got; i++)
+    ok = got[i].x == expected[i].x && got[i].y == expected[i].y
+      && got[i].time == expected[i].time;
+
+  if (!ok)
+    printf ("FAIL: %s: since %lu, until %lu, n %u: got %u samples, "
+            "expected %u\n", what, (unsigned long)since,
+            (unsigned long)until, n, n_got, n_expected);
+  return ok;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const guint ns[] = { 0, 1, 5, HD_MOTION_HISTORY_LEN, MAX_SAMPLES };
+  gint failures;
+  guint i, j, first;
+  Time oldest, latest;
+
+  failures = 0;
+
+  /* Nothing yet. */
+  failures += !check ("empty", 0, 1000, MAX_SAMPLES);
+
+  /* A few, one every 10 ms from 1000. */
+  for (i = 0; i < 10; i++)
+    add (1000 + 10*i);
+  for (i = 0; i < G_N_ELEMENTS (ns); i++)
+    {
+      failures += !check ("all", 0, 2000, ns[i]);
+      /* The bounds themselves are left out. */
+      failures += !check ("bounds", 1020, 1070, ns[i]);
+      failures += !check ("between", 1015, 1065, ns[i]);
+      failures += !check ("none after", 1090, 2000, ns[i]);
+      failures += !check ("none before", 0, 1000, ns[i]);
+      failures += !check ("none between", 1011, 1019, ns[i]);
+    }
+
+  /* Fill the ring many times over, the 32 bit X time wrapping around
+   * in the middle of what it remembers in the end. */
+  first = n_added;
+  for (i = 0; n_added < MAX_SAMPLES; i++)
+    add ((guint32)(10 * i
+                   - 10 * (MAX_SAMPLES - first - HD_MOTION_HISTORY_LEN/2)));
+  /* Just before what the ring remembers, and just after the latest. */
+  oldest = (guint32)(added[n_added - HD_MOTION_HISTORY_LEN - 1].time - 1);
+  latest = (guint32)(added[n_added - 1].time + 1);
+  for (i = 0; i < G_N_ELEMENTS (ns); i++)
+    {
+      failures += !check ("ring", oldest, latest, ns[i]);
+      for (j = n_added - HD_MOTION_HISTORY_LEN - 2; j < n_added; j += 7)
+        {
+          failures += !check ("wrapped since", added[j].time, latest, ns[i]);
+          failures += !check ("wrapped until", oldest, added[j].time, ns[i]);
+        }
+    }
+
+  printf ("%d failures\n", failures);
+  return failures ? 1 : 0;
+}
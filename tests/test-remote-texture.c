@@ -0,0 +1,294 @@
+/* Remote texture producer that does not depend on Gtk/Gdk.  Shares a
+ * few buffers with hildon-desktop through the version 2 shared memory
+ * protocol (see hd-remote-texture.c), draws a moving bar into whichever
+ * buffer it has got back and checks that the buffers are released in
+ * order.  Falls back to the single buffer protocol if the compositor
+ * doesn't know version 2.  With a single buffer and a version 3
+ * compositor the damage goes through the shared damage ring.
+ *
+ * Usage: test-remote-texture [n-buffers [n-frames]] */
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/time.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define WIDTH   320
+#define HEIGHT  240
+#define BPP     2
+#define BAR     32
+#define MAX_BUFFERS 3
+
+/* Must match hd-remote-texture.h */
+#define SHM_DAMAGE_RING   (1 << 8)
+#define DAMAGE_RING_SIZE  64
+typedef struct
+{
+  unsigned int head;
+  unsigned int reserved;
+  struct
+  {
+    int x, y, width, height;
+  } rects[DAMAGE_RING_SIZE];
+} DamageRing;
+
+static Atom shm_atom, shm2_atom, damage_atom, buffer_atom, release_atom;
+static Atom damage_batch_atom;
+static Atom show_atom, position_atom, parent_atom, ready_atom;
+
+static Window texwin;
+static int busy[MAX_BUFFERS];
+static int shown, errors;
+
+static void send_message (Display *dpy, Atom type,
+                          long l0, long l1, long l2, long l3, long l4)
+{
+  XClientMessageEvent xclient;
+
+  memset (&xclient, 0, sizeof (xclient));
+  xclient.type = ClientMessage;
+  xclient.window = texwin;
+  xclient.message_type = type;
+  xclient.format = 32;
+  xclient.data.l[0] = l0;
+  xclient.data.l[1] = l1;
+  xclient.data.l[2] = l2;
+  xclient.data.l[3] = l3;
+  xclient.data.l[4] = l4;
+
+  /* hildon-desktop selects StructureNotify on remote texture windows */
+  XSendEvent (dpy, texwin, False, StructureNotifyMask, (XEvent *)&xclient);
+}
+
+/* Returns the protocol version the compositor understands,
+ * or 0 if it hasn't set the ready property yet. */
+static long get_version (Display *dpy)
+{
+  Atom type;
+  int format, rc;
+  unsigned long items, left;
+  unsigned char *value;
+  long version;
+
+  rc = XGetWindowProperty (dpy, texwin, ready_atom, 0, 2, False,
+                           XA_ATOM, &type, &format,
+                           &items, &left, &value);
+  if (rc != Success || type == None)
+    return 0;
+  version = items > 1 ? ((long *)value)[1] : 1;
+  XFree (value);
+  return version;
+}
+
+static void handle_event (XEvent *xev)
+{
+  int buffer;
+
+  if (xev->type != ClientMessage
+      || xev->xclient.message_type != release_atom)
+    return;
+
+  buffer = xev->xclient.data.l[0];
+  if (buffer < 0 || buffer >= MAX_BUFFERS || !busy[buffer])
+    {
+      printf ("FAIL: release of buffer %d we don't share\n", buffer);
+      errors++;
+      return;
+    }
+  if (buffer == shown)
+    {
+      printf ("FAIL: release of the buffer being shown (%d)\n", buffer);
+      errors++;
+    }
+  busy[buffer] = 0;
+}
+
+/* Adds a rectangle to @ring for the compositor to see. */
+static void add_damage (DamageRing *ring, int x, int y, int width, int height)
+{
+  unsigned int i = ring->head % DAMAGE_RING_SIZE;
+
+  ring->rects[i].x = x;
+  ring->rects[i].y = y;
+  ring->rects[i].width = width;
+  ring->rects[i].height = height;
+  __sync_synchronize ();
+  ring->head++;
+}
+
+/* Draws a complete frame with the bar at @x. */
+static void draw (unsigned short *pixels, int x)
+{
+  int i, j;
+
+  for (j = 0; j < HEIGHT; j++)
+    for (i = 0; i < WIDTH; i++)
+      pixels[j*WIDTH + i] = i >= x && i < x+BAR ? 0xf800 : 0x001f;
+}
+
+static double now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+  Display *dpy;
+  Window parent;
+  Atom w_type, tex_type;
+  XEvent xev;
+  unsigned char *shm;
+  DamageRing *ring;
+  int shm_id, nbuffers, nframes, frame, version, stalls, size;
+  int x, prev_x;
+  key_t key;
+  double start;
+
+  nbuffers = argc > 1 ? atoi (argv[1]) : 2;
+  nframes = argc > 2 ? atoi (argv[2]) : 600;
+  if (nbuffers < 1 || nbuffers > MAX_BUFFERS)
+    {
+      fprintf (stderr, "n-buffers must be 1..%d\n", MAX_BUFFERS);
+      return 1;
+    }
+
+  if (!(dpy = XOpenDisplay (NULL)))
+    {
+      fprintf (stderr, "can't open display\n");
+      return 1;
+    }
+
+  shm_atom      = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_SHM", False);
+  shm2_atom     = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_SHM2", False);
+  damage_atom   = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_DAMAGE", False);
+  buffer_atom   = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_BUFFER", False);
+  release_atom  = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_RELEASE", False);
+  damage_batch_atom = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_DAMAGE_BATCH", False);
+  show_atom     = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_SHOW", False);
+  position_atom = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_POSITION", False);
+  parent_atom   = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_MESSAGE_PARENT", False);
+  ready_atom    = XInternAtom (dpy, "_HILDON_TEXTURE_CLIENT_READY", False);
+  w_type        = XInternAtom (dpy, "_NET_WM_WINDOW_TYPE", False);
+  tex_type      = XInternAtom (dpy, "_HILDON_WM_WINDOW_TYPE_REMOTE_TEXTURE", False);
+
+  /* An application window to show the texture in. */
+  parent = XCreateSimpleWindow (dpy, DefaultRootWindow (dpy), 0, 0,
+                                800, 480, 0, 0, 0);
+  XStoreName (dpy, parent, "test-remote-texture");
+  XMapWindow (dpy, parent);
+
+  texwin = XCreateSimpleWindow (dpy, DefaultRootWindow (dpy), 0, 0,
+                                WIDTH, HEIGHT, 0, 0, 0);
+  XChangeProperty (dpy, texwin, w_type, XA_ATOM, 32, PropModeReplace,
+                   (unsigned char *) &tex_type, 1);
+  XSelectInput (dpy, texwin, PropertyChangeMask);
+  XMapWindow (dpy, texwin);
+
+  while (!(version = get_version (dpy)))
+    XNextEvent (dpy, &xev);
+  printf ("compositor speaks protocol version %d\n", version);
+  if (version < 2)
+    nbuffers = 1;
+
+  /* The damage ring follows the pixels, 8-byte aligned. */
+  size = WIDTH*HEIGHT*BPP * nbuffers;
+  size = (size + 7) & ~7;
+  key = ftok (argv[0], getpid () & 0xff);
+  shm_id = shmget (key, size + sizeof (DamageRing), IPC_CREAT | 0666);
+  if (shm_id < 0 || (shm = shmat (shm_id, NULL, 0)) == (void *)-1)
+    {
+      perror ("shm");
+      return 1;
+    }
+  ring = version >= 3 ? (DamageRing *)(shm + size) : NULL;
+  if (ring)
+    memset (ring, 0, sizeof (*ring));
+
+  /* Buffer 0 is shown first and held by the compositor. */
+  x = prev_x = 0;
+  draw ((unsigned short *)shm, x);
+  shown = 0;
+  busy[0] = 1;
+  if (nbuffers > 1 || ring)
+    send_message (dpy, shm2_atom, key, WIDTH, HEIGHT, BPP,
+                  nbuffers | (ring ? SHM_DAMAGE_RING : 0));
+  else
+    send_message (dpy, shm_atom, key, WIDTH, HEIGHT, BPP, 0);
+  send_message (dpy, position_atom, 100, 100, WIDTH, HEIGHT, 0);
+  send_message (dpy, parent_atom, parent, 0, 0, 0, 0);
+  send_message (dpy, show_atom, 1, 255, 0, 0, 0);
+  XFlush (dpy);
+
+  stalls = 0;
+  start = now ();
+  for (frame = 1; frame < nframes; frame++)
+    {
+      int buffer, x1, x2;
+
+      while (XPending (dpy))
+        {
+          XNextEvent (dpy, &xev);
+          handle_event (&xev);
+        }
+
+      /* Find a buffer we may draw into, waiting if we must. */
+      for (buffer = 0; nbuffers > 1; )
+        {
+          if (!busy[buffer])
+            break;
+          if (++buffer == nbuffers)
+            {
+              stalls++;
+              XNextEvent (dpy, &xev);
+              handle_event (&xev);
+              buffer = 0;
+            }
+        }
+
+      x = (frame * 4) % (WIDTH - BAR);
+      draw ((unsigned short *)shm + buffer*WIDTH*HEIGHT, x);
+
+      /* Damage is relative to the previously shown frame. */
+      x1 = x < prev_x ? x : prev_x;
+      x2 = (x > prev_x ? x : prev_x) + BAR;
+      if (nbuffers > 1)
+        {
+          busy[buffer] = 1;
+          shown = buffer;
+          send_message (dpy, buffer_atom, buffer, x1, 0, x2 - x1, HEIGHT);
+        }
+      else if (ring)
+        { /* where the bar was and where it is now */
+          add_damage (ring, prev_x, 0, BAR, HEIGHT);
+          add_damage (ring, x, 0, BAR, HEIGHT);
+          send_message (dpy, damage_batch_atom, 0, 0, 0, 0, 0);
+        }
+      else
+        send_message (dpy, damage_atom, x1, 0, x2 - x1, HEIGHT, 0);
+      XFlush (dpy);
+      prev_x = x;
+
+      usleep (16000);
+    }
+
+  printf ("%d frames in %d buffer(s), %.1f fps, waited for a release "
+          "%d times, %d errors\n", nframes, nbuffers,
+          nframes / (now () - start), stalls, errors);
+
+  send_message (dpy, shm_atom, 0, 0, 0, 0, 0);
+  XSync (dpy, False);
+  shmdt (shm);
+  shmctl (shm_id, IPC_RMID, NULL);
+  XCloseDisplay (dpy);
+
+  return errors ? 1 : 0;
+}